@@ -82,6 +82,19 @@
 #include <map>
 #include <functional>
 #include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// SSE2 paths of the software upscaler, x86 and x64 only
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <immintrin.h>
+#define T_PGE_SSE2
+#endif
 
 #if __cplusplus >= 201703L
   // C++17 onwards
@@ -192,6 +205,81 @@ namespace tDX // tucna - DirectX
     bool bHeld = false;		// Set true for all frames between pressed and released events
   };
 
+  // A single input transition, stamped when the engine received it
+  struct InputEvent
+  {
+    enum Type : uint8_t { KEY_DOWN, KEY_UP, MOUSE_DOWN, MOUSE_UP, MOUSE_MOVE, MOUSE_WHEEL };
+
+    Type type = KEY_DOWN;
+    uint8_t nCode = 0;       // Key or mouse button
+    int32_t x = 0;           // Mouse position in "pixel" space
+    int32_t y = 0;
+    int32_t nWheel = 0;      // Wheel delta for MOUSE_WHEEL
+    int64_t nTimestamp = 0;  // Nanoseconds, see PixelGameEngine::GetInputTimestamp()
+  };
+
+  // Lock-free ring for exactly one producer and one consumer thread, N must be a power of two
+  template <class T, uint32_t N>
+  class SPSCQueue
+  {
+    static_assert((N & (N - 1)) == 0, "SPSCQueue size must be a power of two");
+
+  public:
+    bool Push(const T& v)
+    {
+      uint32_t h = nHead.load(std::memory_order_relaxed);
+      if (h - nTail.load(std::memory_order_acquire) == N) return false; // Full
+      buffer[h & (N - 1)] = v;
+      nHead.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool Pop(T& v)
+    {
+      uint32_t t = nTail.load(std::memory_order_relaxed);
+      if (t == nHead.load(std::memory_order_acquire)) return false; // Empty
+      v = buffer[t & (N - 1)];
+      nTail.store(t + 1, std::memory_order_release);
+      return true;
+    }
+
+    uint32_t Size() const { return nHead.load(std::memory_order_acquire) - nTail.load(std::memory_order_acquire); }
+
+  private:
+    T buffer[N];
+    alignas(64) std::atomic<uint32_t> nHead{ 0 };
+    alignas(64) std::atomic<uint32_t> nTail{ 0 };
+  };
+
+  // Worker threads started on first use and kept until exit, so work split up
+  // every frame costs a wake up rather than starting and joining threads
+  class ThreadPool
+  {
+  public:
+    ~ThreadPool();
+
+  public:
+    // Calls job(0) to job(nJobs - 1) on the workers and the calling thread and
+    // returns once all are done. Jobs must not call Run themselves
+    void Run(int32_t nJobs, const std::function<void(int32_t)>& job);
+    // Workers plus the calling thread
+    int32_t GetThreadCount();
+
+  private:
+    std::vector<std::thread> vWorkers;
+    std::mutex mux;
+    std::condition_variable cvWork;
+    std::condition_variable cvDone;
+    const std::function<void(int32_t)>* pJob = nullptr;
+    int32_t nJobs = 0;
+    int32_t nNext = 0;
+    int32_t nPending = 0;
+    bool bQuit = false;
+
+    void tDX_Worker();
+    bool tDX_RunNext(std::unique_lock<std::mutex>& lock);
+  };
+
   //=============================================================
 
   struct ResourceBuffer : public std::streambuf
@@ -220,6 +308,8 @@ namespace tDX // tucna - DirectX
 
   //=============================================================
 
+  class SpriteView;
+
   // A bitmap-like structure that stores a 2D array of Pixels
   class Sprite
   {
@@ -227,6 +317,9 @@ namespace tDX // tucna - DirectX
     Sprite();
     Sprite(std::string sImageFile, tDX::ResourcePack *pack = nullptr);
     Sprite(int32_t w, int32_t h);
+    // Copies share the pixels but not the views attached to the original
+    Sprite(const Sprite &s);
+    Sprite& operator=(const Sprite &s);
     ~Sprite();
 
   public:
@@ -247,10 +340,21 @@ namespace tDX // tucna - DirectX
     Pixel Sample(float x, float y);
     Pixel SampleBL(float u, float v);
     Pixel* GetData();
+    int32_t GetPitch() const; // Pixels from the start of one row to the next, only differs from width in views
+
+  protected:
+    friend class SpriteView;
+    friend class PixelGameEngine;
+    void Allocate(int32_t w, int32_t h);
+    // Allocate, and the attached views move onto the new pixels with their areas
+    // scaled to the new size, used for the primary screen
+    void Resize(int32_t w, int32_t h);
 
-  private:
     Pixel *pColData = nullptr;
+    std::shared_ptr<Pixel> pStorage; // Ref-counted, shared with every SpriteView looking into it
+    int32_t nPitch = 0;
     Mode modeSample = Mode::NORMAL;
+    std::vector<SpriteView*> vViews; // Views attached to this sprite
 
 #ifdef T_DBG_OVERDRAW
   public:
@@ -259,6 +363,63 @@ namespace tDX // tucna - DirectX
 
   };
 
+  // A window into the pixels of another Sprite, nothing is copied. The view shares the
+  // parent's storage, so it stays valid even after the parent is destroyed or reloaded.
+  // Views of the primary screen follow it when it is resized, see SetScreenSize and
+  // EnableDynamicResolution. It can be drawn as a sprite and set as a draw target,
+  // coordinates start at its corner
+  class SpriteView : public Sprite
+  {
+  public:
+    SpriteView();
+    SpriteView(Sprite *parent, int32_t x, int32_t y, int32_t w, int32_t h);
+    SpriteView(const SpriteView &v);
+    SpriteView& operator=(const SpriteView &v);
+    ~SpriteView();
+
+  public:
+    // Point the view at the given area of parent, clipped to parent's size
+    tDX::rcode Attach(Sprite *parent, int32_t x, int32_t y, int32_t w, int32_t h);
+
+  private:
+    friend class Sprite;
+    Sprite *pParent = nullptr;
+    int32_t nAreaX = 0, nAreaY = 0, nAreaW = 0, nAreaH = 0; // As asked for, before clipping
+    int32_t nRefW = 0, nRefH = 0; // Parent size the area was given for
+    void tDX_Detach();
+    tDX::rcode tDX_Repoint();
+  };
+
+  //=============================================================
+
+  // Counters of the retained text cache used by DrawString
+  struct TextCacheStats
+  {
+    uint32_t nHits = 0;
+    uint32_t nMisses = 0;
+    uint32_t nEvictions = 0;
+    size_t nEntries = 0;
+    size_t nBytes = 0;
+  };
+
+  //=============================================================
+
+  // Ways of magnifying a frame on the CPU
+  enum class Upscale
+  {
+    NEAREST,        // Whole multiples of the source size, every pixel becomes a block
+    SHARP_BILINEAR, // Any size, only output pixels straddling a texel edge are blended
+  };
+
+  // One step taken by the dynamic resolution controller
+  struct ResolutionChange
+  {
+    uint32_t nFrame;  // Frames since Start
+    float fFrameMs;   // Smoothed OnUserUpdate plus upload time that caused it
+    float fFromScale;
+    float fToScale;
+  };
+
   //=============================================================
 
   enum Key
@@ -308,10 +469,48 @@ namespace tDX // tucna - DirectX
     // Get Mouse Wheel Delta
     int32_t GetMouseWheel();
 
+  public: // Input events
+    // Current time in nanoseconds on the clock used to stamp input events
+    int64_t GetInputTimestamp();
+    // Time taken right after the last frame was presented, for input-to-pixel latency
+    int64_t GetLastPresentTimestamp();
+    // Pops the oldest pending input event, returns false once the queue is empty.
+    // Unlike GetKey this sees every transition, even a press and release within one frame
+    bool PollInputEvent(InputEvent& e);
+    // Discards all pending input events
+    void FlushInputEvents();
+    // Number of events lost because nobody drained the queue
+    uint32_t GetDroppedInputEvents();
+    // Events still pending at the end of a frame are discarded unless this is on, so an
+    // application that never polls cannot fill the queue. Turn it on to poll less than once a frame
+    void EnableInputEventQueue(bool bEnable);
+    // Feed synthetic input exactly as if the window reported it, GetKey/GetMouse
+    // pick it up on the next frame. A zero timestamp means "now". Must be called
+    // from the thread running Start() (or before it, when replaying headless)
+    void InjectKey(Key k, bool bDown, int64_t nTimestamp = 0);
+    void InjectMouseButton(uint32_t b, bool bDown, int64_t nTimestamp = 0);
+    void InjectMouseMove(int32_t x, int32_t y, int64_t nTimestamp = 0);
+    void InjectMouseWheel(int32_t delta, int64_t nTimestamp = 0);
+
+  public: // Session recording
+    // Write each frame's elapsed time, key and mouse state to sFile until StopSession
+    tDX::rcode RecordSession(const std::string& sFile);
+    // Feed a recorded session back frame by frame, live input is ignored meanwhile.
+    // A positive fTimestep replaces the recorded frame times, and bQuitAtEnd closes
+    // the application after the last recorded frame. Mouse positions are in screen
+    // pixels, so sessions recorded at another screen size fail to load
+    tDX::rcode PlaySession(const std::string& sFile, float fTimestep = 0.0f, bool bQuitAtEnd = false);
+    void StopSession();
+    bool IsPlayingSession();
+    // Frames recorded or played so far
+    uint32_t GetSessionFrame();
+
   public: // Utility
-    // Returns the width of the screen in "pixels"
+    // Returns the width of the screen in "pixels". This is the current size of the
+    // primary screen, below the size given to Construct while dynamic resolution
+    // scales it down, so lay out each frame from it rather than caching it
     int32_t ScreenWidth();
-    // Returns the height of the screen in "pixels"
+    // Returns the height of the screen in "pixels", see ScreenWidth
     int32_t ScreenHeight();
     // Returns the width of the currently selected drawing target in "pixels"
     int32_t GetDrawTargetWidth();
@@ -340,10 +539,16 @@ namespace tDX // tucna - DirectX
     // Draws a single Pixel
     virtual bool Draw(int32_t x, int32_t y, Pixel p = tDX::WHITE);
     bool Draw(const tDX::vi2d& pos, Pixel p = tDX::WHITE);
+    // Primitives write straight into the draw target and never call Draw. An application
+    // that overrides Draw turns this on to have every primitive pixel go through it again
+    void EnableDrawOverride(bool bEnable);
     // Draws a line from (x1,y1) to (x2,y2)
     void DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p = tDX::WHITE, uint32_t pattern = 0xFFFFFFFF);
     void DrawLine(const tDX::vi2d& pos1, const tDX::vi2d& pos2, Pixel p = tDX::WHITE, uint32_t pattern = 0xFFFFFFFF);
+    // Draws a line with float end points, cut to the window first so points far outside
+    // any int range still work. Without a window it is cut to the clip rect and draw target
     void DrawLineClipped(float x1, float y1, float x2, float y2, const tDX::vf2d& clipWinPos, const tDX::vf2d& clipWinSize, Pixel p = tDX::WHITE);
+    void DrawLineClipped(float x1, float y1, float x2, float y2, Pixel p = tDX::WHITE);
     // Draws a circle located at (x,y) with radius
     void DrawCircle(int32_t x, int32_t y, int32_t radius, Pixel p = tDX::WHITE, uint8_t mask = 0xFF);
     void DrawCircle(const tDX::vi2d& pos, int32_t radius, Pixel p = tDX::WHITE, uint8_t mask = 0xFF);
@@ -377,6 +582,47 @@ namespace tDX // tucna - DirectX
     // Resize the primary screen sprite
     void SetScreenSize(int w, int h);
 
+  public: // Clipping
+    // Limit all drawing to (x,y) to (x+w,y+h) of the draw target, nested rects
+    // are intersected with the one below. Pop returns to the previous rect.
+    // Rects are in pixels of the target and are not rescaled when the screen is
+    // resized, push them within the frame that uses them
+    void PushClipRect(int32_t x, int32_t y, int32_t w, int32_t h);
+    void PushClipRect(const tDX::vi2d& pos, const tDX::vi2d& size);
+    void PopClipRect();
+
+  public: // Text cache
+    // Keep rasterised strings in a LRU cache of at most nMaxBytes, so unchanged
+    // text costs one fill per run of set pixels. Zero disables the cache.
+    void SetTextCacheSize(size_t nMaxBytes);
+    TextCacheStats GetTextCacheStats();
+    void ResetTextCacheStats();
+
+  public: // Software presentation
+    // Threads shared by the upscaler and any extension that splits up its work
+    static ThreadPool& GetThreadPool();
+    // Magnifies sprite to nOutW x nOutH pixels into pOut, whose rows are nOutPitch
+    // pixels apart. Rows are shared among nThreads threads, zero uses every core
+    static tDX::rcode UpscaleSprite(Sprite *sprite, Pixel *pOut, int32_t nOutW, int32_t nOutH, int32_t nOutPitch, Upscale filter = Upscale::NEAREST, int32_t nThreads = 0);
+    // The primary screen magnified to the size given to Construct, for presenting
+    // without the GPU. pOut must hold screen_w*pixel_w by screen_h*pixel_h pixels.
+    // NEAREST turns into SHARP_BILINEAR while dynamic resolution has the screen at
+    // a size that does not divide the output
+    tDX::rcode UpscaleFrame(Pixel *pOut, int32_t nOutPitch, Upscale filter = Upscale::NEAREST, int32_t nThreads = 0);
+
+  public: // Dynamic resolution
+    // Shrinks the primary screen when OnUserUpdate plus the texture upload take longer
+    // than fBudgetMs and grows it back once there is time to spare, staying within
+    // fMinScale and fMaxScale of the size given to Construct. ScreenWidth() and
+    // ScreenHeight() report the current size, the mouse is mapped onto it and the GPU
+    // stretches the frame over the window. Views of the screen are scaled with it,
+    // clip rects are not
+    void EnableDynamicResolution(bool bEnable, float fBudgetMs = 16.0f, float fMinScale = 0.5f, float fMaxScale = 1.0f);
+    float GetResolutionScale();
+    // Every change the controller made, SaveResolutionLog writes them out as CSV
+    const std::vector<ResolutionChange>& GetResolutionLog();
+    tDX::rcode SaveResolutionLog(const std::string& sFile);
+
   public: // Branding
     std::string sAppName;
 
@@ -419,6 +665,46 @@ namespace tDX // tucna - DirectX
     int			nFrameCount = 0;
     Sprite		*fontSprite = nullptr;
     std::function<tDX::Pixel(const int x, const int y, const tDX::Pixel&, const tDX::Pixel&)> funcPixelMode;
+    bool		bDrawOverride = false;
+
+    // Dynamic resolution controller
+    bool		bDynamicResolution = false;
+    float		fResBudgetMs = 16.0f;
+    float		fResMinScale = 0.5f;
+    float		fResMaxScale = 1.0f;
+    float		fResScale = 1.0f;
+    float		fResSmoothedMs = 0.0f;
+    uint32_t	nResFrame = 0;
+    uint32_t	nResCooldown = 0;
+    std::vector<ResolutionChange> vResolutionLog;
+    void tDX_UpdateResolution(float fWorkMs);
+    void tDX_ApplyResolution(float fScale);
+
+    // Clip rects as x0, y0, x1, y1 with x1 and y1 exclusive
+    struct sClipRect { int32_t x0, y0, x1, y1; };
+    std::vector<sClipRect> vClipStack;
+    sClipRect tDX_GetClip();
+
+    // Pixel sinks specialised on the pixel mode, one is picked per primitive by tDX_Dispatch.
+    // Primitives that lie inside the clip rect get a writer without any bounds checks
+    static const int DRAW_OVERRIDE = Pixel::Mode::CUSTOM + 1;
+    template <int MODE, bool CLIP> struct SpanWriter;
+    template <class F> void tDX_Dispatch(int32_t x0, int32_t y0, int32_t x1, int32_t y1, F&& fn);
+    template <bool CLIP, class F> void tDX_DispatchMode(const sClipRect& c, F&& fn);
+
+    // Run of set pixels in a cached string, x0 to x1 inclusive on rows y to y + scale - 1
+    struct sTextSpan { int32_t x0, x1, y; };
+    struct sTextCacheEntry
+    {
+      std::string sKey;
+      std::vector<sTextSpan> vSpans;
+      size_t nBytes;
+    };
+
+    size_t nTextCacheMaxBytes = 0;
+    TextCacheStats textCacheStats;
+    std::list<sTextCacheEntry> listTextCache; // Most recently used at front
+    std::unordered_map<std::string, std::list<sTextCacheEntry>::iterator> mapTextCache;
 
     static std::map<size_t, uint8_t> mapKeys;
     bool		pKeyNewState[256]{ 0 };
@@ -429,6 +715,21 @@ namespace tDX // tucna - DirectX
     bool		pMouseOldState[5]{ 0 };
     HWButton	pMouseState[5];
 
+    SPSCQueue<InputEvent, 1024> inputQueue;
+    std::atomic<uint32_t> nDroppedInputEvents{ 0 };
+    bool		bKeepInputEvents = false;
+    int64_t		nPresentTimestamp = 0;
+
+    enum class SessionMode { NONE, RECORD, PLAY };
+    SessionMode	nSessionMode = SessionMode::NONE;
+    std::ofstream	sessionFile;
+    std::vector<uint8_t> vSessionData;
+    size_t		nSessionPos = 0;
+    uint32_t	nSessionFrame = 0;
+    float		fSessionTimestep = 0.0f;
+    bool		bSessionQuitAtEnd = false;
+    bool		pSessionKeys[256]{ 0 }; // Key state of the last recorded or played frame
+
     Microsoft::WRL::ComPtr<ID3D11Device>              m_d3dDevice;
     Microsoft::WRL::ComPtr<ID3D11DeviceContext>       m_d3dContext;
     Microsoft::WRL::ComPtr<IDXGISwapChain1>           m_swapChain;
@@ -450,11 +751,18 @@ namespace tDX // tucna - DirectX
     // Common initialisation functions
     void tDX_UpdateMouse(int32_t x, int32_t y);
     void tDX_UpdateMouseWheel(int32_t delta);
+    void tDX_UpdateKey(uint8_t k, bool bDown, int64_t nTimestamp);
+    void tDX_UpdateMouseButton(uint32_t b, bool bDown, int64_t nTimestamp);
+    void tDX_PushInputEvent(const InputEvent& e);
+    float tDX_SessionFrame(float fElapsedTime);
     void tDX_UpdateWindowSize(int32_t x, int32_t y);
     void tDX_UpdateViewport();
     void tDX_DirectXCreateResources();
+    void tDX_CreateFrameTexture();
     bool tDX_DirectXCreateDevice();
     void tDX_ConstructFontSheet();
+    const std::vector<sTextSpan>* tDX_GetCachedText(const std::string& sText, uint32_t scale);
+    void tDX_TrimTextCache(size_t nMaxBytes);
 
     // Windows specific window handling
     HWND tDX_hWnd = nullptr;
@@ -545,6 +853,7 @@ namespace tDX
     pColData = nullptr;
     width = 0;
     height = 0;
+    nPitch = 0;
   }
 
   Sprite::Sprite(std::string sImageFile, tDX::ResourcePack *pack)
@@ -554,27 +863,56 @@ namespace tDX
 
   Sprite::Sprite(int32_t w, int32_t h)
   {
-    if (pColData) delete[] pColData;
-    width = w;		height = h;
-    pColData = new Pixel[width * height];
-    for (int32_t i = 0; i < width*height; i++)
-      pColData[i] = Pixel();
+    Allocate(w, h);
+  }
+
+  Sprite::Sprite(const Sprite &s)
+  {
+    *this = s;
+  }
+
+  Sprite& Sprite::operator=(const Sprite &s)
+  {
+    width = s.width; height = s.height;
+    pColData = s.pColData;
+    pStorage = s.pStorage;
+    nPitch = s.nPitch;
+    modeSample = s.modeSample;
+    return *this;
   }
 
   Sprite::~Sprite()
   {
-    if (pColData) delete pColData;
+    // Storage goes away with the last sprite or view holding it, views
+    // outliving this sprite keep theirs
+    for (SpriteView *v : vViews)
+      v->pParent = nullptr;
   }
 
-  tDX::rcode Sprite::LoadFromPGESprFile(std::string sImageFile, tDX::ResourcePack *pack)
+  void Sprite::Allocate(int32_t w, int32_t h)
+  {
+    width = w;		height = h;
+    nPitch = w;
+    // Replacing the storage leaves existing views on the old pixels
+    pStorage.reset(new Pixel[width * height], std::default_delete<Pixel[]>());
+    pColData = pStorage.get();
+  }
+
+  void Sprite::Resize(int32_t w, int32_t h)
   {
-    if (pColData) delete[] pColData;
+    Allocate(w, h);
+    for (SpriteView *v : vViews)
+      v->tDX_Repoint();
+  }
 
+  tDX::rcode Sprite::LoadFromPGESprFile(std::string sImageFile, tDX::ResourcePack *pack)
+  {
     auto ReadData = [&](std::istream &is)
     {
-      is.read((char*)&width, sizeof(int32_t));
-      is.read((char*)&height, sizeof(int32_t));
-      pColData = new Pixel[width * height];
+      int32_t w = 0, h = 0;
+      is.read((char*)&w, sizeof(int32_t));
+      is.read((char*)&h, sizeof(int32_t));
+      Allocate(w, h);
       is.read((char*)pColData, width * height * sizeof(uint32_t));
     };
 
@@ -613,7 +951,8 @@ namespace tDX
     {
       ofs.write((char*)&width, sizeof(int32_t));
       ofs.write((char*)&height, sizeof(int32_t));
-      ofs.write((char*)pColData, width*height * sizeof(uint32_t));
+      for (int32_t y = 0; y < height; y++)
+        ofs.write((char*)(pColData + y * nPitch), width * sizeof(uint32_t));
       ofs.close();
       return tDX::OK;
     }
@@ -647,9 +986,7 @@ namespace tDX
     }
 
     if (bmp == nullptr) return tDX::NO_FILE;
-    width = bmp->GetWidth();
-    height = bmp->GetHeight();
-    pColData = new Pixel[width * height];
+    Allocate(bmp->GetWidth(), bmp->GetHeight());
 
     for (int x = 0; x < width; x++)
       for (int y = 0; y < height; y++)
@@ -673,13 +1010,13 @@ namespace tDX
     if (modeSample == tDX::Sprite::Mode::NORMAL)
     {
       if (x >= 0 && x < width && y >= 0 && y < height)
-        return pColData[y*width + x];
+        return pColData[y*nPitch + x];
       else
         return Pixel(0, 0, 0, 0);
     }
     else
     {
-      return pColData[abs(y%height)*width + abs(x%width)];
+      return pColData[abs(y%height)*nPitch + abs(x%width)];
     }
   }
 
@@ -693,7 +1030,7 @@ namespace tDX
     // This check is too expensive
     //if (x >= 0 && x < width && y >= 0 && y < height)
     //{
-      pColData[y*width + x] = p;
+      pColData[y*nPitch + x] = p;
       return true;
     //}
     //else
@@ -731,6 +1068,103 @@ namespace tDX
 
   Pixel* Sprite::GetData() { return pColData; }
 
+  int32_t Sprite::GetPitch() const { return nPitch; }
+
+  SpriteView::SpriteView()
+  {
+  }
+
+  SpriteView::SpriteView(Sprite *parent, int32_t x, int32_t y, int32_t w, int32_t h)
+  {
+    Attach(parent, x, y, w, h);
+  }
+
+  SpriteView::SpriteView(const SpriteView &v) : Sprite()
+  {
+    *this = v;
+  }
+
+  SpriteView& SpriteView::operator=(const SpriteView &v)
+  {
+    if (this == &v) return *this;
+    tDX_Detach();
+    Sprite::operator=(v);
+    pParent = v.pParent;
+    nAreaX = v.nAreaX; nAreaY = v.nAreaY; nAreaW = v.nAreaW; nAreaH = v.nAreaH;
+    nRefW = v.nRefW; nRefH = v.nRefH;
+    if (pParent) pParent->vViews.push_back(this);
+    return *this;
+  }
+
+  SpriteView::~SpriteView()
+  {
+    tDX_Detach();
+  }
+
+  void SpriteView::tDX_Detach()
+  {
+    if (pParent)
+      pParent->vViews.erase(std::remove(pParent->vViews.begin(), pParent->vViews.end(), this), pParent->vViews.end());
+    pParent = nullptr;
+  }
+
+  tDX::rcode SpriteView::Attach(Sprite *parent, int32_t x, int32_t y, int32_t w, int32_t h)
+  {
+    tDX_Detach();
+    pStorage.reset();
+    pColData = nullptr;
+    width = 0; height = 0; nPitch = 0;
+
+    if (parent == nullptr) return tDX::FAIL;
+
+    // Stays attached even when empty, a resize of the parent may bring it back
+    pParent = parent;
+    pParent->vViews.push_back(this);
+    nAreaX = x; nAreaY = y; nAreaW = w; nAreaH = h;
+    nRefW = parent->width; nRefH = parent->height;
+    return tDX_Repoint();
+  }
+
+  // Looks the area up in the parent again, scaled from the size it was given for
+  tDX::rcode SpriteView::tDX_Repoint()
+  {
+    pStorage.reset();
+    pColData = nullptr;
+    width = 0; height = 0; nPitch = 0;
+
+    tDX::rcode rc = tDX::FAIL;
+    Sprite *parent = pParent;
+    if (parent != nullptr && parent->pColData != nullptr)
+    {
+      // Attached while the parent was empty, the area is taken as is
+      if (nRefW <= 0 || nRefH <= 0) { nRefW = parent->width; nRefH = parent->height; }
+
+      // Both edges are scaled, so areas that touched still touch
+      auto scale = [](int32_t v, int32_t to, int32_t from) { return (int32_t)((int64_t)v * to / from); };
+      int32_t x = scale(nAreaX, parent->width, nRefW), x1 = scale(nAreaX + nAreaW, parent->width, nRefW);
+      int32_t y = scale(nAreaY, parent->height, nRefH), y1 = scale(nAreaY + nAreaH, parent->height, nRefH);
+
+      // Clip the window to the parent
+      x1 = std::min(x1, parent->width); y1 = std::min(y1, parent->height);
+      x = std::max(x, 0); y = std::max(y, 0);
+      if (x1 > x && y1 > y)
+      {
+        // Parent may be a view itself, its pitch and storage carry over
+        pStorage = parent->pStorage;
+        nPitch = parent->nPitch;
+        pColData = parent->pColData + y * parent->nPitch + x;
+        width = x1 - x;
+        height = y1 - y;
+        rc = tDX::OK;
+      }
+    }
+
+    // Views of this view move along
+    for (SpriteView *v : vViews)
+      v->tDX_Repoint();
+    return rc;
+  }
+
   //==========================================================
   // Resource Packs - Allows you to store files in one large
   // scrambled file
@@ -931,10 +1365,14 @@ namespace tDX
 
   void PixelGameEngine::SetScreenSize(int w, int h)
   {
-    delete pDefaultDrawTarget;
     nScreenWidth = w;
     nScreenHeight = h;
-    pDefaultDrawTarget = new Sprite(nScreenWidth, nScreenHeight);
+    fResScale = 1.0f;
+    // Resized in place, so views of the screen follow it
+    if (pDefaultDrawTarget)
+      pDefaultDrawTarget->Resize(nScreenWidth, nScreenHeight);
+    else
+      pDefaultDrawTarget = new Sprite(nScreenWidth, nScreenHeight);
     SetDrawTarget(nullptr);
 
     tDX_UpdateViewport();
@@ -1068,6 +1506,10 @@ namespace tDX
         // Our time per frame coefficient
         float fElapsedTime = elapsedTime.count();
 
+        // Record this frame's input, or replace it with a recorded one
+        if (nSessionMode != SessionMode::NONE)
+          fElapsedTime = tDX_SessionFrame(fElapsedTime);
+
         // Handle resize if needed
         if (bResize)
         {
@@ -1134,14 +1576,24 @@ namespace tDX
 #endif
 
         // Handle Frame Update
+        auto tpWork = std::chrono::steady_clock::now();
         if (!OnUserUpdate(fElapsedTime))
           bActive = false;
 
+        // Nobody is going to read what this frame left behind
+        if (!bKeepInputEvents)
+          FlushInputEvents();
+
         // TODO: UpdateSubresource is not optimal here, Map would be better
         m_d3dContext->UpdateSubresource(m_texture.Get(), 0, NULL, pDefaultDrawTarget->GetData(), pDefaultDrawTarget->width * 4, 0);
+        std::chrono::duration<float, std::milli> workTime = std::chrono::steady_clock::now() - tpWork;
 
         m_d3dContext->DrawIndexed(6, 0, 0);
         m_swapChain->Present(0, 0);
+        nPresentTimestamp = GetInputTimestamp();
+
+        // Pick the size of the next frame
+        tDX_UpdateResolution(workTime.count());
 
         // Update Title Bar
         fFrameTimer += fElapsedTime;
@@ -1151,6 +1603,8 @@ namespace tDX
           fFrameTimer -= 1.0f;
 
           std::string sTitle = "tucna.net - Pixel Game Engine - " + sAppName + " - FPS: " + std::to_string(nFrameCount);
+          if (bDynamicResolution)
+            sTitle += " - Scale: " + std::to_string((int)std::lround(fResScale * 100.0f)) + "%";
 
 #ifdef UNICODE
           SetWindowText(tDX_hWnd, ConvertS2W(sTitle).c_str());
@@ -1168,6 +1622,9 @@ namespace tDX
 
     OnUserDestroy();
 
+    // Release cached text sprites
+    tDX_TrimTextCache(0);
+
     // Finish rendering
     ID3D11RenderTargetView* nullViews[] = { nullptr };
     m_d3dContext->OMSetRenderTargets(_countof(nullViews), nullViews, nullptr);
@@ -1242,119 +1699,479 @@ namespace tDX
     return nMouseWheelDelta;
   }
 
-  int32_t PixelGameEngine::ScreenWidth()
+  int64_t PixelGameEngine::GetInputTimestamp()
   {
-    return nScreenWidth;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
   }
 
-  int32_t PixelGameEngine::ScreenHeight()
+  int64_t PixelGameEngine::GetLastPresentTimestamp()
   {
-    return nScreenHeight;
+    return nPresentTimestamp;
   }
 
-  bool PixelGameEngine::Draw(const tDX::vi2d& pos, Pixel p)
+  bool PixelGameEngine::PollInputEvent(InputEvent& e)
   {
-    return Draw(pos.x, pos.y, p);
+    return inputQueue.Pop(e);
   }
 
-  bool PixelGameEngine::Draw(int32_t x, int32_t y, Pixel p)
+  void PixelGameEngine::FlushInputEvents()
   {
-    if (!pDrawTarget) return false;
+    InputEvent e;
+    while (inputQueue.Pop(e));
+  }
+
+  uint32_t PixelGameEngine::GetDroppedInputEvents()
+  {
+    return nDroppedInputEvents;
+  }
 
+  void PixelGameEngine::EnableInputEventQueue(bool bEnable)
+  {
+    bKeepInputEvents = bEnable;
+  }
 
-    if (nPixelMode == Pixel::Mode::NORMAL)
+  void PixelGameEngine::InjectKey(Key k, bool bDown, int64_t nTimestamp)
+  {
+    tDX_UpdateKey((uint8_t)k, bDown, nTimestamp ? nTimestamp : GetInputTimestamp());
+  }
+
+  void PixelGameEngine::InjectMouseButton(uint32_t b, bool bDown, int64_t nTimestamp)
+  {
+    tDX_UpdateMouseButton(b, bDown, nTimestamp ? nTimestamp : GetInputTimestamp());
+  }
+
+  void PixelGameEngine::InjectMouseMove(int32_t x, int32_t y, int64_t nTimestamp)
+  {
+    // Injected positions are already in "pixel" space
+    nMousePosXcache = std::min(std::max(x, 0), ScreenWidth() - 1);
+    nMousePosYcache = std::min(std::max(y, 0), ScreenHeight() - 1);
+
+    InputEvent e;
+    e.type = InputEvent::MOUSE_MOVE;
+    e.x = nMousePosXcache;
+    e.y = nMousePosYcache;
+    e.nTimestamp = nTimestamp ? nTimestamp : GetInputTimestamp();
+    tDX_PushInputEvent(e);
+  }
+
+  void PixelGameEngine::InjectMouseWheel(int32_t delta, int64_t nTimestamp)
+  {
+    nMouseWheelDeltaCache += delta;
+
+    InputEvent e;
+    e.type = InputEvent::MOUSE_WHEEL;
+    e.x = nMousePosXcache;
+    e.y = nMousePosYcache;
+    e.nWheel = delta;
+    e.nTimestamp = nTimestamp ? nTimestamp : GetInputTimestamp();
+    tDX_PushInputEvent(e);
+  }
+
+  //==========================================================
+  // Session files - "tSES", version, screen size, then one
+  // record per frame:
+  //   float elapsed, int16 mouse x, y, wheel, uint8 mouse buttons,
+  //   uint8 count, then that many codes of keys that toggled
+
+  static const uint32_t SESSION_VERSION = 1;
+
+  tDX::rcode PixelGameEngine::RecordSession(const std::string& sFile)
+  {
+    StopSession();
+
+    sessionFile.open(sFile, std::ofstream::binary);
+    if (!sessionFile.is_open()) return tDX::FAIL;
+
+    uint32_t header[4] = { 0, SESSION_VERSION, nScreenWidth, nScreenHeight };
+    memcpy(header, "tSES", 4);
+    sessionFile.write((char*)header, sizeof(header));
+
+    std::fill(pSessionKeys, pSessionKeys + 256, false);
+    nSessionFrame = 0;
+    nSessionMode = SessionMode::RECORD;
+    return tDX::OK;
+  }
+
+  tDX::rcode PixelGameEngine::PlaySession(const std::string& sFile, float fTimestep, bool bQuitAtEnd)
+  {
+    StopSession();
+
+    std::ifstream ifs(sFile, std::ifstream::binary);
+    if (!ifs.is_open()) return tDX::NO_FILE;
+
+    // Whole session is read up front so replay does no file IO
+    vSessionData.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+
+    uint32_t header[4] = {};
+    if (vSessionData.size() < sizeof(header)) return tDX::FAIL;
+    memcpy(header, vSessionData.data(), sizeof(header));
+    if (memcmp(header, "tSES", 4) != 0 || header[1] != SESSION_VERSION || header[2] != nScreenWidth || header[3] != nScreenHeight)
     {
-      return pDrawTarget->SetPixel(x, y, p);
+      vSessionData.clear();
+      return tDX::FAIL;
     }
 
-    if (nPixelMode == Pixel::Mode::MASK)
+    std::fill(pSessionKeys, pSessionKeys + 256, false);
+    nSessionPos = sizeof(header);
+    nSessionFrame = 0;
+    fSessionTimestep = fTimestep;
+    bSessionQuitAtEnd = bQuitAtEnd;
+    nSessionMode = SessionMode::PLAY;
+    return tDX::OK;
+  }
+
+  void PixelGameEngine::StopSession()
+  {
+    if (sessionFile.is_open())
+      sessionFile.close();
+    vSessionData.clear();
+    nSessionMode = SessionMode::NONE;
+  }
+
+  bool PixelGameEngine::IsPlayingSession()
+  {
+    return nSessionMode == SessionMode::PLAY;
+  }
+
+  uint32_t PixelGameEngine::GetSessionFrame()
+  {
+    return nSessionFrame;
+  }
+
+  float PixelGameEngine::tDX_SessionFrame(float fElapsedTime)
+  {
+    struct sFrame { float fElapsed; int16_t x, y, wheel; uint8_t nButtons, nToggles; };
+    static_assert(sizeof(sFrame) == 12, "session frame must stay unpadded");
+
+    if (nSessionMode == SessionMode::RECORD)
     {
-      if (p.a == 255)
-        return pDrawTarget->SetPixel(x, y, p);
+      sFrame f = { fElapsedTime, (int16_t)nMousePosXcache, (int16_t)nMousePosYcache, (int16_t)nMouseWheelDeltaCache, 0, 0 };
+      for (int i = 0; i < 5; i++)
+        f.nButtons |= pMouseNewState[i] ? (1 << i) : 0;
+
+      uint8_t toggles[256];
+      for (int i = 0; i < 256 && f.nToggles < 255; i++)
+        if (pKeyNewState[i] != pSessionKeys[i])
+        {
+          toggles[f.nToggles++] = (uint8_t)i;
+          pSessionKeys[i] = pKeyNewState[i];
+        }
+
+      sessionFile.write((char*)&f, sizeof(f));
+      sessionFile.write((char*)toggles, f.nToggles);
+      nSessionFrame++;
+      return fElapsedTime;
     }
 
-    if (nPixelMode == Pixel::Mode::ALPHA)
+    sFrame f;
+    if (nSessionPos + sizeof(f) > vSessionData.size())
     {
-      Pixel d = pDrawTarget->GetPixel(x, y);
-      float a = (float)(p.a / 255.0f) * fBlendFactor;
-      float c = 1.0f - a;
-      float r = a * (float)p.r + c * (float)d.r;
-      float g = a * (float)p.g + c * (float)d.g;
-      float b = a * (float)p.b + c * (float)d.b;
-      return pDrawTarget->SetPixel(x, y, Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b));
+      // Out of frames, hand control back to the user
+      StopSession();
+      if (bSessionQuitAtEnd) bActive = false;
+      return fElapsedTime;
     }
 
-    if (nPixelMode == Pixel::Mode::CUSTOM)
+    memcpy(&f, vSessionData.data() + nSessionPos, sizeof(f));
+    nSessionPos += sizeof(f);
+    for (uint8_t i = 0; i < f.nToggles && nSessionPos < vSessionData.size(); i++)
     {
-      return pDrawTarget->SetPixel(x, y, funcPixelMode(x, y, p, pDrawTarget->GetPixel(x, y)));
+      uint8_t k = vSessionData[nSessionPos++];
+      pSessionKeys[k] = !pSessionKeys[k];
     }
 
-    return false;
+    // Force the recorded state, overriding whatever the window reported since
+    for (int i = 0; i < 256; i++)
+      if (pKeyNewState[i] != pSessionKeys[i])
+        InjectKey((Key)i, pSessionKeys[i]);
+
+    for (uint32_t i = 0; i < 5; i++)
+      if (pMouseNewState[i] != ((f.nButtons >> i) & 1))
+        InjectMouseButton(i, (f.nButtons >> i) & 1);
+
+    if (f.x != nMousePosXcache || f.y != nMousePosYcache)
+      InjectMouseMove(f.x, f.y);
+
+    nMouseWheelDeltaCache = 0;
+    if (f.wheel != 0)
+      InjectMouseWheel(f.wheel);
+
+    nSessionFrame++;
+    return fSessionTimestep > 0.0f ? fSessionTimestep : f.fElapsed;
   }
 
-  void PixelGameEngine::SetSubPixelOffset(float ox, float oy)
+  int32_t PixelGameEngine::ScreenWidth()
   {
-    fSubPixelOffsetX = ox * fPixelX;
-    fSubPixelOffsetY = oy * fPixelY;
+    // Smaller than nScreenWidth while dynamic resolution scales it down
+    return pDefaultDrawTarget ? pDefaultDrawTarget->width : nScreenWidth;
   }
 
-  void PixelGameEngine::DrawLineClipped(float x1, float y1, float x2, float y2, const tDX::vf2d& clipWinPos, const tDX::vf2d& clipWinSize, Pixel p)
+  int32_t PixelGameEngine::ScreenHeight()
   {
-    tDX::vf2d v1 = { x1, y1 };
-    tDX::vf2d v2 = { x2, y2 };
-
-    const char inside = 0; // 0000
-    const char left = 1;   // 0001
-    const char right = 2;  // 0010
-    const char bottom = 4; // 0100
-    const char top = 8;    // 1000
+    return pDefaultDrawTarget ? pDefaultDrawTarget->height : nScreenHeight;
+  }
 
-    float xMax = clipWinPos.x + clipWinSize.x;
-    float xMin = clipWinPos.x;
+  //==========================================================
+  // Span writers - the primitives choose one for the current
+  // pixel mode up front, so the inner loops skip the virtual
+  // Draw and its mode checks
 
-    float yMax = clipWinPos.y + clipWinSize.y;
-    float yMin = clipWinPos.y;
+  template <int MODE, bool CLIP>
+  struct PixelGameEngine::SpanWriter
+  {
+    PixelGameEngine *pge;
+    Pixel *pData;
+    int32_t nPitch;
+    sClipRect clip;
+    float fBlend;
 
-    auto computeCode = [&](tDX::vf2d v)
+    inline void Put(int32_t x, int32_t y, Pixel *d, Pixel p) const
     {
-      char code = inside;
-
-      if (v.x < clipWinPos.x)
-        code |= left;
-      else if (v.x > xMax)
-        code |= right;
-      if (v.y < clipWinPos.y)
-        code |= bottom;
-      else if (v.y > yMax)
-        code |= top;
+      if constexpr (MODE == Pixel::Mode::MASK)
+      {
+        if (p.a != 255) return;
+        *d = p;
+      }
+      else if constexpr (MODE == Pixel::Mode::ALPHA)
+      {
+        float a = (float)(p.a / 255.0f) * fBlend;
+        float c = 1.0f - a;
+        float r = a * (float)p.r + c * (float)d->r;
+        float g = a * (float)p.g + c * (float)d->g;
+        float b = a * (float)p.b + c * (float)d->b;
+        *d = Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b);
+      }
+      else if constexpr (MODE == Pixel::Mode::CUSTOM)
+        *d = pge->funcPixelMode(x, y, p, *d);
+      else
+        *d = p;
 
-      return code;
-    };
+#ifdef T_DBG_OVERDRAW
+      Sprite::nOverdrawCount++;
+#endif
+    }
 
-    char code1 = computeCode(v1);
-    char code2 = computeCode(v2);
+    // Single pixel, dropped when it falls outside the clip rect
+    inline void Plot(int32_t x, int32_t y, Pixel p) const
+    {
+      if constexpr (MODE == DRAW_OVERRIDE)
+        pge->Draw(x, y, p);
+      else if (!CLIP || (x >= clip.x0 && x < clip.x1 && y >= clip.y0 && y < clip.y1))
+        Put(x, y, pData + y * nPitch + x, p);
+    }
 
-    while (true)
+    // Horizontal run from x0 to x1 inclusive, clipped once per run
+    inline void Span(int32_t x0, int32_t x1, int32_t y, Pixel p) const
     {
-      if ((code1 == 0) && (code2 == 0)) // both inside
-      {
-        break;
-      }
-      else if (code1 & code2) // both outside
+      if constexpr (MODE == DRAW_OVERRIDE)
       {
-        return;
+        for (int32_t x = x0; x <= x1; x++)
+          pge->Draw(x, y, p);
       }
       else
       {
-        float x, y;
-        char codeOut = code1 == 0 ? code2 : code1;
-
-        // y = y1 + slope * (x - x1),
-        // x = x1 + (1 / slope) * (y - y1)
-        if (codeOut & top) // above
+        if constexpr (CLIP)
         {
-          x = x1 + (x2 - x1) * (yMax - y1) / (y2 - y1);
-          y = yMax;
+          if (y < clip.y0 || y >= clip.y1) return;
+          x0 = std::max(x0, clip.x0);
+          x1 = std::min(x1, clip.x1 - 1);
+        }
+        if (x1 < x0) return;
+
+        Pixel *d = pData + y * nPitch + x0;
+#ifndef T_DBG_OVERDRAW
+        if constexpr (MODE == Pixel::Mode::NORMAL)
+        {
+          std::fill(d, d + (x1 - x0 + 1), p);
+          return;
+        }
+#endif
+        for (int32_t x = x0; x <= x1; x++, d++)
+          Put(x, y, d, p);
+      }
+    }
+  };
+
+  // (x0,y0) to (x1,y1) is the inclusive bounding box of everything the primitive may write
+  template <class F>
+  void PixelGameEngine::tDX_Dispatch(int32_t x0, int32_t y0, int32_t x1, int32_t y1, F&& fn)
+  {
+    if (!pDrawTarget) return;
+
+    sClipRect c = tDX_GetClip();
+    if (x1 < c.x0 || y1 < c.y0 || x0 >= c.x1 || y0 >= c.y1) return;
+
+    if (x0 >= c.x0 && y0 >= c.y0 && x1 < c.x1 && y1 < c.y1)
+      tDX_DispatchMode<false>(c, fn);
+    else
+      tDX_DispatchMode<true>(c, fn);
+  }
+
+  template <bool CLIP, class F>
+  void PixelGameEngine::tDX_DispatchMode(const sClipRect& c, F&& fn)
+  {
+    Pixel *data = pDrawTarget->GetData();
+    int32_t pitch = pDrawTarget->GetPitch();
+
+    if (bDrawOverride)
+    {
+      fn(SpanWriter<DRAW_OVERRIDE, CLIP>{ this, data, pitch, c, fBlendFactor });
+      return;
+    }
+
+    switch (nPixelMode)
+    {
+    case Pixel::Mode::NORMAL: fn(SpanWriter<Pixel::Mode::NORMAL, CLIP>{ this, data, pitch, c, fBlendFactor }); break;
+    case Pixel::Mode::MASK:   fn(SpanWriter<Pixel::Mode::MASK, CLIP>{ this, data, pitch, c, fBlendFactor }); break;
+    case Pixel::Mode::ALPHA:  fn(SpanWriter<Pixel::Mode::ALPHA, CLIP>{ this, data, pitch, c, fBlendFactor }); break;
+    case Pixel::Mode::CUSTOM: fn(SpanWriter<Pixel::Mode::CUSTOM, CLIP>{ this, data, pitch, c, fBlendFactor }); break;
+    }
+  }
+
+  PixelGameEngine::sClipRect PixelGameEngine::tDX_GetClip()
+  {
+    sClipRect c = { 0, 0, pDrawTarget->width, pDrawTarget->height };
+    if (!vClipStack.empty())
+    {
+      const sClipRect& t = vClipStack.back();
+      c = { std::max(c.x0, t.x0), std::max(c.y0, t.y0), std::min(c.x1, t.x1), std::min(c.y1, t.y1) };
+    }
+    return c;
+  }
+
+  void PixelGameEngine::PushClipRect(int32_t x, int32_t y, int32_t w, int32_t h)
+  {
+    sClipRect c = { x, y, x + std::max(w, 0), y + std::max(h, 0) };
+    if (!vClipStack.empty())
+    {
+      const sClipRect& t = vClipStack.back();
+      c = { std::max(c.x0, t.x0), std::max(c.y0, t.y0), std::min(c.x1, t.x1), std::min(c.y1, t.y1) };
+    }
+    vClipStack.push_back(c);
+  }
+
+  void PixelGameEngine::PushClipRect(const tDX::vi2d& pos, const tDX::vi2d& size)
+  {
+    PushClipRect(pos.x, pos.y, size.x, size.y);
+  }
+
+  void PixelGameEngine::PopClipRect()
+  {
+    if (!vClipStack.empty())
+      vClipStack.pop_back();
+  }
+
+  void PixelGameEngine::EnableDrawOverride(bool bEnable)
+  {
+    bDrawOverride = bEnable;
+  }
+
+  bool PixelGameEngine::Draw(const tDX::vi2d& pos, Pixel p)
+  {
+    return Draw(pos.x, pos.y, p);
+  }
+
+  bool PixelGameEngine::Draw(int32_t x, int32_t y, Pixel p)
+  {
+    if (!pDrawTarget) return false;
+
+    // A single pixel can only be clipped here
+    sClipRect c = tDX_GetClip();
+    if (x < c.x0 || y < c.y0 || x >= c.x1 || y >= c.y1) return false;
+
+    if (nPixelMode == Pixel::Mode::NORMAL)
+    {
+      return pDrawTarget->SetPixel(x, y, p);
+    }
+
+    if (nPixelMode == Pixel::Mode::MASK)
+    {
+      if (p.a == 255)
+        return pDrawTarget->SetPixel(x, y, p);
+    }
+
+    if (nPixelMode == Pixel::Mode::ALPHA)
+    {
+      Pixel d = pDrawTarget->GetPixel(x, y);
+      float a = (float)(p.a / 255.0f) * fBlendFactor;
+      float c = 1.0f - a;
+      float r = a * (float)p.r + c * (float)d.r;
+      float g = a * (float)p.g + c * (float)d.g;
+      float b = a * (float)p.b + c * (float)d.b;
+      return pDrawTarget->SetPixel(x, y, Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b));
+    }
+
+    if (nPixelMode == Pixel::Mode::CUSTOM)
+    {
+      return pDrawTarget->SetPixel(x, y, funcPixelMode(x, y, p, pDrawTarget->GetPixel(x, y)));
+    }
+
+    return false;
+  }
+
+  void PixelGameEngine::SetSubPixelOffset(float ox, float oy)
+  {
+    fSubPixelOffsetX = ox * fPixelX;
+    fSubPixelOffsetY = oy * fPixelY;
+  }
+
+  void PixelGameEngine::DrawLineClipped(float x1, float y1, float x2, float y2, const tDX::vf2d& clipWinPos, const tDX::vf2d& clipWinSize, Pixel p)
+  {
+    tDX::vf2d v1 = { x1, y1 };
+    tDX::vf2d v2 = { x2, y2 };
+
+    const char inside = 0; // 0000
+    const char left = 1;   // 0001
+    const char right = 2;  // 0010
+    const char bottom = 4; // 0100
+    const char top = 8;    // 1000
+
+    float xMax = clipWinPos.x + clipWinSize.x;
+    float xMin = clipWinPos.x;
+
+    float yMax = clipWinPos.y + clipWinSize.y;
+    float yMin = clipWinPos.y;
+
+    auto computeCode = [&](tDX::vf2d v)
+    {
+      char code = inside;
+
+      if (v.x < clipWinPos.x)
+        code |= left;
+      else if (v.x > xMax)
+        code |= right;
+      if (v.y < clipWinPos.y)
+        code |= bottom;
+      else if (v.y > yMax)
+        code |= top;
+
+      return code;
+    };
+
+    char code1 = computeCode(v1);
+    char code2 = computeCode(v2);
+
+    while (true)
+    {
+      if ((code1 == 0) && (code2 == 0)) // both inside
+      {
+        break;
+      }
+      else if (code1 & code2) // both outside
+      {
+        return;
+      }
+      else
+      {
+        float x, y;
+        char codeOut = code1 == 0 ? code2 : code1;
+
+        // y = y1 + slope * (x - x1),
+        // x = x1 + (1 / slope) * (y - y1)
+        if (codeOut & top) // above
+        {
+          x = x1 + (x2 - x1) * (yMax - y1) / (y2 - y1);
+          y = yMax;
         }
         else if (codeOut & bottom) // bellow
         {
@@ -1391,94 +2208,157 @@ namespace tDX
     DrawLine(v1, v2, p);
   }
 
+  void PixelGameEngine::DrawLineClipped(float x1, float y1, float x2, float y2, Pixel p)
+  {
+    if (!pDrawTarget) return;
+
+    // The window is inclusive, the clip rect is not
+    sClipRect c = tDX_GetClip();
+    if (c.x1 <= c.x0 || c.y1 <= c.y0) return;
+
+    DrawLineClipped(x1, y1, x2, y2, { (float)c.x0, (float)c.y0 }, { (float)(c.x1 - 1 - c.x0), (float)(c.y1 - 1 - c.y0) }, p);
+  }
+
   void PixelGameEngine::DrawLine(const tDX::vi2d& pos1, const tDX::vi2d& pos2, Pixel p, uint32_t pattern)
   {
     DrawLine(pos1.x, pos1.y, pos2.x, pos2.y, p, pattern);
   }
 
-  void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern)
+  // Error term of the walk along the major axis (length d1, minor length d2) after n
+  // steps and the minor steps k taken so far, so clipped off steps need not be walked.
+  // The products may wrap in 64 bits but the error itself is small and comes out exact.
+  // The term stays in [2*d2 - 2*d1, 2*d2), or (2*d2 - 2*d1, 2*d2] when bUpper is set
+  static int64_t tDX_LineErrorAt(int64_t n, int64_t d1, int64_t d2, bool bUpper, int64_t &k)
   {
-    int x, y, dx, dy, dx1, dy1, px, py, xe, ye, i;
-    dx = x2 - x1; dy = y2 - y1;
-
-    auto rol = [&](void)
-    {
-      pattern = (pattern << 1) | (pattern >> 31);
-      return pattern & 1;
-    };
-
-    // straight lines idea by gurkanctn
-    if (dx == 0) // Line is vertical
-    {
-      if (y2 < y1) std::swap(y1, y2);
-      for (y = y1; y <= y2; y++)
-        if (rol()) Draw(x1, y, p);
-      return;
-    }
+    k = (int64_t)(((double)n * (double)d2 * 2.0 + (double)d1) / (2.0 * (double)d1));
+    int64_t e = (int64_t)((uint64_t)(2 * d2 - d1) + 2 * (uint64_t)n * (uint64_t)d2 - 2 * (uint64_t)k * (uint64_t)d1);
+    while (bUpper ? e > 2 * d2 : e >= 2 * d2) { k++; e -= 2 * d1; }
+    while (bUpper ? e <= 2 * d2 - 2 * d1 : e < 2 * d2 - 2 * d1) { k--; e += 2 * d1; }
+    return e;
+  }
 
-    if (dy == 0) // Line is horizontal
+  void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern)
+  {
+    tDX_Dispatch(std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), std::max(y1, y2), [&](const auto &out)
     {
-      if (x2 < x1) std::swap(x1, x2);
-      for (x = x1; x <= x2; x++)
-        if (rol()) Draw(x, y1, p);
-      return;
-    }
+      // The walk is cut to the clip rect along its major axis, so a line reaching far off
+      // the target costs no more than one across it. The pixels inside are the same as
+      // for the whole line, the minor axis is still clipped per pixel by the writer
+      const sClipRect &c = out.clip;
+      int64_t x, y, dx, dy, dx1, dy1, px, py, xe, ye, k, n0, n1;
+      dx = (int64_t)x2 - x1; dy = (int64_t)y2 - y1;
+
+      auto rol = [&](void)
+      {
+        pattern = (pattern << 1) | (pattern >> 31);
+        return pattern & 1;
+      };
 
-    // Line is Funk-aye
-    dx1 = abs(dx); dy1 = abs(dy);
-    px = 2 * dy1 - dx1;	py = 2 * dx1 - dy1;
-    if (dy1 <= dx1)
-    {
-      if (dx >= 0)
+      // Skipped pixels still turn the pattern
+      auto skip = [&](int64_t n)
       {
-        x = x1; y = y1; xe = x2;
-      }
-      else
+        uint32_t r = (uint32_t)(n & 31);
+        if (r) pattern = (pattern << r) | (pattern >> (32 - r));
+      };
+
+      // straight lines idea by gurkanctn
+      if (dx == 0) // Line is vertical
       {
-        x = x2; y = y2; xe = x1;
+        if (y2 < y1) std::swap(y1, y2);
+        ye = std::min<int64_t>(y2, c.y1 - 1);
+        y = std::max<int64_t>(y1, c.y0);
+        skip(y - y1);
+        for (; y <= ye; y++)
+          if (rol()) out.Plot(x1, (int32_t)y, p);
+        return;
       }
 
-      if (rol()) Draw(x, y, p);
-
-      for (i = 0; x < xe; i++)
+      if (dy == 0) // Line is horizontal
       {
-        x = x + 1;
-        if (px < 0)
-          px = px + 2 * dy1;
+        if (x2 < x1) std::swap(x1, x2);
+        if (pattern == 0xFFFFFFFF)
+          out.Span(x1, x2, y1, p);
         else
         {
-          if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) y = y + 1; else y = y - 1;
-          px = px + 2 * (dy1 - dx1);
+          xe = std::min<int64_t>(x2, c.x1 - 1);
+          x = std::max<int64_t>(x1, c.x0);
+          skip(x - x1);
+          for (; x <= xe; x++)
+            if (rol()) out.Plot((int32_t)x, y1, p);
         }
-        if (rol()) Draw(x, y, p);
+        return;
       }
-    }
-    else
-    {
-      if (dy >= 0)
+
+      // Line is Funk-aye
+      dx1 = std::abs(dx); dy1 = std::abs(dy);
+      int64_t sm = ((dx < 0) == (dy < 0)) ? 1 : -1; // Minor step per increment
+      if (dy1 <= dx1)
       {
-        x = x1; y = y1; ye = y2;
+        if (dx >= 0)
+        {
+          x = x1; y = y1; xe = x2;
+        }
+        else
+        {
+          x = x2; y = y2; xe = x1;
+        }
+
+        n0 = std::max<int64_t>(0, c.x0 - x);
+        n1 = std::min<int64_t>(xe, c.x1 - 1) - x;
+        if (n0 > n1) return;
+        px = tDX_LineErrorAt(n0, dx1, dy1, false, k);
+        x += n0; y += sm * k; xe = x + (n1 - n0);
+        skip(n0);
+
+        if (rol()) out.Plot((int32_t)x, (int32_t)y, p);
+
+        while (x < xe)
+        {
+          x = x + 1;
+          if (px < 0)
+            px = px + 2 * dy1;
+          else
+          {
+            y = y + sm;
+            px = px + 2 * (dy1 - dx1);
+          }
+          if (rol()) out.Plot((int32_t)x, (int32_t)y, p);
+        }
       }
       else
       {
-        x = x2; y = y2; ye = y1;
-      }
+        if (dy >= 0)
+        {
+          x = x1; y = y1; ye = y2;
+        }
+        else
+        {
+          x = x2; y = y2; ye = y1;
+        }
 
-      if (rol()) Draw(x, y, p);
+        n0 = std::max<int64_t>(0, c.y0 - y);
+        n1 = std::min<int64_t>(ye, c.y1 - 1) - y;
+        if (n0 > n1) return;
+        py = tDX_LineErrorAt(n0, dy1, dx1, true, k);
+        y += n0; x += sm * k; ye = y + (n1 - n0);
+        skip(n0);
 
-      for (i = 0; y < ye; i++)
-      {
-        y = y + 1;
-        if (py <= 0)
-          py = py + 2 * dx1;
-        else
+        if (rol()) out.Plot((int32_t)x, (int32_t)y, p);
+
+        while (y < ye)
         {
-          if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) x = x + 1; else x = x - 1;
-          py = py + 2 * (dx1 - dy1);
+          y = y + 1;
+          if (py <= 0)
+            py = py + 2 * dx1;
+          else
+          {
+            x = x + sm;
+            py = py + 2 * (dx1 - dy1);
+          }
+          if (rol()) out.Plot((int32_t)x, (int32_t)y, p);
         }
-        if (rol()) Draw(x, y, p);
       }
-    }
+    });
   }
 
   void PixelGameEngine::DrawCircle(const tDX::vi2d& pos, int32_t radius, Pixel p, uint8_t mask)
@@ -1493,19 +2373,22 @@ namespace tDX
     int d = 3 - 2 * radius;
     if (!radius) return;
 
-    while (y0 >= x0) // only formulate 1/8 of circle
-    {
-      if (mask & 0x01) Draw(x + x0, y - y0, p);
-      if (mask & 0x02) Draw(x + y0, y - x0, p);
-      if (mask & 0x04) Draw(x + y0, y + x0, p);
-      if (mask & 0x08) Draw(x + x0, y + y0, p);
-      if (mask & 0x10) Draw(x - x0, y + y0, p);
-      if (mask & 0x20) Draw(x - y0, y + x0, p);
-      if (mask & 0x40) Draw(x - y0, y - x0, p);
-      if (mask & 0x80) Draw(x - x0, y - y0, p);
-      if (d < 0) d += 4 * x0++ + 6;
-      else d += 4 * (x0++ - y0--) + 10;
-    }
+    tDX_Dispatch(x - radius, y - radius, x + radius, y + radius, [&](const auto &out)
+    {
+      while (y0 >= x0) // only formulate 1/8 of circle
+      {
+        if (mask & 0x01) out.Plot(x + x0, y - y0, p);
+        if (mask & 0x02) out.Plot(x + y0, y - x0, p);
+        if (mask & 0x04) out.Plot(x + y0, y + x0, p);
+        if (mask & 0x08) out.Plot(x + x0, y + y0, p);
+        if (mask & 0x10) out.Plot(x - x0, y + y0, p);
+        if (mask & 0x20) out.Plot(x - y0, y + x0, p);
+        if (mask & 0x40) out.Plot(x - y0, y - x0, p);
+        if (mask & 0x80) out.Plot(x - x0, y - y0, p);
+        if (d < 0) d += 4 * x0++ + 6;
+        else d += 4 * (x0++ - y0--) + 10;
+      }
+    });
   }
 
   void PixelGameEngine::FillCircle(const tDX::vi2d& pos, int32_t radius, Pixel p)
@@ -1521,22 +2404,24 @@ namespace tDX
     int d = 3 - 2 * radius;
     if (!radius) return;
 
-    auto drawline = [&](int sx, int ex, int ny)
+    tDX_Dispatch(x - radius, y - radius, x + radius, y + radius, [&](const auto &out)
     {
-      for (int i = sx; i <= ex; i++)
-        Draw(i, ny, p);
-    };
+      auto drawline = [&](int sx, int ex, int ny)
+      {
+        out.Span(sx, ex, ny, p);
+      };
 
-    while (y0 >= x0)
-    {
-      // Modified to draw scan-lines instead of edges
-      drawline(x - x0, x + x0, y - y0);
-      drawline(x - y0, x + y0, y - x0);
-      drawline(x - x0, x + x0, y + y0);
-      drawline(x - y0, x + y0, y + x0);
-      if (d < 0) d += 4 * x0++ + 6;
-      else d += 4 * (x0++ - y0--) + 10;
-    }
+      while (y0 >= x0)
+      {
+        // Modified to draw scan-lines instead of edges
+        drawline(x - x0, x + x0, y - y0);
+        drawline(x - y0, x + y0, y - x0);
+        drawline(x - x0, x + x0, y + y0);
+        drawline(x - y0, x + y0, y + x0);
+        if (d < 0) d += 4 * x0++ + 6;
+        else d += 4 * (x0++ - y0--) + 10;
+      }
+    });
   }
 
   void PixelGameEngine::DrawRect(const tDX::vi2d& pos, const tDX::vi2d& size, Pixel p)
@@ -1554,12 +2439,18 @@ namespace tDX
 
   void PixelGameEngine::Clear(Pixel p)
   {
-    int pixels = GetDrawTargetWidth() * GetDrawTargetHeight();
-    Pixel* m = GetDrawTarget()->GetData();
-    for (int i = 0; i < pixels; i++)
-      m[i] = p;
+    if (!pDrawTarget) return;
+
+    // Only the area inside the clip rect is cleared
+    sClipRect c = tDX_GetClip();
+    if (c.x0 >= c.x1 || c.y0 >= c.y1) return;
+
+    int32_t pitch = pDrawTarget->GetPitch();
+    Pixel* m = pDrawTarget->GetData() + c.y0 * pitch;
+    for (int y = c.y0; y < c.y1; y++, m += pitch)
+      std::fill(m + c.x0, m + c.x1, p);
 #ifdef T_DBG_OVERDRAW
-    tDX::Sprite::nOverdrawCount += pixels;
+    tDX::Sprite::nOverdrawCount += (c.x1 - c.x0) * (c.y1 - c.y0);
 #endif
   }
 
@@ -1570,22 +2461,20 @@ namespace tDX
 
   void PixelGameEngine::FillRect(int32_t x, int32_t y, int32_t w, int32_t h, Pixel p)
   {
-    int32_t x2 = x + w;
-    int32_t y2 = y + h;
+    if (!pDrawTarget) return;
 
-    if (x < 0) x = 0;
-    if (x >= (int32_t)GetDrawTargetWidth()) x = (int32_t)GetDrawTargetWidth();
-    if (y < 0) y = 0;
-    if (y >= (int32_t)GetDrawTargetHeight()) y = (int32_t)GetDrawTargetHeight();
+    sClipRect c = tDX_GetClip();
+    int32_t x2 = std::min(x + w, c.x1);
+    int32_t y2 = std::min(y + h, c.y1);
+    x = std::max(x, c.x0);
+    y = std::max(y, c.y0);
+    if (x >= x2 || y >= y2) return;
 
-    if (x2 < 0) x2 = 0;
-    if (x2 >= (int32_t)GetDrawTargetWidth()) x2 = (int32_t)GetDrawTargetWidth();
-    if (y2 < 0) y2 = 0;
-    if (y2 >= (int32_t)GetDrawTargetHeight()) y2 = (int32_t)GetDrawTargetHeight();
-
-    for (int i = x; i < x2; i++)
+    tDX_Dispatch(x, y, x2 - 1, y2 - 1, [&](const auto &out)
+    {
       for (int j = y; j < y2; j++)
-        Draw(i, j, p);
+        out.Span(x, x2 - 1, j, p);
+    });
   }
 
   void PixelGameEngine::DrawTriangle(const tDX::vi2d& pos1, const tDX::vi2d& pos2, const tDX::vi2d& pos3, Pixel p)
@@ -1608,143 +2497,146 @@ namespace tDX
   // https://www.avrfreaks.net/sites/default/files/triangles.c
   void PixelGameEngine::FillTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p)
   {
-    auto SWAP = [](int &x, int &y) { int t = x; x = y; y = t; };
-    auto drawline = [&](int sx, int ex, int ny) { for (int i = sx; i <= ex; i++) Draw(i, ny, p); };
-
-    int t1x, t2x, y, minx, maxx, t1xp, t2xp;
-    bool changed1 = false;
-    bool changed2 = false;
-    int signx1, signx2, dx1, dy1, dx2, dy2;
-    int e1, e2;
-    // Sort vertices
-    if (y1 > y2) { SWAP(y1, y2); SWAP(x1, x2); }
-    if (y1 > y3) { SWAP(y1, y3); SWAP(x1, x3); }
-    if (y2 > y3) { SWAP(y2, y3); SWAP(x2, x3); }
-
-    t1x = t2x = x1; y = y1;   // Starting points
-    dx1 = (int)(x2 - x1); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
-    else signx1 = 1;
-    dy1 = (int)(y2 - y1);
-
-    dx2 = (int)(x3 - x1); if (dx2 < 0) { dx2 = -dx2; signx2 = -1; }
-    else signx2 = 1;
-    dy2 = (int)(y3 - y1);
-
-    if (dy1 > dx1) {   // swap values
-      SWAP(dx1, dy1);
-      changed1 = true;
-    }
-    if (dy2 > dx2) {   // swap values
-      SWAP(dy2, dx2);
-      changed2 = true;
-    }
-
-    e2 = (int)(dx2 >> 1);
-    // Flat top, just process the second half
-    if (y1 == y2) goto next;
-    e1 = (int)(dx1 >> 1);
-
-    for (int i = 0; i < dx1;) {
-      t1xp = 0; t2xp = 0;
-      if (t1x < t2x) { minx = t1x; maxx = t2x; }
-      else { minx = t2x; maxx = t1x; }
-      // process first line until y value is about to change
-      while (i < dx1) {
-        i++;
-        e1 += dy1;
-        while (e1 >= dx1) {
-          e1 -= dx1;
-          if (changed1) t1xp = signx1;//t1x += signx1;
-          else          goto next1;
-        }
-        if (changed1) break;
-        else t1x += signx1;
+    tDX_Dispatch(std::min({ x1, x2, x3 }), std::min({ y1, y2, y3 }), std::max({ x1, x2, x3 }), std::max({ y1, y2, y3 }), [&](const auto &out)
+    {
+      auto SWAP = [](int &x, int &y) { int t = x; x = y; y = t; };
+      auto drawline = [&](int sx, int ex, int ny) { out.Span(sx, ex, ny, p); };
+
+      int t1x, t2x, y, minx, maxx, t1xp, t2xp;
+      bool changed1 = false;
+      bool changed2 = false;
+      int signx1, signx2, dx1, dy1, dx2, dy2;
+      int e1, e2;
+      // Sort vertices
+      if (y1 > y2) { SWAP(y1, y2); SWAP(x1, x2); }
+      if (y1 > y3) { SWAP(y1, y3); SWAP(x1, x3); }
+      if (y2 > y3) { SWAP(y2, y3); SWAP(x2, x3); }
+
+      t1x = t2x = x1; y = y1;   // Starting points
+      dx1 = (int)(x2 - x1); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
+      else signx1 = 1;
+      dy1 = (int)(y2 - y1);
+
+      dx2 = (int)(x3 - x1); if (dx2 < 0) { dx2 = -dx2; signx2 = -1; }
+      else signx2 = 1;
+      dy2 = (int)(y3 - y1);
+
+      if (dy1 > dx1) {   // swap values
+        SWAP(dx1, dy1);
+        changed1 = true;
       }
-      // Move line
-    next1:
-      // process second line until y value is about to change
-      while (1) {
-        e2 += dy2;
-        while (e2 >= dx2) {
-          e2 -= dx2;
-          if (changed2) t2xp = signx2;//t2x += signx2;
-          else          goto next2;
-        }
-        if (changed2)     break;
-        else              t2x += signx2;
+      if (dy2 > dx2) {   // swap values
+        SWAP(dy2, dx2);
+        changed2 = true;
       }
-    next2:
-      if (minx > t1x) minx = t1x;
-      if (minx > t2x) minx = t2x;
-      if (maxx < t1x) maxx = t1x;
-      if (maxx < t2x) maxx = t2x;
-      drawline(minx, maxx, y);    // Draw line from min to max points found on the y
-                    // Now increase y
-      if (!changed1) t1x += signx1;
-      t1x += t1xp;
-      if (!changed2) t2x += signx2;
-      t2x += t2xp;
-      y += 1;
-      if (y == y2) break;
 
-    }
-  next:
-    // Second half
-    dx1 = (int)(x3 - x2); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
-    else signx1 = 1;
-    dy1 = (int)(y3 - y2);
-    t1x = x2;
-
-    if (dy1 > dx1) {   // swap values
-      SWAP(dy1, dx1);
-      changed1 = true;
-    }
-    else changed1 = false;
-
-    e1 = (int)(dx1 >> 1);
-
-    for (int i = 0; i <= dx1; i++) {
-      t1xp = 0; t2xp = 0;
-      if (t1x < t2x) { minx = t1x; maxx = t2x; }
-      else { minx = t2x; maxx = t1x; }
-      // process first line until y value is about to change
-      while (i < dx1) {
-        e1 += dy1;
-        while (e1 >= dx1) {
-          e1 -= dx1;
-          if (changed1) { t1xp = signx1; break; }//t1x += signx1;
-          else          goto next3;
+      e2 = (int)(dx2 >> 1);
+      // Flat top, just process the second half
+      if (y1 == y2) goto next;
+      e1 = (int)(dx1 >> 1);
+
+      for (int i = 0; i < dx1;) {
+        t1xp = 0; t2xp = 0;
+        if (t1x < t2x) { minx = t1x; maxx = t2x; }
+        else { minx = t2x; maxx = t1x; }
+        // process first line until y value is about to change
+        while (i < dx1) {
+          i++;
+          e1 += dy1;
+          while (e1 >= dx1) {
+            e1 -= dx1;
+            if (changed1) t1xp = signx1;//t1x += signx1;
+            else          goto next1;
+          }
+          if (changed1) break;
+          else t1x += signx1;
         }
-        if (changed1) break;
-        else   	   	  t1x += signx1;
-        if (i < dx1) i++;
+        // Move line
+      next1:
+        // process second line until y value is about to change
+        while (1) {
+          e2 += dy2;
+          while (e2 >= dx2) {
+            e2 -= dx2;
+            if (changed2) t2xp = signx2;//t2x += signx2;
+            else          goto next2;
+          }
+          if (changed2)     break;
+          else              t2x += signx2;
+        }
+      next2:
+        if (minx > t1x) minx = t1x;
+        if (minx > t2x) minx = t2x;
+        if (maxx < t1x) maxx = t1x;
+        if (maxx < t2x) maxx = t2x;
+        drawline(minx, maxx, y);    // Draw line from min to max points found on the y
+                      // Now increase y
+        if (!changed1) t1x += signx1;
+        t1x += t1xp;
+        if (!changed2) t2x += signx2;
+        t2x += t2xp;
+        y += 1;
+        if (y == y2) break;
+
+      }
+    next:
+      // Second half
+      dx1 = (int)(x3 - x2); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
+      else signx1 = 1;
+      dy1 = (int)(y3 - y2);
+      t1x = x2;
+
+      if (dy1 > dx1) {   // swap values
+        SWAP(dy1, dx1);
+        changed1 = true;
       }
-    next3:
-      // process second line until y value is about to change
-      while (t2x != x3) {
-        e2 += dy2;
-        while (e2 >= dx2) {
-          e2 -= dx2;
-          if (changed2) t2xp = signx2;
-          else          goto next4;
+      else changed1 = false;
+
+      e1 = (int)(dx1 >> 1);
+
+      for (int i = 0; i <= dx1; i++) {
+        t1xp = 0; t2xp = 0;
+        if (t1x < t2x) { minx = t1x; maxx = t2x; }
+        else { minx = t2x; maxx = t1x; }
+        // process first line until y value is about to change
+        while (i < dx1) {
+          e1 += dy1;
+          while (e1 >= dx1) {
+            e1 -= dx1;
+            if (changed1) { t1xp = signx1; break; }//t1x += signx1;
+            else          goto next3;
+          }
+          if (changed1) break;
+          else   	   	  t1x += signx1;
+          if (i < dx1) i++;
+        }
+      next3:
+        // process second line until y value is about to change
+        while (t2x != x3) {
+          e2 += dy2;
+          while (e2 >= dx2) {
+            e2 -= dx2;
+            if (changed2) t2xp = signx2;
+            else          goto next4;
+          }
+          if (changed2)     break;
+          else              t2x += signx2;
         }
-        if (changed2)     break;
-        else              t2x += signx2;
+      next4:
+
+        if (minx > t1x) minx = t1x;
+        if (minx > t2x) minx = t2x;
+        if (maxx < t1x) maxx = t1x;
+        if (maxx < t2x) maxx = t2x;
+        drawline(minx, maxx, y);
+        if (!changed1) t1x += signx1;
+        t1x += t1xp;
+        if (!changed2) t2x += signx2;
+        t2x += t2xp;
+        y += 1;
+        if (y > y3) return;
       }
-    next4:
-
-      if (minx > t1x) minx = t1x;
-      if (minx > t2x) minx = t2x;
-      if (maxx < t1x) maxx = t1x;
-      if (maxx < t2x) maxx = t2x;
-      drawline(minx, maxx, y);
-      if (!changed1) t1x += signx1;
-      t1x += t1xp;
-      if (!changed2) t2x += signx2;
-      t2x += t2xp;
-      y += 1;
-      if (y > y3) return;
-    }
+    });
   }
 
   void PixelGameEngine::DrawSprite(const tDX::vi2d& pos, Sprite *sprite, uint32_t scale)
@@ -1757,20 +2649,22 @@ namespace tDX
     if (sprite == nullptr)
       return;
 
-    if (scale > 1)
+    tDX_Dispatch(x, y, x + sprite->width * (int32_t)scale - 1, y + sprite->height * (int32_t)scale - 1, [&](const auto &out)
     {
-      for (int32_t i = 0; i < sprite->width; i++)
-        for (int32_t j = 0; j < sprite->height; j++)
-          for (uint32_t is = 0; is < scale; is++)
+      if (scale > 1)
+      {
+        for (int32_t i = 0; i < sprite->width; i++)
+          for (int32_t j = 0; j < sprite->height; j++)
             for (uint32_t js = 0; js < scale; js++)
-              Draw(x + (i*scale) + is, y + (j*scale) + js, sprite->GetPixel(i, j));
-    }
-    else
-    {
-      for (int32_t i = 0; i < sprite->width; i++)
+              out.Span(x + (i*scale), x + (i*scale) + scale - 1, y + (j*scale) + js, sprite->GetPixel(i, j));
+      }
+      else
+      {
         for (int32_t j = 0; j < sprite->height; j++)
-          Draw(x + i, y + j, sprite->GetPixel(i, j));
-    }
+          for (int32_t i = 0; i < sprite->width; i++)
+            out.Plot(x + i, y + j, sprite->GetPixel(i, j));
+      }
+    });
   }
 
   void PixelGameEngine::DrawPartialSprite(const tDX::vi2d& pos, Sprite *sprite, const tDX::vi2d& sourcepos, const tDX::vi2d& size, uint32_t scale)
@@ -1783,20 +2677,22 @@ namespace tDX
     if (sprite == nullptr)
       return;
 
-    if (scale > 1)
+    tDX_Dispatch(x, y, x + w * (int32_t)scale - 1, y + h * (int32_t)scale - 1, [&](const auto &out)
     {
-      for (int32_t i = 0; i < w; i++)
-        for (int32_t j = 0; j < h; j++)
-          for (uint32_t is = 0; is < scale; is++)
+      if (scale > 1)
+      {
+        for (int32_t i = 0; i < w; i++)
+          for (int32_t j = 0; j < h; j++)
             for (uint32_t js = 0; js < scale; js++)
-              Draw(x + (i*scale) + is, y + (j*scale) + js, sprite->GetPixel(i + ox, j + oy));
-    }
-    else
-    {
-      for (int32_t i = 0; i < w; i++)
+              out.Span(x + (i*scale), x + (i*scale) + scale - 1, y + (j*scale) + js, sprite->GetPixel(i + ox, j + oy));
+      }
+      else
+      {
         for (int32_t j = 0; j < h; j++)
-          Draw(x + i, y + j, sprite->GetPixel(i + ox, j + oy));
-    }
+          for (int32_t i = 0; i < w; i++)
+            out.Plot(x + i, y + j, sprite->GetPixel(i + ox, j + oy));
+      }
+    });
   }
 
   void PixelGameEngine::DrawString(const tDX::vi2d& pos, const std::string& sText, Pixel col, uint32_t scale)
@@ -1814,37 +2710,524 @@ namespace tDX
     else
       SetPixelMode(Pixel::Mode::MASK);
 
+    const std::vector<sTextSpan> *cached = nTextCacheMaxBytes > 0 ? tDX_GetCachedText(sText, scale) : nullptr;
+
+    // Extent of the text in cells, for the clip test
+    int32_t nCols = 0, nRows = 1, nCol = 0;
     for (auto c : sText)
+      if (c == '\n') { nRows++; nCol = 0; }
+      else nCols = std::max(nCols, ++nCol);
+    int32_t nCell = 8 * (int32_t)scale;
+
+    tDX_Dispatch(x, y, x + nCols * nCell - 1, y + nRows * nCell - 1, [&](const auto &out)
     {
-      if (c == '\n')
+      if (cached)
       {
-        sx = 0; sy += 8 * scale;
+        for (const auto &r : *cached)
+          for (uint32_t js = 0; js < scale; js++)
+            out.Span(x + r.x0, x + r.x1, y + r.y + js, col);
+
+        return;
       }
-      else
-      {
-        int32_t ox = (c - 32) % 16;
-        int32_t oy = (c - 32) / 16;
 
-        if (scale > 1)
+      for (auto c : sText)
+      {
+        if (c == '\n')
         {
-          for (uint32_t i = 0; i < 8; i++)
-            for (uint32_t j = 0; j < 8; j++)
-              if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-                for (uint32_t is = 0; is < scale; is++)
+          sx = 0; sy += 8 * scale;
+        }
+        else
+        {
+          int32_t ox = (c - 32) % 16;
+          int32_t oy = (c - 32) / 16;
+
+          if (scale > 1)
+          {
+            for (uint32_t i = 0; i < 8; i++)
+              for (uint32_t j = 0; j < 8; j++)
+                if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
                   for (uint32_t js = 0; js < scale; js++)
-                    Draw(x + sx + (i*scale) + is, y + sy + (j*scale) + js, col);
+                    out.Span(x + sx + (i*scale), x + sx + (i*scale) + scale - 1, y + sy + (j*scale) + js, col);
+          }
+          else
+          {
+            for (uint32_t i = 0; i < 8; i++)
+              for (uint32_t j = 0; j < 8; j++)
+                if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
+                  out.Plot(x + sx + i, y + sy + j, col);
+          }
+          sx += 8 * scale;
         }
+      }
+    });
+    SetPixelMode(m);
+  }
+
+  void PixelGameEngine::SetTextCacheSize(size_t nMaxBytes)
+  {
+    nTextCacheMaxBytes = nMaxBytes;
+    tDX_TrimTextCache(nMaxBytes);
+  }
+
+  TextCacheStats PixelGameEngine::GetTextCacheStats()
+  {
+    textCacheStats.nEntries = listTextCache.size();
+    return textCacheStats;
+  }
+
+  void PixelGameEngine::ResetTextCacheStats()
+  {
+    textCacheStats.nHits = 0;
+    textCacheStats.nMisses = 0;
+    textCacheStats.nEvictions = 0;
+  }
+
+  const std::vector<PixelGameEngine::sTextSpan>* PixelGameEngine::tDX_GetCachedText(const std::string& sText, uint32_t scale)
+  {
+    // Only coverage is kept, so the key is the text followed by the raw scale bytes
+    std::string sKey = sText;
+    sKey.push_back('\0');
+    sKey.append((const char*)&scale, sizeof(uint32_t));
+
+    auto it = mapTextCache.find(sKey);
+    if (it != mapTextCache.end())
+    {
+      textCacheStats.nHits++;
+      listTextCache.splice(listTextCache.begin(), listTextCache, it->second);
+      return &it->second->vSpans;
+    }
+
+    textCacheStats.nMisses++;
+
+    // Split into lines
+    std::vector<std::string> vLines(1);
+    for (auto c : sText)
+    {
+      if (c == '\n') vLines.emplace_back();
+      else vLines.back().push_back(c);
+    }
+
+    // Runs along each font row, joined across neighbouring glyphs
+    std::vector<sTextSpan> vSpans;
+    for (size_t l = 0; l < vLines.size(); l++)
+      for (int32_t j = 0; j < 8; j++)
+      {
+        int32_t nStart = -1;
+        int32_t nWidth = (int32_t)vLines[l].size() * 8;
+        for (int32_t i = 0; i <= nWidth; i++)
+        {
+          bool bSet = false;
+          if (i < nWidth)
+          {
+            int32_t c = vLines[l][i / 8] - 32;
+            bSet = fontSprite->GetPixel((c % 16) * 8 + i % 8, (c / 16) * 8 + j).r > 0;
+          }
+
+          if (bSet && nStart < 0)
+            nStart = i;
+          else if (!bSet && nStart >= 0)
+          {
+            vSpans.push_back({ nStart * (int32_t)scale, i * (int32_t)scale - 1, ((int32_t)l * 8 + j) * (int32_t)scale });
+            nStart = -1;
+          }
+        }
+      }
+
+    size_t nBytes = sKey.size() + vSpans.size() * sizeof(sTextSpan);
+    if (nBytes > nTextCacheMaxBytes)
+      return nullptr;
+
+    tDX_TrimTextCache(nTextCacheMaxBytes - nBytes);
+
+    listTextCache.push_front({ sKey, std::move(vSpans), nBytes });
+    mapTextCache[sKey] = listTextCache.begin();
+    textCacheStats.nBytes += nBytes;
+    return &listTextCache.front().vSpans;
+  }
+
+  void PixelGameEngine::tDX_TrimTextCache(size_t nMaxBytes)
+  {
+    // Evict least recently used strings until we fit
+    while (!listTextCache.empty() && textCacheStats.nBytes > nMaxBytes)
+    {
+      sTextCacheEntry &e = listTextCache.back();
+      textCacheStats.nBytes -= e.nBytes;
+      textCacheStats.nEvictions++;
+      mapTextCache.erase(e.sKey);
+      listTextCache.pop_back();
+    }
+  }
+
+  //==========================================================
+  // Software upscaling
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mux);
+      bQuit = true;
+    }
+    cvWork.notify_all();
+    for (auto &t : vWorkers) t.join();
+  }
+
+  int32_t ThreadPool::GetThreadCount()
+  {
+    return std::max(1, (int32_t)std::thread::hardware_concurrency());
+  }
+
+  void ThreadPool::Run(int32_t nJobs, const std::function<void(int32_t)>& job)
+  {
+    if (nJobs <= 0) return;
+    if (nJobs == 1)
+    {
+      job(0);
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mux);
+    size_t nWanted = (size_t)std::min(nJobs, GetThreadCount()) - 1;
+    while (vWorkers.size() < nWanted)
+      vWorkers.emplace_back(&ThreadPool::tDX_Worker, this);
+
+    pJob = &job;
+    this->nJobs = nJobs;
+    nNext = 0;
+    nPending = nJobs;
+    cvWork.notify_all();
+
+    // The calling thread takes jobs as well instead of just waiting
+    while (tDX_RunNext(lock));
+    cvDone.wait(lock, [&] { return nPending == 0; });
+
+    pJob = nullptr;
+    this->nJobs = 0;
+  }
+
+  // Runs the next job with the lock released, false when none are left
+  bool ThreadPool::tDX_RunNext(std::unique_lock<std::mutex>& lock)
+  {
+    if (nNext >= nJobs) return false;
+
+    int32_t i = nNext++;
+    const std::function<void(int32_t)>* job = pJob;
+    lock.unlock();
+    (*job)(i);
+    lock.lock();
+
+    if (--nPending == 0)
+      cvDone.notify_all();
+    return true;
+  }
+
+  void ThreadPool::tDX_Worker()
+  {
+    std::unique_lock<std::mutex> lock(mux);
+    while (true)
+    {
+      cvWork.wait(lock, [&] { return bQuit || nNext < nJobs; });
+      if (bQuit) return;
+      tDX_RunNext(lock);
+    }
+  }
+
+  ThreadPool& PixelGameEngine::GetThreadPool()
+  {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  // Runs fn over [0,nRows) split into one contiguous range per thread
+  static void tDX_ParallelRows(int32_t nRows, int32_t nThreads, const std::function<void(int32_t, int32_t)>& fn)
+  {
+    if (nThreads <= 0) nThreads = PixelGameEngine::GetThreadPool().GetThreadCount();
+    // Not worth a thread below a few dozen rows
+    nThreads = std::clamp(nThreads, 1, std::max(1, nRows / 32));
+
+    if (nThreads == 1)
+    {
+      fn(0, nRows);
+      return;
+    }
+
+    PixelGameEngine::GetThreadPool().Run(nThreads, [&](int32_t t)
+    {
+      fn((int32_t)((int64_t)nRows * t / nThreads), (int32_t)((int64_t)nRows * (t + 1) / nThreads));
+    });
+  }
+
+  // Every source pixel written nScale times in a row
+  static void tDX_ReplicateRow(const Pixel *src, int32_t w, int32_t nScale, Pixel *dst)
+  {
+    int32_t i = 0;
+    if (nScale == 1)
+    {
+      std::copy(src, src + w, dst);
+      return;
+    }
+#ifdef T_PGE_SSE2
+    if (nScale == 2)
+    {
+      for (; i + 4 <= w; i += 4)
+      {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_unpacklo_epi32(v, v));
+        _mm_storeu_si128((__m128i*)(dst + i * 2 + 4), _mm_unpackhi_epi32(v, v));
+      }
+    }
+    else if (nScale >= 4)
+    {
+      for (; i < w; i++)
+      {
+        __m128i v = _mm_set1_epi32((int)src[i].n);
+        Pixel *d = dst + i * nScale;
+        int32_t k = 0;
+        for (; k + 4 <= nScale; k += 4)
+          _mm_storeu_si128((__m128i*)(d + k), v);
+        for (; k < nScale; k++)
+          d[k] = src[i];
+      }
+    }
+#endif
+    for (; i < w; i++)
+      std::fill_n(dst + i * nScale, nScale, src[i]);
+  }
+
+  // (a * (256 - w) + b * w) / 256 per channel, w in 0..256
+  static inline Pixel tDX_LerpPixel(Pixel a, Pixel b, int32_t w)
+  {
+    // Red and blue, then green and alpha, two channels per multiply
+    uint32_t rb = ((a.n & 0x00FF00FF) * (256 - w) + (b.n & 0x00FF00FF) * w + 0x00800080) >> 8;
+    uint32_t ga = (((a.n >> 8) & 0x00FF00FF) * (256 - w) + ((b.n >> 8) & 0x00FF00FF) * w + 0x00800080);
+    return Pixel((rb & 0x00FF00FF) | (ga & 0xFF00FF00));
+  }
+
+  static void tDX_LerpRows(const Pixel *a, const Pixel *b, int32_t w, int32_t n, Pixel *dst)
+  {
+    int32_t i = 0;
+#ifdef T_PGE_SSE2
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i vA = _mm_set1_epi16((short)(256 - w));
+    const __m128i vB = _mm_set1_epi16((short)w);
+    const __m128i vRound = _mm_set1_epi16(128);
+    auto lerp = [&](__m128i pa, __m128i pb)
+    {
+      __m128i r = _mm_add_epi16(_mm_mullo_epi16(pa, vA), _mm_mullo_epi16(pb, vB));
+      return _mm_srli_epi16(_mm_add_epi16(r, vRound), 8);
+    };
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128i pa = _mm_loadu_si128((const __m128i*)(a + i));
+      __m128i pb = _mm_loadu_si128((const __m128i*)(b + i));
+      __m128i lo = lerp(_mm_unpacklo_epi8(pa, vZero), _mm_unpacklo_epi8(pb, vZero));
+      __m128i hi = lerp(_mm_unpackhi_epi8(pa, vZero), _mm_unpackhi_epi8(pb, vZero));
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; i++)
+      dst[i] = tDX_LerpPixel(a[i], b[i], w);
+  }
+
+  // Texel pair and weight of the second texel for every output pixel along one
+  // axis. Bilinear whose fraction is steepened by the scale, so it snaps to the
+  // nearest texel except in the one output pixel that covers a texel edge
+  struct sUpscaleTap { int32_t i0, i1, w; };
+  static std::vector<sUpscaleTap> tDX_SharpTaps(int32_t nSrc, int32_t nOut)
+  {
+    std::vector<sUpscaleTap> taps(nOut);
+    double fScale = (double)nOut / nSrc;
+    for (int32_t o = 0; o < nOut; o++)
+    {
+      double t = (o + 0.5) / fScale - 0.5;
+      double i = std::floor(t);
+      double f = std::clamp((t - i - 0.5) * fScale + 0.5, 0.0, 1.0);
+      taps[o].i0 = std::clamp((int32_t)i, 0, nSrc - 1);
+      taps[o].i1 = std::clamp((int32_t)i + 1, 0, nSrc - 1);
+      taps[o].w = (int32_t)(f * 256.0 + 0.5);
+    }
+    return taps;
+  }
+
+  tDX::rcode PixelGameEngine::UpscaleSprite(Sprite *sprite, Pixel *pOut, int32_t nOutW, int32_t nOutH, int32_t nOutPitch, Upscale filter, int32_t nThreads)
+  {
+    if (sprite == nullptr || sprite->GetData() == nullptr || pOut == nullptr || nOutW <= 0 || nOutH <= 0 || nOutPitch < nOutW)
+      return tDX::FAIL;
+
+    const Pixel *src = sprite->GetData();
+    int32_t nSrcW = sprite->width, nSrcH = sprite->height, nSrcPitch = sprite->GetPitch();
+
+    // At whole multiples sharp bilinear never blends, so both are the same
+    bool bWhole = nOutW % nSrcW == 0 && nOutH % nSrcH == 0;
+    if (filter == Upscale::NEAREST || bWhole)
+    {
+      if (!bWhole)
+        return tDX::FAIL;
+
+      // Widen each source row once, then copy it down the rest of its block
+      int32_t sx = nOutW / nSrcW, sy = nOutH / nSrcH;
+      tDX_ParallelRows(nSrcH, nThreads, [&](int32_t y0, int32_t y1)
+      {
+        for (int32_t y = y0; y < y1; y++)
+        {
+          Pixel *dst = pOut + (size_t)y * sy * nOutPitch;
+          tDX_ReplicateRow(src + (size_t)y * nSrcPitch, nSrcW, sx, dst);
+          for (int32_t j = 1; j < sy; j++)
+            memcpy(dst + (size_t)j * nOutPitch, dst, nOutW * sizeof(Pixel));
+        }
+      });
+      return tDX::OK;
+    }
+
+    std::vector<sUpscaleTap> vTapsX = tDX_SharpTaps(nSrcW, nOutW);
+    std::vector<sUpscaleTap> vTapsY = tDX_SharpTaps(nSrcH, nOutH);
+
+    tDX_ParallelRows(nOutH, nThreads, [&](int32_t o0, int32_t o1)
+    {
+      // The two most recent source rows filtered horizontally
+      std::vector<Pixel> vLine[2] = { std::vector<Pixel>(nOutW), std::vector<Pixel>(nOutW) };
+      int32_t nLineRow[2] = { -1, -1 };
+      auto widen = [&](int k, int32_t y)
+      {
+        if (nLineRow[k] == y) return;
+        const Pixel *row = src + (size_t)y * nSrcPitch;
+        Pixel *d = vLine[k].data();
+        for (int32_t o = 0; o < nOutW; o++)
+        {
+          const sUpscaleTap &t = vTapsX[o];
+          if (t.w == 0) d[o] = row[t.i0];
+          else if (t.w == 256) d[o] = row[t.i1];
+          else d[o] = tDX_LerpPixel(row[t.i0], row[t.i1], t.w);
+        }
+        nLineRow[k] = y;
+      };
+
+      for (int32_t o = o0; o < o1; o++)
+      {
+        const sUpscaleTap &t = vTapsY[o];
+        Pixel *dst = pOut + (size_t)o * nOutPitch;
+        if (nLineRow[0] != t.i0 && (nLineRow[1] == t.i0 || nLineRow[0] == t.i1))
+        {
+          std::swap(vLine[0], vLine[1]);
+          std::swap(nLineRow[0], nLineRow[1]);
+        }
+        widen(0, t.i0);
+        if (t.w == 0)
+          std::copy(vLine[0].begin(), vLine[0].end(), dst);
         else
         {
-          for (uint32_t i = 0; i < 8; i++)
-            for (uint32_t j = 0; j < 8; j++)
-              if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-                Draw(x + sx + i, y + sy + j, col);
+          widen(1, t.i1);
+          tDX_LerpRows(vLine[0].data(), vLine[1].data(), t.w, nOutW, dst);
         }
-        sx += 8 * scale;
       }
+    });
+    return tDX::OK;
+  }
+
+  tDX::rcode PixelGameEngine::UpscaleFrame(Pixel *pOut, int32_t nOutPitch, Upscale filter, int32_t nThreads)
+  {
+    int32_t nOutW = nScreenWidth * nPixelWidth, nOutH = nScreenHeight * nPixelHeight;
+    if (filter == Upscale::NEAREST && pDefaultDrawTarget && (nOutW % pDefaultDrawTarget->width != 0 || nOutH % pDefaultDrawTarget->height != 0))
+      filter = Upscale::SHARP_BILINEAR;
+    return UpscaleSprite(pDefaultDrawTarget, pOut, nOutW, nOutH, nOutPitch, filter, nThreads);
+  }
+
+  //==========================================================
+  // Dynamic resolution - the primary screen is resized between
+  // frames so that the CPU side of a frame fits the budget
+
+  void PixelGameEngine::EnableDynamicResolution(bool bEnable, float fBudgetMs, float fMinScale, float fMaxScale)
+  {
+    bDynamicResolution = bEnable;
+    fResBudgetMs = std::max(fBudgetMs, 0.1f);
+    fResMaxScale = std::min(std::max(fMaxScale, 0.05f), 1.0f);
+    fResMinScale = std::min(std::max(fMinScale, 0.05f), fResMaxScale);
+    fResSmoothedMs = 0.0f;
+    nResCooldown = 16;
+
+    float fScale = bEnable ? std::min(std::max(fResScale, fResMinScale), fResMaxScale) : 1.0f;
+    if (fScale != fResScale)
+    {
+      vResolutionLog.push_back({ nResFrame, 0.0f, fResScale, fScale });
+      tDX_ApplyResolution(fScale);
     }
-    SetPixelMode(m);
+  }
+
+  float PixelGameEngine::GetResolutionScale()
+  {
+    return fResScale;
+  }
+
+  const std::vector<ResolutionChange>& PixelGameEngine::GetResolutionLog()
+  {
+    return vResolutionLog;
+  }
+
+  tDX::rcode PixelGameEngine::SaveResolutionLog(const std::string& sFile)
+  {
+    std::ofstream file(sFile);
+    if (!file.is_open()) return tDX::FAIL;
+
+    file << "frame,frame_ms,from_scale,to_scale,width,height\n";
+    for (const auto &c : vResolutionLog)
+      file << c.nFrame << "," << c.fFrameMs << "," << c.fFromScale << "," << c.fToScale << ","
+        << std::max(1L, std::lround(nScreenWidth * c.fToScale)) << "," << std::max(1L, std::lround(nScreenHeight * c.fToScale)) << "\n";
+
+    return file.good() ? tDX::OK : tDX::FAIL;
+  }
+
+  void PixelGameEngine::tDX_UpdateResolution(float fWorkMs)
+  {
+    nResFrame++;
+    if (!bDynamicResolution) return;
+
+    // Averaged over about 16 frames, so one slow frame does not resize anything
+    fResSmoothedMs = fResSmoothedMs == 0.0f ? fWorkMs : fResSmoothedMs + (fWorkMs - fResSmoothedMs) * 0.0625f;
+
+    // Let the average settle on the new size before judging it
+    if (nResCooldown > 0)
+    {
+      nResCooldown--;
+      return;
+    }
+
+    // Hysteresis, nothing happens between 70% and 100% of the budget
+    if (fResSmoothedMs <= fResBudgetMs && fResSmoothedMs >= fResBudgetMs * 0.7f)
+      return;
+
+    // The cost follows the pixel count, aim for 85% of the budget in steps of 1/32
+    float fScale = fResScale * sqrtf(fResBudgetMs * 0.85f / std::max(fResSmoothedMs, 0.01f));
+    fScale = std::round(std::min(std::max(fScale, fResMinScale), fResMaxScale) * 32.0f) / 32.0f;
+    fScale = std::min(std::max(fScale, fResMinScale), fResMaxScale);
+    if (fabsf(fScale - fResScale) < 1.0f / 64.0f)
+      return;
+
+    vResolutionLog.push_back({ nResFrame, fResSmoothedMs, fResScale, fScale });
+    tDX_ApplyResolution(fScale);
+
+    fResSmoothedMs = 0.0f;
+    nResCooldown = 30;
+  }
+
+  void PixelGameEngine::tDX_ApplyResolution(float fScale)
+  {
+    fResScale = fScale;
+
+    int32_t w = std::max(1, (int32_t)std::lround(nScreenWidth * fScale));
+    int32_t h = std::max(1, (int32_t)std::lround(nScreenHeight * fScale));
+    if (!pDefaultDrawTarget || (w == pDefaultDrawTarget->width && h == pDefaultDrawTarget->height))
+      return;
+
+    // Keep the mouse over the same spot of the picture
+    nMousePosXcache = nMousePosXcache * w / pDefaultDrawTarget->width;
+    nMousePosYcache = nMousePosYcache * h / pDefaultDrawTarget->height;
+    nMousePosX = nMousePosX * w / pDefaultDrawTarget->width;
+    nMousePosY = nMousePosY * h / pDefaultDrawTarget->height;
+
+    // Views of the screen, like split screen panes, are scaled along with it
+    pDefaultDrawTarget->Resize(w, h);
+
+    if (m_d3dDevice)
+      tDX_CreateFrameTexture();
   }
 
   void PixelGameEngine::SetPixelMode(Pixel::Mode m)
@@ -1920,6 +3303,47 @@ namespace tDX
   void PixelGameEngine::tDX_UpdateMouseWheel(int32_t delta)
   {
     nMouseWheelDeltaCache += delta;
+
+    InputEvent e;
+    e.type = InputEvent::MOUSE_WHEEL;
+    e.x = nMousePosXcache;
+    e.y = nMousePosYcache;
+    e.nWheel = delta;
+    e.nTimestamp = GetInputTimestamp();
+    tDX_PushInputEvent(e);
+  }
+
+  void PixelGameEngine::tDX_UpdateKey(uint8_t k, bool bDown, int64_t nTimestamp)
+  {
+    pKeyNewState[k] = bDown;
+
+    InputEvent e;
+    e.type = bDown ? InputEvent::KEY_DOWN : InputEvent::KEY_UP;
+    e.nCode = k;
+    e.x = nMousePosXcache;
+    e.y = nMousePosYcache;
+    e.nTimestamp = nTimestamp;
+    tDX_PushInputEvent(e);
+  }
+
+  void PixelGameEngine::tDX_UpdateMouseButton(uint32_t b, bool bDown, int64_t nTimestamp)
+  {
+    if (b >= 5) return;
+    pMouseNewState[b] = bDown;
+
+    InputEvent e;
+    e.type = bDown ? InputEvent::MOUSE_DOWN : InputEvent::MOUSE_UP;
+    e.nCode = (uint8_t)b;
+    e.x = nMousePosXcache;
+    e.y = nMousePosYcache;
+    e.nTimestamp = nTimestamp;
+    tDX_PushInputEvent(e);
+  }
+
+  void PixelGameEngine::tDX_PushInputEvent(const InputEvent& e)
+  {
+    if (!inputQueue.Push(e))
+      nDroppedInputEvents++;
   }
 
   void PixelGameEngine::tDX_UpdateMouse(int32_t x, int32_t y)
@@ -1931,18 +3355,26 @@ namespace tDX
     x -= nViewX;
     y -= nViewY;
 
-    nMousePosXcache = (int32_t)(((float)x / (float)(nWindowWidth - (nViewX * 2)) * (float)nScreenWidth));
-    nMousePosYcache = (int32_t)(((float)y / (float)(nWindowHeight - (nViewY * 2)) * (float)nScreenHeight));
+    // Into the primary screen as it is now, it may be scaled down
+    nMousePosXcache = (int32_t)(((float)x / (float)(nWindowWidth - (nViewX * 2)) * (float)ScreenWidth()));
+    nMousePosYcache = (int32_t)(((float)y / (float)(nWindowHeight - (nViewY * 2)) * (float)ScreenHeight()));
 
-    if (nMousePosXcache >= (int32_t)nScreenWidth)
-      nMousePosXcache = nScreenWidth - 1;
-    if (nMousePosYcache >= (int32_t)nScreenHeight)
-      nMousePosYcache = nScreenHeight - 1;
+    if (nMousePosXcache >= ScreenWidth())
+      nMousePosXcache = ScreenWidth() - 1;
+    if (nMousePosYcache >= ScreenHeight())
+      nMousePosYcache = ScreenHeight() - 1;
 
     if (nMousePosXcache < 0)
       nMousePosXcache = 0;
     if (nMousePosYcache < 0)
       nMousePosYcache = 0;
+
+    InputEvent e;
+    e.type = InputEvent::MOUSE_MOVE;
+    e.x = nMousePosXcache;
+    e.y = nMousePosYcache;
+    e.nTimestamp = GetInputTimestamp();
+    tDX_PushInputEvent(e);
   }
 
   // Thanks @MaGetzUb for this, which allows sprites to be defined
@@ -2154,7 +3586,16 @@ namespace tDX
     m_d3dDevice->CreateRenderTargetView(backBuffer.Get(), nullptr, m_renderTargetView.ReleaseAndGetAddressOf());
     m_d3dContext->OMSetRenderTargets(1, m_renderTargetView.GetAddressOf(), NULL);
 
-    // Texture setup
+    tDX_CreateFrameTexture();
+
+    // Set the viewport
+    CD3D11_VIEWPORT viewport(static_cast<float>(nViewX), static_cast<float>(nViewY), static_cast<float>(nViewW), static_cast<float>(nViewH));
+    m_d3dContext->RSSetViewports(1, &viewport);
+  }
+
+  // The texture the primary screen is uploaded to, it follows the size of pDefaultDrawTarget
+  void PixelGameEngine::tDX_CreateFrameTexture()
+  {
     int32_t fWidth = pDefaultDrawTarget->width;
     int32_t fHeight = pDefaultDrawTarget->height;
     auto components = 4; // RGBA
@@ -2177,14 +3618,10 @@ namespace tDX
     initialTextureData.SysMemPitch = fWidth * components;
     initialTextureData.SysMemSlicePitch = 0;
 
-    m_d3dDevice->CreateTexture2D(&textureDescription, &initialTextureData, m_texture.GetAddressOf());
-    m_d3dDevice->CreateShaderResourceView(m_texture.Get(), NULL, &m_textureView);
+    m_d3dDevice->CreateTexture2D(&textureDescription, &initialTextureData, m_texture.ReleaseAndGetAddressOf());
+    m_d3dDevice->CreateShaderResourceView(m_texture.Get(), NULL, m_textureView.ReleaseAndGetAddressOf());
 
     m_d3dContext->PSSetShaderResources(0, 1, m_textureView.GetAddressOf());
-
-    // Set the viewport
-    CD3D11_VIEWPORT viewport(static_cast<float>(nViewX), static_cast<float>(nViewY), static_cast<float>(nViewW), static_cast<float>(nViewH));
-    m_d3dContext->RSSetViewports(1, &viewport);
   }
 
   bool PixelGameEngine::tDX_DirectXCreateDevice()
@@ -2240,14 +3677,19 @@ namespace tDX
     case WM_MOUSELEAVE: sge->bHasMouseFocus = false; return 0;
     case WM_SETFOCUS:	  sge->bHasInputFocus = true;	return 0;
     case WM_KILLFOCUS:	sge->bHasInputFocus = false; return 0;
-    case WM_KEYDOWN:	  sge->pKeyNewState[mapKeys[wParam]] = true; return 0;
-    case WM_KEYUP:		  sge->pKeyNewState[mapKeys[wParam]] = false; return 0;
-    case WM_LBUTTONDOWN:sge->pMouseNewState[0] = true; return 0;
-    case WM_LBUTTONUP:	sge->pMouseNewState[0] = false; return 0;
-    case WM_RBUTTONDOWN:sge->pMouseNewState[1] = true; return 0;
-    case WM_RBUTTONUP:	sge->pMouseNewState[1] = false; return 0;
-    case WM_MBUTTONDOWN:sge->pMouseNewState[2] = true; return 0;
-    case WM_MBUTTONUP:	sge->pMouseNewState[2] = false;	return 0;
+    case WM_KEYDOWN:
+    {
+      // Bit 30 is set for auto-repeat, which is not a transition
+      if (!(lParam & (1 << 30))) sge->tDX_UpdateKey(mapKeys[wParam], true, sge->GetInputTimestamp());
+      return 0;
+    }
+    case WM_KEYUP:		  sge->tDX_UpdateKey(mapKeys[wParam], false, sge->GetInputTimestamp()); return 0;
+    case WM_LBUTTONDOWN:sge->tDX_UpdateMouseButton(0, true, sge->GetInputTimestamp()); return 0;
+    case WM_LBUTTONUP:	sge->tDX_UpdateMouseButton(0, false, sge->GetInputTimestamp()); return 0;
+    case WM_RBUTTONDOWN:sge->tDX_UpdateMouseButton(1, true, sge->GetInputTimestamp()); return 0;
+    case WM_RBUTTONUP:	sge->tDX_UpdateMouseButton(1, false, sge->GetInputTimestamp()); return 0;
+    case WM_MBUTTONDOWN:sge->tDX_UpdateMouseButton(2, true, sge->GetInputTimestamp()); return 0;
+    case WM_MBUTTONUP:	sge->tDX_UpdateMouseButton(2, false, sge->GetInputTimestamp()); return 0;
     case WM_DESTROY:	  PostQuitMessage(0); return 0;
     }
     return DefWindowProc(hWnd, uMsg, wParam, lParam);
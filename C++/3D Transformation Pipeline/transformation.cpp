@@ -13,6 +13,7 @@ namespace g
 {
   constexpr uint32_t screenWidth = 600;
   constexpr uint32_t screenHeight = 380;
+  constexpr uint32_t pixelSize = 2;
 };
 
 using float4x4 = array<array<float, 4>, 4>;
@@ -122,6 +123,13 @@ public:
 
   bool OnUserCreate() override
   {
+    // Labels and matrices mostly repeat frame to frame
+    SetTextCacheSize(1 << 20);
+
+    // Both panes are views into the screen, each draws in its own coordinates
+    m_topPane.Attach(GetDrawTarget(), 0, 0, m_windowWidth, m_windowHeight);
+    m_bottomPane.Attach(GetDrawTarget(), 0, m_windowHeight, m_windowWidth, m_windowHeight);
+
     return true;
   }
 
@@ -147,6 +155,9 @@ public:
 
     m_yaw = fmod(m_yaw, 360.0f);
 
+    // Top view
+    SetDrawTarget(&m_topPane);
+
     // Grid
     for (uint8_t row = 0; row < m_gridRows; row++)
       DrawLine(0, row * m_cellSize, m_windowWidth - 1, row * m_cellSize, tDX::VERY_DARK_GREY);
@@ -166,8 +177,8 @@ public:
     float fovx = 2 * atan(tan(toRad(45.0f * 0.5)) * m_aspectRatio);
     float length = (tan(fovx / 2.0f) * m_windowHeight);
 
-    DrawLineClipped(m_originX, m_originY, m_originX - length, m_originY - m_windowHeight, { 0, 0 }, { m_windowWidth - 1, m_windowHeight - 1 }, tDX::BLUE);
-    DrawLineClipped(m_originX, m_originY, m_originX + length, m_originY - m_windowHeight, { 0, 0 }, { m_windowWidth - 1, m_windowHeight - 1 }, tDX::BLUE);
+    DrawLineClipped(m_originX, m_originY, m_originX - length, m_originY - m_windowHeight, tDX::BLUE);
+    DrawLineClipped(m_originX, m_originY, m_originX + length, m_originY - m_windowHeight, tDX::BLUE);
 
     // 2D square
     float2 leftUp = {m_originX - m_cellSize + (m_cubeTranslationX * m_cellSize * 2), m_originY - m_cellSize + (m_cubeTranslationZ * m_cellSize * 2) };
@@ -253,11 +264,13 @@ public:
     m_mvpMatrix = m_projectionMatrix * m_viewMatrix * m_modelMatrix;
 
     // 3D view
+    SetDrawTarget(&m_bottomPane);
+
     const int32_t originX3D = m_windowWidth / 2;
-    const int32_t originY3D = m_windowHeight + m_windowHeight / 2;
+    const int32_t originY3D = m_windowHeight / 2;
 
     DrawLine(0, originY3D, m_windowWidth - 1, originY3D, tDX::DARK_YELLOW);
-    DrawLine(originX3D, m_windowHeight, originX3D, m_windowHeight + m_windowHeight - 1, tDX::DARK_YELLOW);
+    DrawLine(originX3D, 0, originX3D, m_windowHeight - 1, tDX::DARK_YELLOW);
 
     // Cube
     array<float4, 8> transformedCube = m_cube;
@@ -273,30 +286,35 @@ public:
 
       // Viewport
       vertex.x = (vertex.x + 1.0f) * (m_windowWidth - 1) * 0.5f + 0.0f; // plus X viewport origin
-      vertex.y = (1.0f - vertex.y) * (m_windowHeight - 1) * 0.5f + m_windowHeight; // plus Y viewport origin
+      vertex.y = (1.0f - vertex.y) * (m_windowHeight - 1) * 0.5f + 0.0f; // plus Y viewport origin
     }
 
-    tDX::vi2d clipWinPos = { 0, m_windowHeight };
-    tDX::vi2d clipWinSize = { m_windowWidth - 1, m_windowHeight - 1 };
+    // Clipped in floats first, vertices near the camera land far outside any int range
+    auto drawEdge = [&](int a, int b)
+    {
+      DrawLineClipped(transformedCube[a].x, transformedCube[a].y, transformedCube[b].x, transformedCube[b].y, tDX::WHITE);
+    };
 
-    DrawLineClipped(transformedCube[0].x, transformedCube[0].y, transformedCube[1].x, transformedCube[1].y, clipWinPos, clipWinSize, tDX::WHITE);
-    DrawLineClipped(transformedCube[1].x, transformedCube[1].y, transformedCube[2].x, transformedCube[2].y, clipWinPos, clipWinSize, tDX::WHITE);
-    DrawLineClipped(transformedCube[2].x, transformedCube[2].y, transformedCube[3].x, transformedCube[3].y, clipWinPos, clipWinSize, tDX::WHITE);
-    DrawLineClipped(transformedCube[3].x, transformedCube[3].y, transformedCube[0].x, transformedCube[0].y, clipWinPos, clipWinSize, tDX::WHITE);
+    drawEdge(0, 1);
+    drawEdge(1, 2);
+    drawEdge(2, 3);
+    drawEdge(3, 0);
 
-    DrawLineClipped(transformedCube[4].x, transformedCube[4].y, transformedCube[5].x, transformedCube[5].y, clipWinPos, clipWinSize, tDX::WHITE);
-    DrawLineClipped(transformedCube[5].x, transformedCube[5].y, transformedCube[6].x, transformedCube[6].y, clipWinPos, clipWinSize, tDX::WHITE);
-    DrawLineClipped(transformedCube[6].x, transformedCube[6].y, transformedCube[7].x, transformedCube[7].y, clipWinPos, clipWinSize, tDX::WHITE);
-    DrawLineClipped(transformedCube[7].x, transformedCube[7].y, transformedCube[4].x, transformedCube[4].y, clipWinPos, clipWinSize, tDX::WHITE);
+    drawEdge(4, 5);
+    drawEdge(5, 6);
+    drawEdge(6, 7);
+    drawEdge(7, 4);
 
-    DrawLineClipped(transformedCube[0].x, transformedCube[0].y, transformedCube[4].x, transformedCube[4].y, clipWinPos, clipWinSize, tDX::WHITE);
-    DrawLineClipped(transformedCube[1].x, transformedCube[1].y, transformedCube[5].x, transformedCube[5].y, clipWinPos, clipWinSize, tDX::WHITE);
-    DrawLineClipped(transformedCube[2].x, transformedCube[2].y, transformedCube[6].x, transformedCube[6].y, clipWinPos, clipWinSize, tDX::WHITE);
-    DrawLineClipped(transformedCube[3].x, transformedCube[3].y, transformedCube[7].x, transformedCube[7].y, clipWinPos, clipWinSize, tDX::WHITE);
+    drawEdge(0, 4);
+    drawEdge(1, 5);
+    drawEdge(2, 6);
+    drawEdge(3, 7);
 
-    if (transformedCube[0].x > 0 && transformedCube[0].x < m_windowWidth && transformedCube[0].y > m_windowHeight && transformedCube[0].y < g::screenHeight)
+    if (transformedCube[0].x > 0 && transformedCube[0].x < m_windowWidth && transformedCube[0].y > 0 && transformedCube[0].y < m_windowHeight)
       DrawCircle(lround(transformedCube[0].x), lround(transformedCube[0].y), 2, tDX::YELLOW);
 
+    SetDrawTarget(nullptr);
+
     // Windows borders
     DrawRect(0, 0, m_windowWidth - 1, m_windowHeight - 1, tDX::WHITE);
     DrawRect(0, m_windowHeight, m_windowWidth - 1, m_windowHeight - 1, tDX::WHITE);
@@ -368,6 +386,14 @@ public:
     DrawString(310, 310, "Cube vertex in screen space");
     DrawString(300, 325, cubePointPrint.str());
 
+    // P saves the frame as it appears in the window
+    if (GetKey(tDX::P).bPressed)
+    {
+      tDX::Sprite shot(g::screenWidth * g::pixelSize, g::screenHeight * g::pixelSize);
+      if (UpscaleFrame(shot.GetData(), shot.GetPitch()) == tDX::OK)
+        shot.SaveToPGESprFile("screenshot.spr");
+    }
+
     return true;
   }
 
@@ -424,13 +450,37 @@ private:
   float3 m_eye = { 0, 0, 0 };
   float3 m_target = { 0, 0, -1 };
   float3 m_up = { 0, 1, 0 };
+
+  // Left half of the screen
+  tDX::SpriteView m_topPane;
+  tDX::SpriteView m_bottomPane;
 };
 
-int main()
+int main(int argc, char* argv[])
 {
   MatrixDemo demo;
-  if (demo.Construct(g::screenWidth, g::screenHeight, 2, 2))
+  if (demo.Construct(g::screenWidth, g::screenHeight, g::pixelSize, g::pixelSize))
+  {
+    // --record <file> saves a session, --play <file> [timestep] replays it and exits
+    string mode = argc >= 3 ? argv[1] : "";
+    if (mode == "--record")
+      demo.RecordSession(argv[2]);
+    else if (mode == "--play")
+    {
+      // A timestep that does not parse keeps the recorded frame times
+      float timestep = 0.0f;
+      if (argc >= 4)
+      {
+        char *end = nullptr;
+        timestep = strtof(argv[3], &end);
+        if (end == argv[3] || *end != '\0')
+          timestep = 0.0f;
+      }
+      demo.PlaySession(argv[2], timestep, true);
+    }
+
     demo.Start();
+  }
 
   return 0;
 }
@@ -6,6 +6,12 @@
 #include <algorithm>
 #include <string>
 
+#if defined(__AVX2__)
+#include <immintrin.h>   // 8 vertices per step in transformVertices
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>   // 4 vertices per step
+#endif
+
 // Constants for display dimensions (ASCII art "screen" size)
 const int WIDTH = 80;
 const int HEIGHT = 40;
@@ -46,46 +52,148 @@ std::vector<std::pair<int, int>> cube_edges =
     {0,4}, {1,5}, {2,6}, {3,7}  // vertical edges
 };
 
-// Projects a 3D point onto the 2D "screen" using perspective projection
-Point2D project(const Point3D& p)
+// Rotation around the X axis by angleX followed by one around the Y axis by
+// angleY, as a single matrix so sin and cos are taken once per frame
+struct Rotation
 {
-  // Calculate aspect ratio for proper scaling
-  float aspect = static_cast<float>(WIDTH) / HEIGHT;
+  float m[3][3];
+};
 
-  // Calculate scale factor based on field of view (convert FOV to radians)
-  float fovScale = 1.0f / tan(FOV * 0.5f * 3.14 / 180);
+Rotation rotationXY(float angleX, float angleY)
+{
+  float sa = sin(angleX), ca = cos(angleX);
+  float sb = sin(angleY), cb = cos(angleY);
 
-  // Apply perspective by adding camera distance to z
-  float z = p.z + CAMERA_DISTANCE;
+  return
+  {{
+      { cb, sa * sb, ca * sb },
+      { 0, ca, -sa },
+      { -sb, sa * cb, ca * cb }
+  }};
+}
 
-  // Perspective divide and scaling
-  float scale = fovScale / z * CUBE_SIZE;
+// Cube vertices as separate x, y and z arrays, padded with zeros to a
+// multiple of 8 so the SIMD loops below need no scalar tail
+struct VertexArrays
+{
+  std::vector<float> x, y, z;
+  size_t count = 0;
 
-  // Convert 3D coordinates to 2D screen coordinates
-  return
+  void assign(const Point3D* vertices, size_t n)
   {
-      static_cast<int>(WIDTH / 2 + p.x * scale * aspect), // X: center + scaled position
-      static_cast<int>(HEIGHT / 2 - p.y * scale),         // Y: center - scaled position (Y axis inverted)
-      z                                                   // Store depth for shading
-  };
-}
+    size_t padded = (n + 7) & ~size_t(7);
+    x.assign(padded, 0.0f);
+    y.assign(padded, 0.0f);
+    z.assign(padded, 0.0f);
+    count = n;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      x[i] = vertices[i].x;
+      y[i] = vertices[i].y;
+      z[i] = vertices[i].z;
+    }
+  }
+};
 
-// Rotates a point around the X axis by angle a (in radians)
-void rotateX(Point3D& p, float a)
+// Screen positions and depths of the transformed vertices. The arrays are
+// kept from frame to frame and only ever grow
+struct ScreenPoints
 {
-  float y = p.y * cos(a) - p.z * sin(a);
-  float z = p.y * sin(a) + p.z * cos(a);
-  p.y = y;
-  p.z = z;
-}
+  std::vector<int> x, y;
+  std::vector<float> depth;
 
-// Rotates a point around the Y axis by angle a (in radians)
-void rotateY(Point3D& p, float a)
+  Point2D operator[](size_t i) const
+  {
+    return { x[i], y[i], depth[i] };
+  }
+};
+
+// Rotates every vertex, projects it with perspective and converts it to
+// integer screen coordinates in a single pass, 8 or 4 vertices at a time
+void transformVertices(const VertexArrays& in, const Rotation& r, ScreenPoints& out)
 {
-  float x = p.x * cos(a) + p.z * sin(a);
-  float z = -p.x * sin(a) + p.z * cos(a);
-  p.x = x;
-  p.z = z;
+  size_t n = in.x.size();
+  if (out.x.size() < n)
+  {
+    out.x.resize(n);
+    out.y.resize(n);
+    out.depth.resize(n);
+  }
+
+  // Projection constants: aspect ratio, field of view scale and screen centre
+  const float aspect = static_cast<float>(WIDTH) / HEIGHT;
+  const float fovScale = 1.0f / tan(FOV * 0.5f * 3.14 / 180);
+  const float centerX = WIDTH / 2, centerY = HEIGHT / 2;
+
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  __m256 m00 = _mm256_set1_ps(r.m[0][0]), m01 = _mm256_set1_ps(r.m[0][1]), m02 = _mm256_set1_ps(r.m[0][2]);
+  __m256 m10 = _mm256_set1_ps(r.m[1][0]), m11 = _mm256_set1_ps(r.m[1][1]), m12 = _mm256_set1_ps(r.m[1][2]);
+  __m256 m20 = _mm256_set1_ps(r.m[2][0]), m21 = _mm256_set1_ps(r.m[2][1]), m22 = _mm256_set1_ps(r.m[2][2]);
+  __m256 camera = _mm256_set1_ps(CAMERA_DISTANCE), fov = _mm256_set1_ps(fovScale), size = _mm256_set1_ps(CUBE_SIZE);
+  __m256 cx = _mm256_set1_ps(centerX), cy = _mm256_set1_ps(centerY), ax = _mm256_set1_ps(aspect);
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256 x = _mm256_loadu_ps(&in.x[i]), y = _mm256_loadu_ps(&in.y[i]), z = _mm256_loadu_ps(&in.z[i]);
+
+    __m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m00), _mm256_mul_ps(y, m01)), _mm256_mul_ps(z, m02));
+    __m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m10), _mm256_mul_ps(y, m11)), _mm256_mul_ps(z, m12));
+    __m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m20), _mm256_mul_ps(y, m21)), _mm256_mul_ps(z, m22));
+
+    // Perspective divide, then centre on the screen with the Y axis inverted
+    __m256 depth = _mm256_add_ps(rz, camera);
+    __m256 scale = _mm256_mul_ps(_mm256_div_ps(fov, depth), size);
+    __m256 sx = _mm256_add_ps(cx, _mm256_mul_ps(_mm256_mul_ps(rx, scale), ax));
+    __m256 sy = _mm256_sub_ps(cy, _mm256_mul_ps(ry, scale));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.x[i]), _mm256_cvttps_epi32(sx));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.y[i]), _mm256_cvttps_epi32(sy));
+    _mm256_storeu_ps(&out.depth[i], depth);
+  }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  __m128 m00 = _mm_set1_ps(r.m[0][0]), m01 = _mm_set1_ps(r.m[0][1]), m02 = _mm_set1_ps(r.m[0][2]);
+  __m128 m10 = _mm_set1_ps(r.m[1][0]), m11 = _mm_set1_ps(r.m[1][1]), m12 = _mm_set1_ps(r.m[1][2]);
+  __m128 m20 = _mm_set1_ps(r.m[2][0]), m21 = _mm_set1_ps(r.m[2][1]), m22 = _mm_set1_ps(r.m[2][2]);
+  __m128 camera = _mm_set1_ps(CAMERA_DISTANCE), fov = _mm_set1_ps(fovScale), size = _mm_set1_ps(CUBE_SIZE);
+  __m128 cx = _mm_set1_ps(centerX), cy = _mm_set1_ps(centerY), ax = _mm_set1_ps(aspect);
+
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(&in.x[i]), y = _mm_loadu_ps(&in.y[i]), z = _mm_loadu_ps(&in.z[i]);
+
+    __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m01)), _mm_mul_ps(z, m02));
+    __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m10), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m12));
+    __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m20), _mm_mul_ps(y, m21)), _mm_mul_ps(z, m22));
+
+    // Perspective divide, then centre on the screen with the Y axis inverted
+    __m128 depth = _mm_add_ps(rz, camera);
+    __m128 scale = _mm_mul_ps(_mm_div_ps(fov, depth), size);
+    __m128 sx = _mm_add_ps(cx, _mm_mul_ps(_mm_mul_ps(rx, scale), ax));
+    __m128 sy = _mm_sub_ps(cy, _mm_mul_ps(ry, scale));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.x[i]), _mm_cvttps_epi32(sx));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.y[i]), _mm_cvttps_epi32(sy));
+    _mm_storeu_ps(&out.depth[i], depth);
+  }
+#endif
+
+  // Same math one vertex at a time, for builds without SIMD
+  for (; i < n; ++i)
+  {
+    float x = in.x[i], y = in.y[i], z = in.z[i];
+    float rx = x * r.m[0][0] + y * r.m[0][1] + z * r.m[0][2];
+    float ry = x * r.m[1][0] + y * r.m[1][1] + z * r.m[1][2];
+    float rz = x * r.m[2][0] + y * r.m[2][1] + z * r.m[2][2];
+
+    float depth = rz + CAMERA_DISTANCE;
+    float scale = fovScale / depth * CUBE_SIZE;
+    out.x[i] = static_cast<int>(centerX + rx * scale * aspect);
+    out.y[i] = static_cast<int>(centerY - ry * scale);
+    out.depth[i] = depth;
+  }
 }
 
 // Draws a line between two 2D points using Bresenham's algorithm, with depth-based shading
@@ -148,6 +256,12 @@ int main()
   // Initialize rotation angles
   float angleX = 0, angleY = 0;
 
+  // Cube vertices split into SIMD friendly arrays once, and the screen
+  // positions they are transformed into every frame
+  VertexArrays vertices;
+  vertices.assign(cube_vertices.data(), cube_vertices.size());
+  ScreenPoints projected;
+
   // Pre-allocate buffer for screen output to minimize allocations
   std::string buffer;
   buffer.reserve((WIDTH + 1) * HEIGHT + 10);
@@ -162,22 +276,8 @@ int main()
     // Initialize the screen as a 2D array filled with spaces
     std::vector<std::vector<char>> screen(HEIGHT, std::vector<char>(WIDTH, ' '));
 
-    // Copy cube vertices for rotation
-    std::vector<Point3D> rotated = cube_vertices;
-
-    // Rotate all vertices around X and Y axes
-    for (auto& v : rotated)
-    {
-      rotateX(v, angleX);
-      rotateY(v, angleY);
-    }
-
-    // Project all rotated 3D points to 2D screen coordinates
-    std::vector<Point2D> projected;
-    for (const auto& v : rotated)
-    {
-      projected.push_back(project(v));
-    }
+    // Rotate, project and convert all vertices to screen coordinates
+    transformVertices(vertices, rotationXY(angleX, angleY), projected);
 
     // Draw all cube edges onto the screen buffer
     for (const auto& e : cube_edges)
@@ -106,6 +106,14 @@ public:
   {
     Clear(tDX::Pixel(40, 44, 52));
 
+    if (GetKey(tDX::Key::G).bPressed)
+      _blendMode = _blendMode == tDX::Pixel::ALPHA_SRGB ? tDX::Pixel::ALPHA : tDX::Pixel::ALPHA_SRGB;
+    if (GetKey(tDX::Key::B).bPressed)
+      runBlendBenchmark();
+
+    // The tracks, outlines and axes are translucent white/black
+    SetPixelMode(_blendMode);
+
     _animationTime += fElapsedTime;
 
     if (_animationTime >= _duration)
@@ -113,6 +121,8 @@ public:
       _animationTime -= _duration;
     }
 
+    _ballX.clear(); _ballY.clear(); _ballRadius.clear(); _ballColor.clear(); _ballOutline.clear();
+
     for (size_t i = 0; i < _animations.size(); ++i)
     {
       const auto& anim = _animations[i];
@@ -123,8 +133,21 @@ public:
       int32_t nAnimY = nSectionY + 80;
 
       DrawLine(_startX, nAnimY, _startX + _distance, nAnimY, tDX::Pixel(255, 255, 255, 40));
-      FillCircle((int32_t)currentX, nAnimY, _radius, anim.color);
-      DrawCircle((int32_t)currentX, nAnimY, _radius, tDX::Pixel(0, 0, 0, 80));
+      _ballX.push_back((int32_t)currentX);
+      _ballY.push_back(nAnimY);
+      _ballRadius.push_back(_radius);
+      _ballColor.push_back(anim.color);
+      _ballOutline.push_back(tDX::Pixel(0, 0, 0, 80));
+    }
+
+    // All balls in one batch, on top of their tracks and below the labels as before
+    FillCircles(_ballX.data(), _ballY.data(), _ballRadius.data(), _ballColor.data(), _ballX.size());
+    DrawCircles(_ballX.data(), _ballY.data(), _ballRadius.data(), _ballOutline.data(), _ballX.size());
+
+    for (size_t i = 0; i < _animations.size(); ++i)
+    {
+      const auto& anim = _animations[i];
+      int32_t nSectionY = _sectionHeight * i;
 
       // --- Draw Labels & Graph ---
       int32_t nLabelY = nSectionY + 25;
@@ -139,10 +162,67 @@ public:
       plotFunction(anim, nGraphX, nGraphY, _graphWidth, nGraphHeight);
     }
 
+    std::string sBlend = _blendMode == tDX::Pixel::ALPHA_SRGB ? "sRGB" : "plain";
+    DrawString(_startX, SCREEN_HEIGHT - 14, "G: blend (" + sBlend + ")  B: benchmark  " + _benchResult, tDX::GREY);
+
     return true;
   }
 
 private:
+  // Times the blend modes on full screen fills, which take the lookup table
+  // shortcut, and on short spans, lines and circle outlines, which blend
+  // pixel by pixel
+  void runBlendBenchmark()
+  {
+    const int nRuns = 100;
+    const tDX::Pixel col(255, 255, 255, 40);
+    tDX::Sprite target(SCREEN_WIDTH, SCREEN_HEIGHT);
+    SetDrawTarget(&target);
+
+    auto timeMode = [&](tDX::Pixel::Mode mode, const std::function<void()>& draw)
+    {
+      SetPixelMode(mode);
+      Clear(tDX::Pixel(40, 44, 52));
+      auto tp1 = std::chrono::steady_clock::now();
+      for (int i = 0; i < nRuns; i++)
+        draw();
+      auto tp2 = std::chrono::steady_clock::now();
+      return std::chrono::duration<float, std::milli>(tp2 - tp1).count() / nRuns;
+    };
+
+    struct Workload { const char *name; std::function<void()> draw; };
+    const Workload workloads[] =
+    {
+      { "fill", [&]() { FillRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, col); } },
+      { "span", [&]()
+        {
+          for (int32_t y = 0; y < SCREEN_HEIGHT; y += 8)
+            for (int32_t x = 0; x < SCREEN_WIDTH; x += 64)
+              FillRect(x, y, 48, 8, col);
+        } },
+      { "line", [&]()
+        {
+          for (int32_t i = 0; i < 256; i++)
+            DrawLine(0, i * SCREEN_HEIGHT / 256, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1 - i * SCREEN_HEIGHT / 256, col);
+        } },
+      { "circle", [&]()
+        {
+          for (int32_t y = 10; y < SCREEN_HEIGHT; y += 20)
+            for (int32_t x = 10; x < SCREEN_WIDTH; x += 20)
+              DrawCircle(x, y, 18, col);
+        } },
+    };
+
+    std::ostringstream ss;
+    ss.precision(1);
+    ss << std::fixed << "ms plain/sRGB:";
+    for (const auto& w : workloads)
+      ss << " " << w.name << " " << timeMode(tDX::Pixel::ALPHA, w.draw) << "/" << timeMode(tDX::Pixel::ALPHA_SRGB, w.draw);
+    SetDrawTarget(nullptr);
+
+    _benchResult = ss.str();
+  }
+
   void plotFunction(const easing::Animation& anim, int32_t x, int32_t y, int32_t w, int32_t h)
   {
     // Draw axes
@@ -176,6 +256,16 @@ private:
   int32_t _graphPadding = 40;
   int32_t _endX = SCREEN_WIDTH - 60;
   int32_t _distance = _endX - _startX - _graphWidth - _graphPadding;
+
+  // Ball positions gathered for the batched circle calls
+  std::vector<int32_t> _ballX;
+  std::vector<int32_t> _ballY;
+  std::vector<int32_t> _ballRadius;
+  std::vector<tDX::Pixel> _ballColor;
+  std::vector<tDX::Pixel> _ballOutline;
+
+  tDX::Pixel::Mode _blendMode = tDX::Pixel::ALPHA_SRGB;
+  std::string _benchResult;
 };
 
 
@@ -83,6 +83,11 @@
 #include <functional>
 #include <algorithm>
 
+// AVX2 blenders are used when built with /arch:AVX2
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
   // C++17 onwards
 #include <filesystem>
 namespace _gfs = std::filesystem;
@@ -110,7 +115,7 @@ namespace tDX // tucna - DirectX
     Pixel();
     Pixel(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 255);
     Pixel(uint32_t p);
-    enum Mode { NORMAL, MASK, ALPHA, CUSTOM };
+    enum Mode { NORMAL, MASK, ALPHA, CUSTOM, ALPHA_SRGB };
 
     bool operator==(const Pixel& p) const;
     bool operator!=(const Pixel& p) const;
@@ -322,6 +327,7 @@ namespace tDX // tucna - DirectX
     // tDX::Pixel::NORMAL = No transparency
     // tDX::Pixel::MASK   = Transparent if alpha is < 255
     // tDX::Pixel::ALPHA  = Full transparency
+    // tDX::Pixel::ALPHA_SRGB = Full transparency, blended in linear light
     void SetPixelMode(Pixel::Mode m);
     Pixel::Mode GetPixelMode();
     // Use a custom blend function
@@ -334,6 +340,9 @@ namespace tDX // tucna - DirectX
     // Draws a single Pixel
     virtual bool Draw(int32_t x, int32_t y, Pixel p = tDX::WHITE);
     bool Draw(const tDX::vi2d& pos, Pixel p = tDX::WHITE);
+    // Primitives write straight into the draw target and never call Draw. An application
+    // that overrides Draw turns this on to have every primitive pixel go through it again
+    void EnableDrawOverride(bool bEnable);
     // Draws a line from (x1,y1) to (x2,y2)
     void DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p = tDX::WHITE, uint32_t pattern = 0xFFFFFFFF);
     void DrawLine(const tDX::vi2d& pos1, const tDX::vi2d& pos2, Pixel p = tDX::WHITE, uint32_t pattern = 0xFFFFFFFF);
@@ -343,6 +352,10 @@ namespace tDX // tucna - DirectX
     // Fills a circle located at (x,y) with radius
     void FillCircle(int32_t x, int32_t y, int32_t radius, Pixel p = tDX::WHITE);
     void FillCircle(const tDX::vi2d& pos, int32_t radius, Pixel p = tDX::WHITE);
+    // Fill or outline nCount circles given as parallel arrays of centres, radii and colours.
+    // Much cheaper than FillCircle/DrawCircle in a loop when there are many small ones
+    void FillCircles(const int32_t* x, const int32_t* y, const int32_t* radius, const Pixel* col, size_t nCount);
+    void DrawCircles(const int32_t* x, const int32_t* y, const int32_t* radius, const Pixel* col, size_t nCount);
     // Draws a rectangle at (x,y) to (x+w,y+h)
     void DrawRect(int32_t x, int32_t y, int32_t w, int32_t h, Pixel p = tDX::WHITE);
     void DrawRect(const tDX::vi2d& pos, const tDX::vi2d& size, Pixel p = tDX::WHITE);
@@ -412,6 +425,33 @@ namespace tDX // tucna - DirectX
     int			nFrameCount = 0;
     Sprite		*fontSprite = nullptr;
     std::function<tDX::Pixel(const int x, const int y, const tDX::Pixel&, const tDX::Pixel&)> funcPixelMode;
+    bool		bDrawOverride = false;
+
+    // Pixel sinks specialised on the pixel mode, one is picked per primitive by tDX_Dispatch
+    static const int DRAW_OVERRIDE = Pixel::Mode::ALPHA_SRGB + 1;
+    template <int MODE> struct SpanWriter;
+    template <class F> void tDX_Dispatch(F&& fn);
+
+    // sRGB <-> linear light lookups for ALPHA_SRGB, linear values have 12 bits
+    struct sSRGBTables
+    {
+      int32_t toLinear[256];    // 32 bit entries so AVX2 can gather them directly
+      uint8_t toSRGB[4096 + 3]; // Padded for the 32 bit gathers of the last entry
+      sSRGBTables();
+    };
+    static const sSRGBTables srgb;
+    static Pixel tDX_BlendSRGB(Pixel d, Pixel s, int32_t a);
+    static void tDX_BlendSRGBSpan(Pixel *d, int32_t n, Pixel s, int32_t a);
+    static int32_t tDX_SRGBWeight(Pixel p, float fBlend);
+
+    // Span tables of the batched circles, built once per radius
+    struct sCircleRun { int32_t dy, x0, x1; };
+    std::vector<std::vector<int32_t>> vCircleFill;        // Half width of each row, indexed by |dy|
+    std::vector<std::vector<sCircleRun>> vCircleOutline;
+    std::vector<uint32_t> vCircleVisible;
+    size_t tDX_CullCircles(const int32_t* x, const int32_t* y, const int32_t* radius, size_t nCount);
+    const std::vector<int32_t>& tDX_CircleFillSpans(int32_t r);
+    const std::vector<sCircleRun>& tDX_CircleOutline(int32_t r);
 
     static std::map<size_t, uint8_t> mapKeys;
     bool		pKeyNewState[256]{ 0 };
@@ -556,7 +596,7 @@ namespace tDX
 
   Sprite::~Sprite()
   {
-    if (pColData) delete pColData;
+    if (pColData) delete[] pColData;
   }
 
   tDX::rcode Sprite::LoadFromPGESprFile(std::string sImageFile, tDX::ResourcePack *pack)
@@ -1261,6 +1301,222 @@ namespace tDX
     return nScreenHeight;
   }
 
+  //==========================================================
+  // Span writers - the primitives choose one for the current
+  // pixel mode up front, so the inner loops skip the virtual
+  // Draw and its mode checks
+
+  template <int MODE>
+  struct PixelGameEngine::SpanWriter
+  {
+    PixelGameEngine *pge;
+    Pixel *pData;
+    int32_t nPitch;
+    int32_t nWidth;
+    int32_t nHeight;
+    float fBlend;
+
+    inline void Put(int32_t x, int32_t y, Pixel *d, Pixel p) const
+    {
+      if constexpr (MODE == Pixel::Mode::MASK)
+      {
+        if (p.a != 255) return;
+        *d = p;
+      }
+      else if constexpr (MODE == Pixel::Mode::ALPHA)
+      {
+        float a = (float)(p.a / 255.0f) * fBlend;
+        float c = 1.0f - a;
+        float r = a * (float)p.r + c * (float)d->r;
+        float g = a * (float)p.g + c * (float)d->g;
+        float b = a * (float)p.b + c * (float)d->b;
+        *d = Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b);
+      }
+      else if constexpr (MODE == Pixel::Mode::ALPHA_SRGB)
+        *d = tDX_BlendSRGB(*d, p, tDX_SRGBWeight(p, fBlend));
+      else if constexpr (MODE == Pixel::Mode::CUSTOM)
+        *d = pge->funcPixelMode(x, y, p, *d);
+      else
+        *d = p;
+
+#ifdef T_DBG_OVERDRAW
+      Sprite::nOverdrawCount++;
+#endif
+    }
+
+    // Single pixel, dropped when it falls outside the target
+    inline void Plot(int32_t x, int32_t y, Pixel p) const
+    {
+      if constexpr (MODE == DRAW_OVERRIDE)
+        pge->Draw(x, y, p);
+      else if ((uint32_t)x < (uint32_t)nWidth && (uint32_t)y < (uint32_t)nHeight)
+        Put(x, y, pData + y * nPitch + x, p);
+    }
+
+    // Horizontal run from x0 to x1 inclusive, clipped to the target
+    inline void Span(int32_t x0, int32_t x1, int32_t y, Pixel p) const
+    {
+      if constexpr (MODE == DRAW_OVERRIDE)
+      {
+        for (int32_t x = x0; x <= x1; x++)
+          pge->Draw(x, y, p);
+      }
+      else
+      {
+        if ((uint32_t)y >= (uint32_t)nHeight) return;
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, nWidth - 1);
+        if (x1 < x0) return;
+
+        Pixel *d = pData + y * nPitch + x0;
+#ifndef T_DBG_OVERDRAW
+        if constexpr (MODE == Pixel::Mode::NORMAL)
+        {
+          std::fill(d, d + (x1 - x0 + 1), p);
+          return;
+        }
+        if constexpr (MODE == Pixel::Mode::ALPHA_SRGB)
+        {
+          tDX_BlendSRGBSpan(d, x1 - x0 + 1, p, tDX_SRGBWeight(p, fBlend));
+          return;
+        }
+#endif
+        for (int32_t x = x0; x <= x1; x++, d++)
+          Put(x, y, d, p);
+      }
+    }
+  };
+
+  template <class F>
+  void PixelGameEngine::tDX_Dispatch(F&& fn)
+  {
+    if (!pDrawTarget) return;
+
+    Pixel *data = pDrawTarget->GetData();
+    int32_t pitch = pDrawTarget->width;
+    int32_t w = pDrawTarget->width;
+    int32_t h = pDrawTarget->height;
+
+    if (bDrawOverride)
+    {
+      fn(SpanWriter<DRAW_OVERRIDE>{ this, data, pitch, w, h, fBlendFactor });
+      return;
+    }
+
+    switch (nPixelMode)
+    {
+    case Pixel::Mode::NORMAL: fn(SpanWriter<Pixel::Mode::NORMAL>{ this, data, pitch, w, h, fBlendFactor }); break;
+    case Pixel::Mode::MASK:   fn(SpanWriter<Pixel::Mode::MASK>{ this, data, pitch, w, h, fBlendFactor }); break;
+    case Pixel::Mode::ALPHA:  fn(SpanWriter<Pixel::Mode::ALPHA>{ this, data, pitch, w, h, fBlendFactor }); break;
+    case Pixel::Mode::CUSTOM: fn(SpanWriter<Pixel::Mode::CUSTOM>{ this, data, pitch, w, h, fBlendFactor }); break;
+    case Pixel::Mode::ALPHA_SRGB: fn(SpanWriter<Pixel::Mode::ALPHA_SRGB>{ this, data, pitch, w, h, fBlendFactor }); break;
+    }
+  }
+
+  //==========================================================
+  // sRGB blending - colours are decoded to 12 bit linear light,
+  // mixed with an integer weight and encoded back, so the
+  // per pixel cost is a few table lookups and multiplies
+
+  const PixelGameEngine::sSRGBTables PixelGameEngine::srgb;
+
+  PixelGameEngine::sSRGBTables::sSRGBTables()
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      double c = i / 255.0;
+      double l = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+      toLinear[i] = (int32_t)(l * 4095.0 + 0.5);
+    }
+
+    for (int i = 0; i < 4096; i++)
+    {
+      double l = i / 4095.0;
+      double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+      toSRGB[i] = (uint8_t)(c * 255.0 + 0.5);
+    }
+    toSRGB[4096] = toSRGB[4097] = toSRGB[4098] = 0;
+  }
+
+  // Source weight in 0..256 from the pixel alpha and the blend factor
+  int32_t PixelGameEngine::tDX_SRGBWeight(Pixel p, float fBlend)
+  {
+    int32_t a = (int32_t)((float)p.a * fBlend);
+    a = std::clamp(a, 0, 255);
+    return a + (a >> 7);
+  }
+
+  Pixel PixelGameEngine::tDX_BlendSRGB(Pixel d, Pixel s, int32_t a)
+  {
+    int32_t c = 256 - a;
+    int32_t r = (srgb.toLinear[s.r] * a + srgb.toLinear[d.r] * c + 128) >> 8;
+    int32_t g = (srgb.toLinear[s.g] * a + srgb.toLinear[d.g] * c + 128) >> 8;
+    int32_t b = (srgb.toLinear[s.b] * a + srgb.toLinear[d.b] * c + 128) >> 8;
+    return Pixel(srgb.toSRGB[r], srgb.toSRGB[g], srgb.toSRGB[b]);
+  }
+
+  // One source colour over a run of pixels, the source terms are
+  // hoisted and the destination is done several pixels at a time
+  void PixelGameEngine::tDX_BlendSRGBSpan(Pixel *d, int32_t n, Pixel s, int32_t a)
+  {
+    int32_t c = 256 - a;
+    int32_t sr = srgb.toLinear[s.r] * a + 128;
+    int32_t sg = srgb.toLinear[s.g] * a + 128;
+    int32_t sb = srgb.toLinear[s.b] * a + 128;
+    int32_t i = 0;
+
+    // With the source fixed each output channel depends only on the
+    // destination byte, so long runs build a 256 entry table first
+    if (n >= 256)
+    {
+      uint8_t lut[3][256];
+      for (int k = 0; k < 256; k++)
+      {
+        int32_t l = srgb.toLinear[k] * c;
+        lut[0][k] = srgb.toSRGB[(l + sr) >> 8];
+        lut[1][k] = srgb.toSRGB[(l + sg) >> 8];
+        lut[2][k] = srgb.toSRGB[(l + sb) >> 8];
+      }
+      for (; i < n; i++)
+        d[i] = Pixel(lut[0][d[i].r], lut[1][d[i].g], lut[2][d[i].b]);
+      return;
+    }
+
+#if defined(__AVX2__)
+    const __m256i vMask = _mm256_set1_epi32(0xFF);
+    const __m256i vWeight = _mm256_set1_epi32(c);
+    const __m256i vAlpha = _mm256_set1_epi32((int32_t)0xFF000000);
+    auto channel = [&](__m256i px, int shift, int32_t src)
+    {
+      __m256i lin = _mm256_i32gather_epi32(srgb.toLinear, _mm256_and_si256(_mm256_srli_epi32(px, shift), vMask), 4);
+      lin = _mm256_srli_epi32(_mm256_add_epi32(_mm256_mullo_epi32(lin, vWeight), _mm256_set1_epi32(src)), 8);
+      return _mm256_and_si256(_mm256_i32gather_epi32((const int*)srgb.toSRGB, lin, 1), vMask);
+    };
+    for (; i + 8 <= n; i += 8)
+    {
+      __m256i px = _mm256_loadu_si256((const __m256i*)(d + i));
+      __m256i r = channel(px, 0, sr);
+      __m256i g = channel(px, 8, sg);
+      __m256i b = channel(px, 16, sb);
+      px = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)), _mm256_or_si256(_mm256_slli_epi32(b, 16), vAlpha));
+      _mm256_storeu_si256((__m256i*)(d + i), px);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+      int32_t r = (srgb.toLinear[d[i].r] * c + sr) >> 8;
+      int32_t g = (srgb.toLinear[d[i].g] * c + sg) >> 8;
+      int32_t b = (srgb.toLinear[d[i].b] * c + sb) >> 8;
+      d[i] = Pixel(srgb.toSRGB[r], srgb.toSRGB[g], srgb.toSRGB[b]);
+    }
+  }
+
+  void PixelGameEngine::EnableDrawOverride(bool bEnable)
+  {
+    bDrawOverride = bEnable;
+  }
+
   bool PixelGameEngine::Draw(const tDX::vi2d& pos, Pixel p)
   {
     return Draw(pos.x, pos.y, p);
@@ -1292,6 +1548,12 @@ namespace tDX
       return pDrawTarget->SetPixel(x, y, Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b));
     }
 
+    if (nPixelMode == Pixel::Mode::ALPHA_SRGB)
+    {
+      if ((uint32_t)x >= (uint32_t)pDrawTarget->width || (uint32_t)y >= (uint32_t)pDrawTarget->height) return false;
+      return pDrawTarget->SetPixel(x, y, tDX_BlendSRGB(pDrawTarget->GetPixel(x, y), p, tDX_SRGBWeight(p, fBlendFactor)));
+    }
+
     if (nPixelMode == Pixel::Mode::CUSTOM)
     {
       return pDrawTarget->SetPixel(x, y, funcPixelMode(x, y, p, pDrawTarget->GetPixel(x, y)));
@@ -1313,87 +1575,93 @@ namespace tDX
 
   void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern)
   {
-    int x, y, dx, dy, dx1, dy1, px, py, xe, ye, i;
-    dx = x2 - x1; dy = y2 - y1;
-
-    auto rol = [&](void)
-    {
-      pattern = (pattern << 1) | (pattern >> 31);
-      return pattern & 1;
-    };
-
-    // straight lines idea by gurkanctn
-    if (dx == 0) // Line is vertical
+    tDX_Dispatch([&](const auto &out)
     {
-      if (y2 < y1) std::swap(y1, y2);
-      for (y = y1; y <= y2; y++)
-        if (rol()) Draw(x1, y, p);
-      return;
-    }
+      int x, y, dx, dy, dx1, dy1, px, py, xe, ye, i;
+      dx = x2 - x1; dy = y2 - y1;
 
-    if (dy == 0) // Line is horizontal
-    {
-      if (x2 < x1) std::swap(x1, x2);
-      for (x = x1; x <= x2; x++)
-        if (rol()) Draw(x, y1, p);
-      return;
-    }
+      auto rol = [&](void)
+      {
+        pattern = (pattern << 1) | (pattern >> 31);
+        return pattern & 1;
+      };
 
-    // Line is Funk-aye
-    dx1 = abs(dx); dy1 = abs(dy);
-    px = 2 * dy1 - dx1;	py = 2 * dx1 - dy1;
-    if (dy1 <= dx1)
-    {
-      if (dx >= 0)
+      // straight lines idea by gurkanctn
+      if (dx == 0) // Line is vertical
       {
-        x = x1; y = y1; xe = x2;
+        if (y2 < y1) std::swap(y1, y2);
+        for (y = y1; y <= y2; y++)
+          if (rol()) out.Plot(x1, y, p);
+        return;
       }
-      else
+
+      if (dy == 0) // Line is horizontal
       {
-        x = x2; y = y2; xe = x1;
+        if (x2 < x1) std::swap(x1, x2);
+        if (pattern == 0xFFFFFFFF)
+          out.Span(x1, x2, y1, p);
+        else
+          for (x = x1; x <= x2; x++)
+            if (rol()) out.Plot(x, y1, p);
+        return;
       }
 
-      if (rol()) Draw(x, y, p);
-
-      for (i = 0; x < xe; i++)
+      // Line is Funk-aye
+      dx1 = abs(dx); dy1 = abs(dy);
+      px = 2 * dy1 - dx1;	py = 2 * dx1 - dy1;
+      if (dy1 <= dx1)
       {
-        x = x + 1;
-        if (px < 0)
-          px = px + 2 * dy1;
+        if (dx >= 0)
+        {
+          x = x1; y = y1; xe = x2;
+        }
         else
         {
-          if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) y = y + 1; else y = y - 1;
-          px = px + 2 * (dy1 - dx1);
+          x = x2; y = y2; xe = x1;
+        }
+
+        if (rol()) out.Plot(x, y, p);
+
+        for (i = 0; x < xe; i++)
+        {
+          x = x + 1;
+          if (px < 0)
+            px = px + 2 * dy1;
+          else
+          {
+            if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) y = y + 1; else y = y - 1;
+            px = px + 2 * (dy1 - dx1);
+          }
+          if (rol()) out.Plot(x, y, p);
         }
-        if (rol()) Draw(x, y, p);
-      }
-    }
-    else
-    {
-      if (dy >= 0)
-      {
-        x = x1; y = y1; ye = y2;
       }
       else
       {
-        x = x2; y = y2; ye = y1;
-      }
+        if (dy >= 0)
+        {
+          x = x1; y = y1; ye = y2;
+        }
+        else
+        {
+          x = x2; y = y2; ye = y1;
+        }
 
-      if (rol()) Draw(x, y, p);
+        if (rol()) out.Plot(x, y, p);
 
-      for (i = 0; y < ye; i++)
-      {
-        y = y + 1;
-        if (py <= 0)
-          py = py + 2 * dx1;
-        else
+        for (i = 0; y < ye; i++)
         {
-          if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) x = x + 1; else x = x - 1;
-          py = py + 2 * (dx1 - dy1);
+          y = y + 1;
+          if (py <= 0)
+            py = py + 2 * dx1;
+          else
+          {
+            if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) x = x + 1; else x = x - 1;
+            py = py + 2 * (dx1 - dy1);
+          }
+          if (rol()) out.Plot(x, y, p);
         }
-        if (rol()) Draw(x, y, p);
       }
-    }
+    });
   }
 
   void PixelGameEngine::DrawCircle(const tDX::vi2d& pos, int32_t radius, Pixel p, uint8_t mask)
@@ -1408,19 +1676,22 @@ namespace tDX
     int d = 3 - 2 * radius;
     if (!radius) return;
 
-    while (y0 >= x0) // only formulate 1/8 of circle
+    tDX_Dispatch([&](const auto &out)
     {
-      if (mask & 0x01) Draw(x + x0, y - y0, p);
-      if (mask & 0x02) Draw(x + y0, y - x0, p);
-      if (mask & 0x04) Draw(x + y0, y + x0, p);
-      if (mask & 0x08) Draw(x + x0, y + y0, p);
-      if (mask & 0x10) Draw(x - x0, y + y0, p);
-      if (mask & 0x20) Draw(x - y0, y + x0, p);
-      if (mask & 0x40) Draw(x - y0, y - x0, p);
-      if (mask & 0x80) Draw(x - x0, y - y0, p);
-      if (d < 0) d += 4 * x0++ + 6;
-      else d += 4 * (x0++ - y0--) + 10;
-    }
+      while (y0 >= x0) // only formulate 1/8 of circle
+      {
+        if (mask & 0x01) out.Plot(x + x0, y - y0, p);
+        if (mask & 0x02) out.Plot(x + y0, y - x0, p);
+        if (mask & 0x04) out.Plot(x + y0, y + x0, p);
+        if (mask & 0x08) out.Plot(x + x0, y + y0, p);
+        if (mask & 0x10) out.Plot(x - x0, y + y0, p);
+        if (mask & 0x20) out.Plot(x - y0, y + x0, p);
+        if (mask & 0x40) out.Plot(x - y0, y - x0, p);
+        if (mask & 0x80) out.Plot(x - x0, y - y0, p);
+        if (d < 0) d += 4 * x0++ + 6;
+        else d += 4 * (x0++ - y0--) + 10;
+      }
+    });
   }
 
   void PixelGameEngine::FillCircle(const tDX::vi2d& pos, int32_t radius, Pixel p)
@@ -1436,22 +1707,154 @@ namespace tDX
     int d = 3 - 2 * radius;
     if (!radius) return;
 
-    auto drawline = [&](int sx, int ex, int ny)
+    tDX_Dispatch([&](const auto &out)
     {
-      for (int i = sx; i <= ex; i++)
-        Draw(i, ny, p);
-    };
+      auto drawline = [&](int sx, int ex, int ny)
+      {
+        out.Span(sx, ex, ny, p);
+      };
+
+      while (y0 >= x0)
+      {
+        // Modified to draw scan-lines instead of edges
+        drawline(x - x0, x + x0, y - y0);
+        drawline(x - y0, x + y0, y - x0);
+        drawline(x - x0, x + x0, y + y0);
+        drawline(x - y0, x + y0, y + x0);
+        if (d < 0) d += 4 * x0++ + 6;
+        else d += 4 * (x0++ - y0--) + 10;
+      }
+    });
+  }
+
+  void PixelGameEngine::FillCircles(const int32_t* x, const int32_t* y, const int32_t* radius, const Pixel* col, size_t nCount)
+  {
+    size_t nVisible = tDX_CullCircles(x, y, radius, nCount);
+    if (nVisible == 0) return;
+
+    // Tables must exist before drawing starts, building them can move the storage
+    for (size_t n = 0; n < nVisible; n++)
+      tDX_CircleFillSpans(radius[vCircleVisible[n]]);
 
-    while (y0 >= x0)
+    int32_t h = pDrawTarget->height;
+    tDX_Dispatch([&](const auto &out)
     {
-      // Modified to draw scan-lines instead of edges
-      drawline(x - x0, x + x0, y - y0);
-      drawline(x - y0, x + y0, y - x0);
-      drawline(x - x0, x + x0, y + y0);
-      drawline(x - y0, x + y0, y + x0);
-      if (d < 0) d += 4 * x0++ + 6;
-      else d += 4 * (x0++ - y0--) + 10;
+      for (size_t n = 0; n < nVisible; n++)
+      {
+        uint32_t i = vCircleVisible[n];
+        int32_t r = radius[i];
+        const int32_t *hw = vCircleFill[r].data();
+
+        // Rows outside the target are skipped up front, Span clips the ends
+        int32_t j0 = std::max(-r, -y[i]);
+        int32_t j1 = std::min(r, h - 1 - y[i]);
+        for (int32_t j = j0; j <= j1; j++)
+          out.Span(x[i] - hw[abs(j)], x[i] + hw[abs(j)], y[i] + j, col[i]);
+      }
+    });
+  }
+
+  void PixelGameEngine::DrawCircles(const int32_t* x, const int32_t* y, const int32_t* radius, const Pixel* col, size_t nCount)
+  {
+    size_t nVisible = tDX_CullCircles(x, y, radius, nCount);
+    if (nVisible == 0) return;
+
+    for (size_t n = 0; n < nVisible; n++)
+      tDX_CircleOutline(radius[vCircleVisible[n]]);
+
+    tDX_Dispatch([&](const auto &out)
+    {
+      for (size_t n = 0; n < nVisible; n++)
+      {
+        uint32_t i = vCircleVisible[n];
+        for (const sCircleRun& run : vCircleOutline[radius[i]])
+          out.Span(x[i] + run.x0, x[i] + run.x1, y[i] + run.dy, col[i]);
+      }
+    });
+  }
+
+  size_t PixelGameEngine::tDX_CullCircles(const int32_t* x, const int32_t* y, const int32_t* radius, size_t nCount)
+  {
+    if (!pDrawTarget || nCount == 0) return 0;
+
+    // Branch free compaction of the circles touching the target
+    int32_t w = pDrawTarget->width;
+    int32_t h = pDrawTarget->height;
+    vCircleVisible.resize(nCount);
+    uint32_t *visible = vCircleVisible.data();
+    size_t n = 0;
+    for (size_t i = 0; i < nCount; i++)
+    {
+      int32_t r = radius[i];
+      bool bVisible = (r > 0) & (x[i] + r >= 0) & (x[i] - r < w) & (y[i] + r >= 0) & (y[i] - r < h);
+      visible[n] = (uint32_t)i;
+      n += bVisible;
     }
+    return n;
+  }
+
+  const std::vector<int32_t>& PixelGameEngine::tDX_CircleFillSpans(int32_t r)
+  {
+    if ((size_t)r >= vCircleFill.size())
+      vCircleFill.resize(r + 1);
+
+    std::vector<int32_t>& hw = vCircleFill[r];
+    if (hw.empty())
+    {
+      // Same walk as FillCircle, keeping the widest span of each row
+      hw.assign(r + 1, 0);
+      int x0 = 0;
+      int y0 = r;
+      int d = 3 - 2 * r;
+      while (y0 >= x0)
+      {
+        hw[y0] = std::max(hw[y0], x0);
+        hw[x0] = std::max(hw[x0], y0);
+        if (d < 0) d += 4 * x0++ + 6;
+        else d += 4 * (x0++ - y0--) + 10;
+      }
+    }
+    return hw;
+  }
+
+  const std::vector<PixelGameEngine::sCircleRun>& PixelGameEngine::tDX_CircleOutline(int32_t r)
+  {
+    if ((size_t)r >= vCircleOutline.size())
+      vCircleOutline.resize(r + 1);
+
+    std::vector<sCircleRun>& runs = vCircleOutline[r];
+    if (runs.empty())
+    {
+      // Same points as DrawCircle, merged into runs per row so each pixel is written once
+      std::vector<std::vector<int32_t>> rows(2 * r + 1);
+      auto add = [&](int32_t dx, int32_t dy) { rows[dy + r].push_back(dx); };
+
+      int x0 = 0;
+      int y0 = r;
+      int d = 3 - 2 * r;
+      while (y0 >= x0)
+      {
+        add(x0, -y0); add(y0, -x0); add(y0, x0); add(x0, y0);
+        add(-x0, y0); add(-y0, x0); add(-y0, -x0); add(-x0, -y0);
+        if (d < 0) d += 4 * x0++ + 6;
+        else d += 4 * (x0++ - y0--) + 10;
+      }
+
+      for (int32_t dy = -r; dy <= r; dy++)
+      {
+        std::vector<int32_t>& xs = rows[dy + r];
+        std::sort(xs.begin(), xs.end());
+        xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+        for (size_t k = 0; k < xs.size(); k++)
+        {
+          if (k > 0 && xs[k] == runs.back().x1 + 1 && runs.back().dy == dy)
+            runs.back().x1 = xs[k];
+          else
+            runs.push_back({ dy, xs[k], xs[k] });
+        }
+      }
+    }
+    return runs;
   }
 
   void PixelGameEngine::DrawRect(const tDX::vi2d& pos, const tDX::vi2d& size, Pixel p)
@@ -1498,9 +1901,11 @@ namespace tDX
     if (y2 < 0) y2 = 0;
     if (y2 >= (int32_t)GetDrawTargetHeight()) y2 = (int32_t)GetDrawTargetHeight();
 
-    for (int i = x; i < x2; i++)
+    tDX_Dispatch([&](const auto &out)
+    {
       for (int j = y; j < y2; j++)
-        Draw(i, j, p);
+        out.Span(x, x2 - 1, j, p);
+    });
   }
 
   void PixelGameEngine::DrawTriangle(const tDX::vi2d& pos1, const tDX::vi2d& pos2, const tDX::vi2d& pos3, Pixel p)
@@ -1523,143 +1928,146 @@ namespace tDX
   // https://www.avrfreaks.net/sites/default/files/triangles.c
   void PixelGameEngine::FillTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p)
   {
-    auto SWAP = [](int &x, int &y) { int t = x; x = y; y = t; };
-    auto drawline = [&](int sx, int ex, int ny) { for (int i = sx; i <= ex; i++) Draw(i, ny, p); };
-
-    int t1x, t2x, y, minx, maxx, t1xp, t2xp;
-    bool changed1 = false;
-    bool changed2 = false;
-    int signx1, signx2, dx1, dy1, dx2, dy2;
-    int e1, e2;
-    // Sort vertices
-    if (y1 > y2) { SWAP(y1, y2); SWAP(x1, x2); }
-    if (y1 > y3) { SWAP(y1, y3); SWAP(x1, x3); }
-    if (y2 > y3) { SWAP(y2, y3); SWAP(x2, x3); }
-
-    t1x = t2x = x1; y = y1;   // Starting points
-    dx1 = (int)(x2 - x1); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
-    else signx1 = 1;
-    dy1 = (int)(y2 - y1);
-
-    dx2 = (int)(x3 - x1); if (dx2 < 0) { dx2 = -dx2; signx2 = -1; }
-    else signx2 = 1;
-    dy2 = (int)(y3 - y1);
-
-    if (dy1 > dx1) {   // swap values
-      SWAP(dx1, dy1);
-      changed1 = true;
-    }
-    if (dy2 > dx2) {   // swap values
-      SWAP(dy2, dx2);
-      changed2 = true;
-    }
-
-    e2 = (int)(dx2 >> 1);
-    // Flat top, just process the second half
-    if (y1 == y2) goto next;
-    e1 = (int)(dx1 >> 1);
-
-    for (int i = 0; i < dx1;) {
-      t1xp = 0; t2xp = 0;
-      if (t1x < t2x) { minx = t1x; maxx = t2x; }
-      else { minx = t2x; maxx = t1x; }
-      // process first line until y value is about to change
-      while (i < dx1) {
-        i++;
-        e1 += dy1;
-        while (e1 >= dx1) {
-          e1 -= dx1;
-          if (changed1) t1xp = signx1;//t1x += signx1;
-          else          goto next1;
-        }
-        if (changed1) break;
-        else t1x += signx1;
+    tDX_Dispatch([&](const auto &out)
+    {
+      auto SWAP = [](int &x, int &y) { int t = x; x = y; y = t; };
+      auto drawline = [&](int sx, int ex, int ny) { out.Span(sx, ex, ny, p); };
+
+      int t1x, t2x, y, minx, maxx, t1xp, t2xp;
+      bool changed1 = false;
+      bool changed2 = false;
+      int signx1, signx2, dx1, dy1, dx2, dy2;
+      int e1, e2;
+      // Sort vertices
+      if (y1 > y2) { SWAP(y1, y2); SWAP(x1, x2); }
+      if (y1 > y3) { SWAP(y1, y3); SWAP(x1, x3); }
+      if (y2 > y3) { SWAP(y2, y3); SWAP(x2, x3); }
+
+      t1x = t2x = x1; y = y1;   // Starting points
+      dx1 = (int)(x2 - x1); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
+      else signx1 = 1;
+      dy1 = (int)(y2 - y1);
+
+      dx2 = (int)(x3 - x1); if (dx2 < 0) { dx2 = -dx2; signx2 = -1; }
+      else signx2 = 1;
+      dy2 = (int)(y3 - y1);
+
+      if (dy1 > dx1) {   // swap values
+        SWAP(dx1, dy1);
+        changed1 = true;
       }
-      // Move line
-    next1:
-      // process second line until y value is about to change
-      while (1) {
-        e2 += dy2;
-        while (e2 >= dx2) {
-          e2 -= dx2;
-          if (changed2) t2xp = signx2;//t2x += signx2;
-          else          goto next2;
-        }
-        if (changed2)     break;
-        else              t2x += signx2;
+      if (dy2 > dx2) {   // swap values
+        SWAP(dy2, dx2);
+        changed2 = true;
       }
-    next2:
-      if (minx > t1x) minx = t1x;
-      if (minx > t2x) minx = t2x;
-      if (maxx < t1x) maxx = t1x;
-      if (maxx < t2x) maxx = t2x;
-      drawline(minx, maxx, y);    // Draw line from min to max points found on the y
-                    // Now increase y
-      if (!changed1) t1x += signx1;
-      t1x += t1xp;
-      if (!changed2) t2x += signx2;
-      t2x += t2xp;
-      y += 1;
-      if (y == y2) break;
 
-    }
-  next:
-    // Second half
-    dx1 = (int)(x3 - x2); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
-    else signx1 = 1;
-    dy1 = (int)(y3 - y2);
-    t1x = x2;
-
-    if (dy1 > dx1) {   // swap values
-      SWAP(dy1, dx1);
-      changed1 = true;
-    }
-    else changed1 = false;
-
-    e1 = (int)(dx1 >> 1);
-
-    for (int i = 0; i <= dx1; i++) {
-      t1xp = 0; t2xp = 0;
-      if (t1x < t2x) { minx = t1x; maxx = t2x; }
-      else { minx = t2x; maxx = t1x; }
-      // process first line until y value is about to change
-      while (i < dx1) {
-        e1 += dy1;
-        while (e1 >= dx1) {
-          e1 -= dx1;
-          if (changed1) { t1xp = signx1; break; }//t1x += signx1;
-          else          goto next3;
+      e2 = (int)(dx2 >> 1);
+      // Flat top, just process the second half
+      if (y1 == y2) goto next;
+      e1 = (int)(dx1 >> 1);
+
+      for (int i = 0; i < dx1;) {
+        t1xp = 0; t2xp = 0;
+        if (t1x < t2x) { minx = t1x; maxx = t2x; }
+        else { minx = t2x; maxx = t1x; }
+        // process first line until y value is about to change
+        while (i < dx1) {
+          i++;
+          e1 += dy1;
+          while (e1 >= dx1) {
+            e1 -= dx1;
+            if (changed1) t1xp = signx1;//t1x += signx1;
+            else          goto next1;
+          }
+          if (changed1) break;
+          else t1x += signx1;
+        }
+        // Move line
+      next1:
+        // process second line until y value is about to change
+        while (1) {
+          e2 += dy2;
+          while (e2 >= dx2) {
+            e2 -= dx2;
+            if (changed2) t2xp = signx2;//t2x += signx2;
+            else          goto next2;
+          }
+          if (changed2)     break;
+          else              t2x += signx2;
         }
-        if (changed1) break;
-        else   	   	  t1x += signx1;
-        if (i < dx1) i++;
+      next2:
+        if (minx > t1x) minx = t1x;
+        if (minx > t2x) minx = t2x;
+        if (maxx < t1x) maxx = t1x;
+        if (maxx < t2x) maxx = t2x;
+        drawline(minx, maxx, y);    // Draw line from min to max points found on the y
+                      // Now increase y
+        if (!changed1) t1x += signx1;
+        t1x += t1xp;
+        if (!changed2) t2x += signx2;
+        t2x += t2xp;
+        y += 1;
+        if (y == y2) break;
+
+      }
+    next:
+      // Second half
+      dx1 = (int)(x3 - x2); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
+      else signx1 = 1;
+      dy1 = (int)(y3 - y2);
+      t1x = x2;
+
+      if (dy1 > dx1) {   // swap values
+        SWAP(dy1, dx1);
+        changed1 = true;
       }
-    next3:
-      // process second line until y value is about to change
-      while (t2x != x3) {
-        e2 += dy2;
-        while (e2 >= dx2) {
-          e2 -= dx2;
-          if (changed2) t2xp = signx2;
-          else          goto next4;
+      else changed1 = false;
+
+      e1 = (int)(dx1 >> 1);
+
+      for (int i = 0; i <= dx1; i++) {
+        t1xp = 0; t2xp = 0;
+        if (t1x < t2x) { minx = t1x; maxx = t2x; }
+        else { minx = t2x; maxx = t1x; }
+        // process first line until y value is about to change
+        while (i < dx1) {
+          e1 += dy1;
+          while (e1 >= dx1) {
+            e1 -= dx1;
+            if (changed1) { t1xp = signx1; break; }//t1x += signx1;
+            else          goto next3;
+          }
+          if (changed1) break;
+          else   	   	  t1x += signx1;
+          if (i < dx1) i++;
         }
-        if (changed2)     break;
-        else              t2x += signx2;
+      next3:
+        // process second line until y value is about to change
+        while (t2x != x3) {
+          e2 += dy2;
+          while (e2 >= dx2) {
+            e2 -= dx2;
+            if (changed2) t2xp = signx2;
+            else          goto next4;
+          }
+          if (changed2)     break;
+          else              t2x += signx2;
+        }
+      next4:
+
+        if (minx > t1x) minx = t1x;
+        if (minx > t2x) minx = t2x;
+        if (maxx < t1x) maxx = t1x;
+        if (maxx < t2x) maxx = t2x;
+        drawline(minx, maxx, y);
+        if (!changed1) t1x += signx1;
+        t1x += t1xp;
+        if (!changed2) t2x += signx2;
+        t2x += t2xp;
+        y += 1;
+        if (y > y3) return;
       }
-    next4:
-
-      if (minx > t1x) minx = t1x;
-      if (minx > t2x) minx = t2x;
-      if (maxx < t1x) maxx = t1x;
-      if (maxx < t2x) maxx = t2x;
-      drawline(minx, maxx, y);
-      if (!changed1) t1x += signx1;
-      t1x += t1xp;
-      if (!changed2) t2x += signx2;
-      t2x += t2xp;
-      y += 1;
-      if (y > y3) return;
-    }
+    });
   }
 
   void PixelGameEngine::DrawSprite(const tDX::vi2d& pos, Sprite *sprite, uint32_t scale)
@@ -1672,20 +2080,22 @@ namespace tDX
     if (sprite == nullptr)
       return;
 
-    if (scale > 1)
+    tDX_Dispatch([&](const auto &out)
     {
-      for (int32_t i = 0; i < sprite->width; i++)
-        for (int32_t j = 0; j < sprite->height; j++)
-          for (uint32_t is = 0; is < scale; is++)
+      if (scale > 1)
+      {
+        for (int32_t i = 0; i < sprite->width; i++)
+          for (int32_t j = 0; j < sprite->height; j++)
             for (uint32_t js = 0; js < scale; js++)
-              Draw(x + (i*scale) + is, y + (j*scale) + js, sprite->GetPixel(i, j));
-    }
-    else
-    {
-      for (int32_t i = 0; i < sprite->width; i++)
+              out.Span(x + (i*scale), x + (i*scale) + scale - 1, y + (j*scale) + js, sprite->GetPixel(i, j));
+      }
+      else
+      {
         for (int32_t j = 0; j < sprite->height; j++)
-          Draw(x + i, y + j, sprite->GetPixel(i, j));
-    }
+          for (int32_t i = 0; i < sprite->width; i++)
+            out.Plot(x + i, y + j, sprite->GetPixel(i, j));
+      }
+    });
   }
 
   void PixelGameEngine::DrawPartialSprite(const tDX::vi2d& pos, Sprite *sprite, const tDX::vi2d& sourcepos, const tDX::vi2d& size, uint32_t scale)
@@ -1698,20 +2108,22 @@ namespace tDX
     if (sprite == nullptr)
       return;
 
-    if (scale > 1)
+    tDX_Dispatch([&](const auto &out)
     {
-      for (int32_t i = 0; i < w; i++)
-        for (int32_t j = 0; j < h; j++)
-          for (uint32_t is = 0; is < scale; is++)
+      if (scale > 1)
+      {
+        for (int32_t i = 0; i < w; i++)
+          for (int32_t j = 0; j < h; j++)
             for (uint32_t js = 0; js < scale; js++)
-              Draw(x + (i*scale) + is, y + (j*scale) + js, sprite->GetPixel(i + ox, j + oy));
-    }
-    else
-    {
-      for (int32_t i = 0; i < w; i++)
+              out.Span(x + (i*scale), x + (i*scale) + scale - 1, y + (j*scale) + js, sprite->GetPixel(i + ox, j + oy));
+      }
+      else
+      {
         for (int32_t j = 0; j < h; j++)
-          Draw(x + i, y + j, sprite->GetPixel(i + ox, j + oy));
-    }
+          for (int32_t i = 0; i < w; i++)
+            out.Plot(x + i, y + j, sprite->GetPixel(i + ox, j + oy));
+      }
+    });
   }
 
   void PixelGameEngine::DrawString(const tDX::vi2d& pos, const std::string& sText, Pixel col, uint32_t scale)
@@ -1725,40 +2137,42 @@ namespace tDX
     int32_t sy = 0;
     Pixel::Mode m = nPixelMode;
     if (col.a != 255)
-      SetPixelMode(Pixel::Mode::ALPHA);
+      SetPixelMode(m == Pixel::Mode::ALPHA_SRGB ? m : Pixel::Mode::ALPHA);
     else
       SetPixelMode(Pixel::Mode::MASK);
 
-    for (auto c : sText)
+    tDX_Dispatch([&](const auto &out)
     {
-      if (c == '\n')
+      for (auto c : sText)
       {
-        sx = 0; sy += 8 * scale;
-      }
-      else
-      {
-        int32_t ox = (c - 32) % 16;
-        int32_t oy = (c - 32) / 16;
-
-        if (scale > 1)
+        if (c == '\n')
         {
-          for (uint32_t i = 0; i < 8; i++)
-            for (uint32_t j = 0; j < 8; j++)
-              if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-                for (uint32_t is = 0; is < scale; is++)
-                  for (uint32_t js = 0; js < scale; js++)
-                    Draw(x + sx + (i*scale) + is, y + sy + (j*scale) + js, col);
+          sx = 0; sy += 8 * scale;
         }
         else
         {
-          for (uint32_t i = 0; i < 8; i++)
-            for (uint32_t j = 0; j < 8; j++)
-              if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-                Draw(x + sx + i, y + sy + j, col);
+          int32_t ox = (c - 32) % 16;
+          int32_t oy = (c - 32) / 16;
+
+          if (scale > 1)
+          {
+            for (uint32_t i = 0; i < 8; i++)
+              for (uint32_t j = 0; j < 8; j++)
+                if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
+                  for (uint32_t js = 0; js < scale; js++)
+                    out.Span(x + sx + (i*scale), x + sx + (i*scale) + scale - 1, y + sy + (j*scale) + js, col);
+          }
+          else
+          {
+            for (uint32_t i = 0; i < 8; i++)
+              for (uint32_t j = 0; j < 8; j++)
+                if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
+                  out.Plot(x + sx + i, y + sy + j, col);
+          }
+          sx += 8 * scale;
         }
-        sx += 8 * scale;
       }
-    }
+    });
     SetPixelMode(m);
   }
 
@@ -3,11 +3,19 @@
 #include <cmath>
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <algorithm>
 #include <string>
-#include <set>
+#include <charconv>
+#include <cstring>
+#include <climits>
 #include <fstream>
-#include <sstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>   // 8 vertices per step in transformVertices
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>   // 4 vertices per step
+#endif
 
 #define NOMINMAX      // Must come before Windows.h
 #include <Windows.h>  // For console font manipulation
@@ -20,6 +28,8 @@ const int HEIGHT = 170;
 const float MODEL_SIZE = 150.0f;       // Controls the size of the cube
 const float CAMERA_DISTANCE = 3.0f;  // Distance from camera to cube (for perspective)
 const float FOV = 90.0f;             // Field of view in degrees
+const float NEAR_PLANE = 0.1f;       // Closest depth drawn, edges are cut off there
+const float DEPTH_BIAS = 0.02f;      // Lets edges lying on a surface show through it
 
 // ASCII characters used for shading based on depth (from darkest to lightest)
 const char SHADES[] = ".:-=+*#%@";
@@ -41,6 +51,26 @@ struct Point2D
 std::vector<Point3D> model_vertices;
 std::vector<std::pair<int, int>> model_edges;
 
+// The mesh that gets drawn, it points either into the vectors above
+// or straight into a memory mapped mesh cache file
+struct MeshView
+{
+  const Point3D* vertices = nullptr;
+  size_t vertex_count = 0;
+  const std::pair<int, int>* edges = nullptr;
+  size_t edge_count = 0;
+
+  // Topology of face meshes, see MeshTopology. No edge_face_offsets
+  // means the edges came from 'l' records and have no faces
+  const int* triangles = nullptr;
+  size_t triangle_count = 0;
+  const Point3D* face_normals = nullptr;
+  const int* edge_face_offsets = nullptr;
+  const int* edge_faces = nullptr;
+};
+
+MeshView model;
+
 // Default cube vertices
 std::vector<Point3D> cube_vertices =
 {
@@ -56,123 +86,587 @@ std::vector<std::pair<int, int>> cube_edges =
     {0,4}, {1,5}, {2,6}, {3,7}  // vertical edges
 };
 
-// Function to load OBJ file and extract vertices and edges
-bool loadOBJ(const std::string& filename)
+// Read-only memory mapping of a file. Small files are mapped whole, the OBJ
+// parser only creates the mapping and reads it through FileWindows
+struct MappedFile
 {
-  std::ifstream file(filename);
-  if (!file.is_open())
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+  const char* data = nullptr;
+  size_t size = 0;
+
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const std::string& filename, bool map_whole = true)
   {
-    std::cerr << "Error: Could not open OBJ file: " << filename << std::endl;
-    return false;
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) return false;
+    size = static_cast<size_t>(file_size.QuadPart);
+
+    // Empty files cannot be mapped, but there is nothing to read either
+    if (size == 0) return true;
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return false;
+    if (!map_whole) return true;
+
+    data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    return data != nullptr;
   }
 
-  model_vertices.clear();
-  model_edges.clear();
+  // Last modification time in 100ns ticks, 0 if unknown
+  uint64_t writeTime() const
+  {
+    FILETIME write_time;
+    if (file == INVALID_HANDLE_VALUE || !GetFileTime(file, nullptr, nullptr, &write_time)) return 0;
+    return (static_cast<uint64_t>(write_time.dwHighDateTime) << 32) | write_time.dwLowDateTime;
+  }
 
-  std::string line;
-  std::vector<std::vector<int>> faces; // Store face data to generate edges
+  void close()
+  {
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+    data = nullptr;
+    size = 0;
+  }
 
-  while (std::getline(file, line))
+  ~MappedFile()
   {
-    if (line.empty() || line[0] == '#') continue; // Skip empty lines and comments
+    close();
+  }
+};
+
+// A view of part of a mapped file. The OBJ parser maps one window per thread
+// at a time, so no more than a few windows of a huge file are ever resident
+struct FileWindow
+{
+  const char* view = nullptr;
+  uint64_t view_offset = 0;   // File offset of view[0]
+
+  FileWindow() = default;
+  FileWindow(const FileWindow&) = delete;
+  FileWindow& operator=(const FileWindow&) = delete;
+
+  // Maps at least [from, to) of the file. Views have to start on a multiple
+  // of the 64 KB allocation granularity, so a little before from is mapped too
+  bool map(const MappedFile& file, uint64_t from, uint64_t to)
+  {
+    unmap();
+
+    view_offset = from & ~uint64_t(64 * 1024 - 1);
+    view = static_cast<const char*>(MapViewOfFile(file.mapping, FILE_MAP_READ,
+      static_cast<DWORD>(view_offset >> 32), static_cast<DWORD>(view_offset), static_cast<size_t>(to - view_offset)));
+    return view != nullptr;
+  }
+
+  // Address of a file offset inside the view
+  const char* at(uint64_t offset) const
+  {
+    return view + (offset - view_offset);
+  }
+
+  void unmap()
+  {
+    if (view) UnmapViewOfFile(view);
+    view = nullptr;
+  }
+
+  ~FileWindow()
+  {
+    unmap();
+  }
+};
+
+// Maps the lines that start in [begin, end) of the file and returns them as
+// [first, last). The view reaches a bit past end and grows until the last of
+// those lines is complete
+bool mapWindowLines(const MappedFile& file, FileWindow& window, uint64_t begin, uint64_t end,
+  const char*& first, const char*& last)
+{
+  uint64_t overhang = 64 * 1024;
+
+  while (true)
+  {
+    uint64_t from = begin > 0 ? begin - 1 : 0;
+    uint64_t to = std::min<uint64_t>(file.size, end + overhang);
+    if (!window.map(file, from, to)) return false;
+
+    // The window's lines end with the first newline at or after end - 1
+    const char* eol = static_cast<const char*>(memchr(window.at(end - 1), '\n', to - (end - 1)));
+    if (eol)
+    {
+      last = eol + 1;
+    }
+    else if (to == file.size)
+    {
+      last = window.at(to);
+    }
+    else
+    {
+      overhang *= 4;
+      continue;
+    }
+
+    // and start after the first newline at or after begin - 1
+    first = window.at(from);
+    if (begin > 0)
+    {
+      eol = static_cast<const char*>(memchr(first, '\n', last - first));
+      first = eol ? eol + 1 : last;
+    }
+
+    return true;
+  }
+}
+
+// Runs work(index, first, last) on the lines of every window of the file,
+// spread over the hardware threads. Each thread maps one window at a time
+template <typename F>
+bool forEachWindow(const MappedFile& file, size_t window_bytes, size_t window_count, F work)
+{
+  std::atomic<size_t> next_window(0);
+  std::atomic<bool> mapped(true);
 
-    std::istringstream iss(line);
-    std::string type;
-    iss >> type;
+  auto worker = [&]()
+  {
+    FileWindow window;
+    const char* first;
+    const char* last;
 
-    if (type == "v") // Vertex
+    for (size_t i = next_window++; i < window_count && mapped; i = next_window++)
     {
-      float x, y, z;
-      if (iss >> x >> y >> z)
+      uint64_t begin = static_cast<uint64_t>(i) * window_bytes;
+      uint64_t end = std::min<uint64_t>(file.size, begin + window_bytes);
+
+      if (!mapWindowLines(file, window, begin, end, first, last))
       {
-        model_vertices.push_back({ x, y, z });
+        mapped = false;
+        break;
       }
+      work(i, first, last);
     }
-    else if (type == "f") // Face
+  };
+
+  size_t thread_count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), window_count);
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < thread_count; ++i)
+  {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : workers)
+  {
+    thread.join();
+  }
+
+  return mapped;
+}
+
+// Whitespace inside a line (the '\n' is handled by the line splitting)
+inline bool isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Parses one number starting at p (after any blanks), moving p past it
+template <typename T>
+bool parseNumber(const char*& p, const char* eol, T& value)
+{
+  while (p < eol && isBlank(*p)) ++p;
+  if (p < eol && *p == '+') ++p; // from_chars does not take a leading plus
+
+  auto result = std::from_chars(p, eol, value);
+  if (result.ec != std::errc()) return false;
+
+  p = result.ptr;
+  return true;
+}
+
+// Reads the x, y and z of a 'v' line
+inline bool parseVertex(const char* p, const char* eol, Point3D& v)
+{
+  return parseNumber(p, eol, v.x) && parseNumber(p, eol, v.y) && parseNumber(p, eol, v.z);
+}
+
+// Reads the vertex indices of an 'f' or 'l' line into indices, dropping any
+// /vt/vn parts. Negative indices count back from vertices_read, the number
+// of vertices defined before the line
+void parseIndices(const char* p, const char* eol, int vertices_read, std::vector<int>& indices)
+{
+  indices.clear();
+  int index;
+
+  while (parseNumber(p, eol, index))
+  {
+    // Skip the rest of the token (texture and normal indices)
+    while (p < eol && !isBlank(*p)) ++p;
+
+    // OBJ indices are 1-based, convert to 0-based
+    if (index > 0)
     {
-      std::vector<int> face_vertices;
-      std::string vertex_data;
+      indices.push_back(index - 1);
+    }
+    else if (index < 0)
+    {
+      indices.push_back(vertices_read + index);
+    }
+  }
+}
 
-      while (iss >> vertex_data)
-      {
-        // Handle different OBJ face formats (v, v/vt, v/vt/vn, v//vn)
-        std::size_t slash_pos = vertex_data.find('/');
-        std::string vertex_index_str = vertex_data.substr(0, slash_pos);
+// Calls record(type, args, eol) for every 'v', 'f' and 'l' line in [p, end),
+// which must start at the beginning of a line. Comments and others are skipped
+template <typename F>
+void forEachRecord(const char* p, const char* end, F record)
+{
+  while (p < end)
+  {
+    const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!eol) eol = end;
 
-        int vertex_index = std::stoi(vertex_index_str);
+    while (p < eol && isBlank(*p)) ++p;
 
-        // OBJ indices are 1-based, convert to 0-based
-        if (vertex_index > 0)
-        {
-          face_vertices.push_back(vertex_index - 1);
-        }
-        else if (vertex_index < 0)
-        {
-          // Negative indices count from end
-          face_vertices.push_back(model_vertices.size() + vertex_index);
-        }
-      }
+    if (eol - p >= 2 && isBlank(p[1]) && (p[0] == 'v' || p[0] == 'f' || p[0] == 'l'))
+    {
+      record(p[0], p + 1, eol);
+    }
+
+    p = eol + 1;
+  }
+}
 
-      if (face_vertices.size() >= 3)
+// What one window of the file holds. After the counting pass the counts are
+// summed front to back, which turns them into the place in the final arrays
+// where the window writes its output
+struct WindowCounts
+{
+  size_t vertices = 0;
+  size_t triangles = 0;     // Fan triangles of the faces
+  size_t line_edges = 0;    // Segments of the 'l' records
+};
+
+// First pass, counts the records in [p, end) without storing any
+void countWindow(const char* p, const char* end, WindowCounts& counts)
+{
+  std::vector<int> indices;
+  Point3D v;
+
+  forEachRecord(p, end, [&](char type, const char* q, const char* eol)
+  {
+    if (type == 'v')
+    {
+      if (parseVertex(q, eol, v)) counts.vertices++;
+      return;
+    }
+
+    parseIndices(q, eol, 0, indices);
+
+    // Faces need at least three vertices
+    if (type == 'f' && indices.size() >= 3) counts.triangles += indices.size() - 2;
+    if (type == 'l' && indices.size() >= 2) counts.line_edges += indices.size() - 1;
+  });
+}
+
+// Second pass, parses [p, end) straight into the final arrays starting at
+// the offsets in at. Faces are fan triangulated, edge_masks get a bit for
+// every triangle side that is a polygon edge (bit j is the side from corner j
+// to corner j + 1). Faces using a missing vertex leave triangles of -1 behind.
+// Without triangles the faces are skipped
+void fillWindow(const char* p, const char* end, const WindowCounts& at, int vertex_count,
+  Point3D* vertices, std::pair<int, int>* line_edges, int* triangles, uint8_t* edge_masks)
+{
+  std::vector<int> indices;
+  size_t vertex = at.vertices, triangle = at.triangles, line_edge = at.line_edges;
+  Point3D v;
+
+  forEachRecord(p, end, [&](char type, const char* q, const char* eol)
+  {
+    // A malformed vertex fails part way through, parsing straight into the
+    // array would write past its slot, which may belong to another window
+    if (type == 'v')
+    {
+      if (parseVertex(q, eol, v)) vertices[vertex++] = v;
+      return;
+    }
+
+    parseIndices(q, eol, static_cast<int>(vertex), indices);
+    int size = static_cast<int>(indices.size());
+
+    if (type == 'l')
+    {
+      // Create edges from consecutive vertices of the explicit lines
+      for (int i = 0; i + 1 < size; ++i)
       {
-        faces.push_back(face_vertices);
+        line_edges[line_edge++] = { indices[i], indices[i + 1] };
       }
+      return;
     }
-    else if (type == "l") // Line (some OBJ files have explicit line definitions)
+
+    if (size < 3) return;
+    if (!triangles)
     {
-      std::vector<int> line_vertices;
-      std::string vertex_data;
+      triangle += size - 2;
+      return;
+    }
 
-      while (iss >> vertex_data)
+    bool valid = std::all_of(indices.begin(), indices.end(), [&](int v) { return v >= 0 && v < vertex_count; });
+    for (int i = 1; i + 1 < size; ++i, ++triangle)
+    {
+      int* t = triangles + 3 * triangle;
+      t[0] = valid ? indices[0] : -1;
+      t[1] = valid ? indices[i] : -1;
+      t[2] = valid ? indices[i + 1] : -1;
+
+      // The middle side always is a polygon edge, the first and the last
+      // fan triangle also own the edges next to corner 0
+      edge_masks[triangle] = 2 | (i == 1 ? 1 : 0) | (i == size - 2 ? 4 : 0);
+    }
+  });
+}
+
+// Triangles, face normals and edge to face adjacency of a polygon mesh.
+// Edge i of the topology is model_edges[i]
+struct MeshTopology
+{
+  std::vector<int> triangles;          // Three vertex indices per triangle
+  std::vector<Point3D> face_normals;   // Unit normal of each triangle, zero if degenerate
+  std::vector<int> edge_face_offsets;  // Edge i has triangles edge_faces[offsets[i]..offsets[i + 1])
+  std::vector<int> edge_faces;
+};
+
+MeshTopology model_topology;
+
+// Collects the unique polygon edges of the triangles and the triangles around
+// each. Triangles of -1 are dropped first. Edges come out sorted by their
+// smaller and then their larger vertex, so walking them reads the vertex array
+// front to back
+void buildTopology(const std::vector<Point3D>& vertices, std::vector<uint8_t>& edge_masks,
+  MeshTopology& topology, std::vector<std::pair<int, int>>& edges)
+{
+  auto start_time = std::chrono::steady_clock::now();
+
+  std::vector<int>& triangles = topology.triangles;
+  size_t triangle_count = 0;
+  for (size_t t = 0; t < edge_masks.size(); ++t)
+  {
+    if (triangles[3 * t] < 0) continue;
+
+    std::copy_n(&triangles[3 * t], 3, &triangles[3 * triangle_count]);
+    edge_masks[triangle_count++] = edge_masks[t];
+  }
+  triangles.resize(3 * triangle_count);
+  edge_masks.resize(triangle_count);
+
+  // Normals follow the OBJ counter-clockwise winding
+  topology.face_normals.resize(triangle_count);
+  for (size_t t = 0; t < triangle_count; ++t)
+  {
+    const Point3D& a = vertices[triangles[3 * t]];
+    const Point3D& b = vertices[triangles[3 * t + 1]];
+    const Point3D& c = vertices[triangles[3 * t + 2]];
+
+    Point3D u = { b.x - a.x, b.y - a.y, b.z - a.z };
+    Point3D w = { c.x - a.x, c.y - a.y, c.z - a.z };
+    Point3D n = { u.y * w.z - u.z * w.y, u.z * w.x - u.x * w.z, u.x * w.y - u.y * w.x };
+
+    float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+    topology.face_normals[t] = length > 0 ? Point3D{ n.x / length, n.y / length, n.z / length } : Point3D{ 0, 0, 0 };
+  }
+
+  // Calls side(triangle, v1, v2) for every polygon edge, v1 < v2
+  auto forEachSide = [&](auto side)
+  {
+    for (size_t t = 0; t < triangle_count; ++t)
+    {
+      for (int j = 0; j < 3; ++j)
       {
-        int vertex_index = std::stoi(vertex_data);
-        if (vertex_index > 0)
-        {
-          line_vertices.push_back(vertex_index - 1);
-        }
-        else if (vertex_index < 0)
+        int v1 = triangles[3 * t + j];
+        int v2 = triangles[3 * t + (j + 1) % 3];
+        if (!(edge_masks[t] & (1 << j)) || v1 == v2) continue;
+
+        side(static_cast<int>(t), std::min(v1, v2), std::max(v1, v2));
+      }
+    }
+  };
+
+  // Radix sort with two digits: a counting sort into one bucket per smaller
+  // vertex, kept as parallel arrays of the larger vertex and the triangle
+  std::vector<size_t> starts(vertices.size() + 1, 0);
+  forEachSide([&](int, int v1, int) { starts[v1 + 1]++; });
+  for (size_t v = 1; v < starts.size(); ++v)
+  {
+    starts[v] += starts[v - 1];
+  }
+
+  std::vector<int> others(starts.back());
+  std::vector<int> faces(starts.back());
+  forEachSide([&](int t, int v1, int v2)
+  {
+    size_t slot = starts[v1]++;
+    others[slot] = v2;
+    faces[slot] = t;
+  });
+
+  // Filling moved every start to where the next bucket begins
+  for (size_t v = starts.size() - 1; v > 0; --v)
+  {
+    starts[v] = starts[v - 1];
+  }
+  starts[0] = 0;
+
+  // A bucket only holds the few edges around one vertex, finish it on the
+  // larger vertex by insertion sort, which keeps the triangles in order
+  std::vector<std::pair<int, int>> hub;
+  size_t edge_count = 0;
+  for (size_t v = 0; v + 1 < starts.size(); ++v)
+  {
+    size_t first = starts[v], last = starts[v + 1];
+
+    if (last - first > 32)
+    {
+      // Hub vertices get a real sort
+      hub.clear();
+      for (size_t i = first; i < last; ++i) hub.push_back({ others[i], faces[i] });
+      std::stable_sort(hub.begin(), hub.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+      for (size_t i = first; i < last; ++i) std::tie(others[i], faces[i]) = hub[i - first];
+    }
+    else
+    {
+      for (size_t i = first + 1; i < last; ++i)
+      {
+        int other = others[i], face = faces[i];
+        size_t k = i;
+        for (; k > first && other < others[k - 1]; --k)
         {
-          line_vertices.push_back(model_vertices.size() + vertex_index);
+          others[k] = others[k - 1];
+          faces[k] = faces[k - 1];
         }
+        others[k] = other;
+        faces[k] = face;
       }
+    }
+
+    for (size_t i = first; i < last; ++i)
+    {
+      if (i == first || others[i] != others[i - 1]) edge_count++;
+    }
+  }
 
-      // Create edges from consecutive vertices in the line
-      for (size_t i = 0; i < line_vertices.size() - 1; ++i)
+  // Every run of equal larger vertices is one edge, the bucket's triangles
+  // already are the adjacency lists
+  edges.resize(edge_count);
+  topology.edge_face_offsets.resize(edge_count + 1);
+  size_t edge = 0;
+  for (size_t v = 0; v + 1 < starts.size(); ++v)
+  {
+    for (size_t i = starts[v]; i < starts[v + 1]; ++i)
+    {
+      if (i == starts[v] || others[i] != others[i - 1])
       {
-        model_edges.push_back({ line_vertices[i], line_vertices[i + 1] });
+        edges[edge] = { static_cast<int>(v), others[i] };
+        topology.edge_face_offsets[edge++] = static_cast<int>(i);
       }
     }
   }
+  topology.edge_face_offsets[edge_count] = static_cast<int>(faces.size());
+  topology.edge_faces = std::move(faces);
 
-  file.close();
+  std::chrono::duration<double> build_time = std::chrono::steady_clock::now() - start_time;
+  std::cout << "Built topology: " << triangle_count << " triangles, " << edges.size() << " edges in "
+    << build_time.count() * 1000.0 << " ms" << std::endl;
+}
 
-  if (model_vertices.empty())
+// Function to load OBJ file and extract vertices and edges
+bool loadOBJ(const std::string& filename)
+{
+  auto start_time = std::chrono::steady_clock::now();
+
+  // Only the mapping is created, the passes below map a window at a time
+  MappedFile file;
+  if (!file.open(filename, false))
   {
-    std::cerr << "Error: No vertices found in OBJ file" << std::endl;
+    std::cerr << "Error: Could not open OBJ file: " << filename << std::endl;
+    return false;
+  }
+
+  model_vertices.clear();
+  model_edges.clear();
+  model_topology = {};
+
+  // Windows of 1 to 16 MB, one per thread unless the file is big
+  const size_t MIN_WINDOW_BYTES = 1 << 20;
+  const size_t MAX_WINDOW_BYTES = 16 << 20;
+  size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+  size_t window_bytes = std::clamp<size_t>(file.size / thread_count, MIN_WINDOW_BYTES, MAX_WINDOW_BYTES);
+  size_t window_count = (file.size + window_bytes - 1) / window_bytes;
+
+  // First pass counts the records of every window
+  std::vector<WindowCounts> counts(window_count);
+  bool mapped = forEachWindow(file, window_bytes, window_count, [&](size_t i, const char* first, const char* last)
+  {
+    countWindow(first, last, counts[i]);
+  });
+
+  // Summing up front to back turns the counts into each window's offsets
+  WindowCounts total;
+  for (auto& window : counts)
+  {
+    WindowCounts window_total = window;
+    window = total;
+    total.vertices += window_total.vertices;
+    total.triangles += window_total.triangles;
+    total.line_edges += window_total.line_edges;
+  }
+
+  if (!mapped || total.vertices > static_cast<size_t>(INT_MAX))
+  {
+    std::cerr << "Error: Could not read OBJ file: " << filename << std::endl;
     return false;
   }
 
-  // Generate edges from faces if no explicit lines were found
-  if (model_edges.empty())
+  // Faces only matter if there are no explicit lines
+  bool use_faces = total.line_edges == 0;
+  std::vector<uint8_t> edge_masks;
+
+  model_vertices.resize(total.vertices);
+  model_edges.resize(total.line_edges);
+  if (use_faces)
   {
-    std::set<std::pair<int, int>> edge_set; // Use set to avoid duplicate edges
+    model_topology.triangles.resize(3 * total.triangles);
+    edge_masks.resize(total.triangles);
+  }
 
-    for (const auto& face : faces)
-    {
-      // Create edges for each face (wireframe representation)
-      for (size_t i = 0; i < face.size(); ++i)
-      {
-        int v1 = face[i];
-        int v2 = face[(i + 1) % face.size()]; // Next vertex (wrapping around)
+  // Second pass parses every window into its part of the exactly sized arrays
+  int vertex_count = static_cast<int>(total.vertices);
+  mapped = forEachWindow(file, window_bytes, window_count, [&](size_t i, const char* first, const char* last)
+  {
+    fillWindow(first, last, counts[i], vertex_count, model_vertices.data(), model_edges.data(),
+      use_faces ? model_topology.triangles.data() : nullptr, edge_masks.data());
+  });
 
-        // Ensure consistent edge ordering (smaller index first)
-        if (v1 > v2) std::swap(v1, v2);
-        edge_set.insert({ v1, v2 });
-      }
-    }
+  if (!mapped)
+  {
+    std::cerr << "Error: Could not read OBJ file: " << filename << std::endl;
+    return false;
+  }
 
-    // Convert set to vector
-    model_edges.assign(edge_set.begin(), edge_set.end());
+  std::chrono::duration<double> parse_time = std::chrono::steady_clock::now() - start_time;
+  double megabytes = file.size / (1024.0 * 1024.0);
+  std::cout << "Parsed " << megabytes << " MB in " << parse_time.count() * 1000.0 << " ms ("
+    << (parse_time.count() > 0 ? megabytes / parse_time.count() : 0.0) << " MB/s, "
+    << window_count << " windows)" << std::endl;
+
+  if (model_vertices.empty())
+  {
+    std::cerr << "Error: No vertices found in OBJ file" << std::endl;
+    return false;
   }
 
   // Normalize model to fit within reasonable bounds
@@ -211,56 +705,592 @@ bool loadOBJ(const std::string& filename)
     }
   }
 
+  // Generate edges from faces if no explicit lines were found, together with
+  // the normals and adjacency the renderer uses for culling
+  if (use_faces)
+  {
+    buildTopology(model_vertices, edge_masks, model_topology, model_edges);
+  }
+
   std::cout << "Loaded OBJ file: " << model_vertices.size() << " vertices, "
     << model_edges.size() << " edges" << std::endl;
 
   return true;
 }
 
-// Projects a 3D point onto the 2D "screen" using perspective projection
-Point2D project(const Point3D& p)
+// Where one array of the mesh cache starts and how many elements it holds
+struct MeshCacheSection
 {
-  // Calculate aspect ratio for proper scaling
-  float aspect = static_cast<float>(WIDTH) / HEIGHT;
+  uint64_t offset;
+  uint64_t count;
+};
 
-  // Calculate scale factor based on field of view (convert FOV to radians)
-  float fovScale = 1.0f / tan(FOV * 0.5f * 3.14 / 180);
+// Header of the binary mesh cache written next to an OBJ file. The normalized
+// vertices, the edge list and the topology follow in the given sections, so
+// a mapped cache can be drawn without copying anything
+struct MeshCacheHeader
+{
+  char magic[4];          // "OBJC"
+  uint32_t version;
+  uint64_t source_size;   // Size, write time and sampled hash of the OBJ it was built from
+  uint64_t source_time;
+  uint64_t source_hash;
+  MeshCacheSection vertices;
+  MeshCacheSection edges;
+  MeshCacheSection triangles;          // Counted in triangles, three ints each
+  MeshCacheSection face_normals;
+  MeshCacheSection edge_face_offsets;  // Empty when the edges came from 'l' records
+  MeshCacheSection edge_faces;
+};
+
+const uint32_t MESH_CACHE_VERSION = 2;
+
+// Name of the cache belonging to an OBJ file
+std::string meshCachePath(const std::string& filename)
+{
+  return filename + ".cache";
+}
+
+// FNV-1a over the start, middle and end of the file. Together with the size
+// and write time this catches edits without reading a huge model in full
+uint64_t sampleHash(const MappedFile& file)
+{
+  const size_t SAMPLE = 64 * 1024;
+  uint64_t hash = 14695981039346656037ull;
+
+  auto mix = [&](size_t offset, size_t length)
+  {
+    for (size_t i = offset; i < offset + length; ++i)
+    {
+      hash = (hash ^ static_cast<unsigned char>(file.data[i])) * 1099511628211ull;
+    }
+  };
+
+  if (file.size <= 3 * SAMPLE)
+  {
+    mix(0, file.size);
+  }
+  else
+  {
+    mix(0, SAMPLE);
+    mix(file.size / 2 - SAMPLE / 2, SAMPLE);
+    mix(file.size - SAMPLE, SAMPLE);
+  }
+
+  return hash;
+}
+
+// Mapping of the cache in use, it backs model while the program runs
+MappedFile model_cache;
+
+// Whether every index in a mapped cache stays inside the arrays it refers
+// to, the renderer reads them unchecked
+bool validMeshCache(const MeshView& mesh, const MeshCacheHeader& header)
+{
+  if (header.face_normals.count != mesh.triangle_count) return false;
+  if (header.edge_face_offsets.count != 0 && header.edge_face_offsets.count != mesh.edge_count + 1) return false;
+
+  for (size_t i = 0; i < mesh.edge_count; ++i)
+  {
+    const auto& e = mesh.edges[i];
+    if (e.first < 0 || e.second < 0 || static_cast<size_t>(e.first) >= mesh.vertex_count || static_cast<size_t>(e.second) >= mesh.vertex_count) return false;
+  }
+
+  for (size_t i = 0; i < 3 * mesh.triangle_count; ++i)
+  {
+    if (mesh.triangles[i] < 0 || static_cast<size_t>(mesh.triangles[i]) >= mesh.vertex_count) return false;
+  }
+
+  if (!mesh.edge_face_offsets) return true;
+
+  // Offsets rise from 0 to the end of edge_faces, every face exists
+  if (mesh.edge_face_offsets[0] != 0 || static_cast<uint64_t>(mesh.edge_face_offsets[mesh.edge_count]) != header.edge_faces.count) return false;
+  for (size_t i = 0; i < mesh.edge_count; ++i)
+  {
+    if (mesh.edge_face_offsets[i + 1] < mesh.edge_face_offsets[i]) return false;
+  }
+
+  for (size_t i = 0; i < header.edge_faces.count; ++i)
+  {
+    if (mesh.edge_faces[i] < 0 || static_cast<size_t>(mesh.edge_faces[i]) >= mesh.triangle_count) return false;
+  }
+
+  return true;
+}
+
+// Points model at the cache of filename if it exists and still matches the OBJ
+bool loadMeshCache(const std::string& filename)
+{
+  auto start_time = std::chrono::steady_clock::now();
+
+  MappedFile source;
+  if (!source.open(filename)) return false;
+
+  if (!model_cache.open(meshCachePath(filename)) || model_cache.size < sizeof(MeshCacheHeader))
+  {
+    model_cache.close();
+    return false;
+  }
+
+  MeshCacheHeader header;
+  memcpy(&header, model_cache.data, sizeof(header));
 
-  // Apply perspective by adding camera distance to z
-  float z = p.z + CAMERA_DISTANCE;
+  // Sections have to lie inside the file, a cache cut short by a crash while
+  // writing it is no good
+  auto fits = [&](const MeshCacheSection& section, size_t element_size)
+  {
+    return section.offset <= model_cache.size && section.count <= (model_cache.size - section.offset) / element_size;
+  };
+
+  // Stale or foreign caches are ignored and rewritten after the OBJ is parsed
+  if (memcmp(header.magic, "OBJC", 4) != 0 || header.version != MESH_CACHE_VERSION ||
+    header.source_size != source.size || header.source_time != source.writeTime() ||
+    header.source_hash != sampleHash(source) || header.vertices.count == 0 ||
+    !fits(header.vertices, sizeof(Point3D)) || !fits(header.edges, sizeof(std::pair<int, int>)) ||
+    !fits(header.triangles, 3 * sizeof(int)) || !fits(header.face_normals, sizeof(Point3D)) ||
+    !fits(header.edge_face_offsets, sizeof(int)) || !fits(header.edge_faces, sizeof(int)))
+  {
+    // Let go of the file so that it can be overwritten
+    model_cache.close();
+    return false;
+  }
+
+  auto section = [&](const MeshCacheSection& section) { return model_cache.data + section.offset; };
+
+  MeshView cache;
+  cache.vertices = reinterpret_cast<const Point3D*>(section(header.vertices));
+  cache.vertex_count = header.vertices.count;
+  cache.edges = reinterpret_cast<const std::pair<int, int>*>(section(header.edges));
+  cache.edge_count = header.edges.count;
+  cache.triangles = reinterpret_cast<const int*>(section(header.triangles));
+  cache.triangle_count = header.triangles.count;
+  cache.face_normals = reinterpret_cast<const Point3D*>(section(header.face_normals));
+  cache.edge_face_offsets = header.edge_face_offsets.count ? reinterpret_cast<const int*>(section(header.edge_face_offsets)) : nullptr;
+  cache.edge_faces = reinterpret_cast<const int*>(section(header.edge_faces));
+
+  // A cache whose indices do not fit its own arrays is corrupt, the OBJ is
+  // parsed again and model keeps pointing at the vectors
+  if (!validMeshCache(cache, header))
+  {
+    model_cache.close();
+    return false;
+  }
+
+  model = cache;
 
-  // Perspective divide and scaling
-  float scale = fovScale / z * MODEL_SIZE;
+  std::chrono::duration<double> load_time = std::chrono::steady_clock::now() - start_time;
+  std::cout << "Loaded mesh cache: " << model.vertex_count << " vertices, " << model.edge_count
+    << " edges in " << load_time.count() * 1000.0 << " ms" << std::endl;
+
+  return true;
+}
+
+// Writes model_vertices, model_edges and model_topology as the cache of filename
+bool saveMeshCache(const std::string& filename)
+{
+  MappedFile source;
+  if (!source.open(filename)) return false;
+
+  MeshCacheHeader header = {};
+  memcpy(header.magic, "OBJC", 4);
+  header.version = MESH_CACHE_VERSION;
+  header.source_size = source.size;
+  header.source_time = source.writeTime();
+  header.source_hash = sampleHash(source);
+
+  // Sections start on 16 byte boundaries, in the order they are listed here
+  struct Block
+  {
+    MeshCacheSection& section;
+    const void* data;
+    size_t count;
+    size_t element_size;
+  };
+
+  Block blocks[] =
+  {
+    { header.vertices, model_vertices.data(), model_vertices.size(), sizeof(Point3D) },
+    { header.edges, model_edges.data(), model_edges.size(), sizeof(std::pair<int, int>) },
+    { header.triangles, model_topology.triangles.data(), model_topology.triangles.size() / 3, 3 * sizeof(int) },
+    { header.face_normals, model_topology.face_normals.data(), model_topology.face_normals.size(), sizeof(Point3D) },
+    { header.edge_face_offsets, model_topology.edge_face_offsets.data(), model_topology.edge_face_offsets.size(), sizeof(int) },
+    { header.edge_faces, model_topology.edge_faces.data(), model_topology.edge_faces.size(), sizeof(int) },
+  };
+
+  uint64_t offset = sizeof(header);
+  for (auto& block : blocks)
+  {
+    block.section.offset = (offset + 15) & ~uint64_t(15);
+    block.section.count = block.count;
+    offset = block.section.offset + block.count * block.element_size;
+  }
+
+  std::ofstream file(meshCachePath(filename), std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) return false;
+
+  const char padding[16] = {};
+  offset = sizeof(header);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (const auto& block : blocks)
+  {
+    file.write(padding, block.section.offset - offset);
+    file.write(static_cast<const char*>(block.data), block.count * block.element_size);
+    offset = block.section.offset + block.count * block.element_size;
+  }
+
+  return file.good();
+}
+
+// Points model at model_vertices, model_edges and model_topology
+void useModelVectors()
+{
+  model.vertices = model_vertices.data();
+  model.vertex_count = model_vertices.size();
+  model.edges = model_edges.data();
+  model.edge_count = model_edges.size();
+  model.triangles = model_topology.triangles.data();
+  model.triangle_count = model_topology.triangles.size() / 3;
+  model.face_normals = model_topology.face_normals.data();
+  model.edge_face_offsets = model_topology.edge_face_offsets.empty() ? nullptr : model_topology.edge_face_offsets.data();
+  model.edge_faces = model_topology.edge_faces.data();
+}
+
+// Rotation around the X axis by angleX followed by one around the Y axis by
+// angleY, as a single matrix so sin and cos are taken once per frame
+struct Rotation
+{
+  float m[3][3];
+};
+
+Rotation rotationXY(float angleX, float angleY)
+{
+  float sa = sin(angleX), ca = cos(angleX);
+  float sb = sin(angleY), cb = cos(angleY);
 
-  // Convert 3D coordinates to 2D screen coordinates
   return
+  {{
+      { cb, sa * sb, ca * sb },
+      { 0, ca, -sa },
+      { -sb, sa * cb, ca * cb }
+  }};
+}
+
+// Model vertices as separate x, y and z arrays, padded with zeros to a
+// multiple of 8 so the SIMD loops below need no scalar tail
+struct VertexArrays
+{
+  std::vector<float> x, y, z;
+  size_t count = 0;
+
+  void assign(const Point3D* vertices, size_t n)
   {
-      static_cast<int>(WIDTH / 2 + p.x * scale * aspect), // X: center + scaled position
-      static_cast<int>(HEIGHT / 2 - p.y * scale),         // Y: center - scaled position (Y axis inverted)
-      z                                                   // Store depth for shading
+    size_t padded = (n + 7) & ~size_t(7);
+    x.assign(padded, 0.0f);
+    y.assign(padded, 0.0f);
+    z.assign(padded, 0.0f);
+    count = n;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+      x[i] = vertices[i].x;
+      y[i] = vertices[i].y;
+      z[i] = vertices[i].z;
+    }
+  }
+};
+
+// Screen positions and depths of the transformed vertices. The arrays are
+// kept from frame to frame and only ever grow
+struct ScreenPoints
+{
+  std::vector<int> x, y;
+  std::vector<float> depth;
+
+  Point2D operator[](size_t i) const
+  {
+    return { x[i], y[i], depth[i] };
+  }
+};
+
+// Rotates every vertex, projects it with perspective and converts it to
+// integer screen coordinates in a single pass, 8 or 4 vertices at a time
+void transformVertices(const VertexArrays& in, const Rotation& r, ScreenPoints& out)
+{
+  size_t n = in.x.size();
+  if (out.x.size() < n)
+  {
+    out.x.resize(n);
+    out.y.resize(n);
+    out.depth.resize(n);
+  }
+
+  // Projection constants: aspect ratio, field of view scale and screen centre
+  const float aspect = static_cast<float>(WIDTH) / HEIGHT;
+  const float fovScale = 1.0f / tan(FOV * 0.5f * 3.14 / 180);
+  const float centerX = WIDTH / 2, centerY = HEIGHT / 2;
+
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  __m256 m00 = _mm256_set1_ps(r.m[0][0]), m01 = _mm256_set1_ps(r.m[0][1]), m02 = _mm256_set1_ps(r.m[0][2]);
+  __m256 m10 = _mm256_set1_ps(r.m[1][0]), m11 = _mm256_set1_ps(r.m[1][1]), m12 = _mm256_set1_ps(r.m[1][2]);
+  __m256 m20 = _mm256_set1_ps(r.m[2][0]), m21 = _mm256_set1_ps(r.m[2][1]), m22 = _mm256_set1_ps(r.m[2][2]);
+  __m256 camera = _mm256_set1_ps(CAMERA_DISTANCE), fov = _mm256_set1_ps(fovScale), size = _mm256_set1_ps(MODEL_SIZE);
+  __m256 cx = _mm256_set1_ps(centerX), cy = _mm256_set1_ps(centerY), ax = _mm256_set1_ps(aspect);
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256 x = _mm256_loadu_ps(&in.x[i]), y = _mm256_loadu_ps(&in.y[i]), z = _mm256_loadu_ps(&in.z[i]);
+
+    __m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m00), _mm256_mul_ps(y, m01)), _mm256_mul_ps(z, m02));
+    __m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m10), _mm256_mul_ps(y, m11)), _mm256_mul_ps(z, m12));
+    __m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m20), _mm256_mul_ps(y, m21)), _mm256_mul_ps(z, m22));
+
+    // Perspective divide, then centre on the screen with the Y axis inverted
+    __m256 depth = _mm256_add_ps(rz, camera);
+    __m256 scale = _mm256_mul_ps(_mm256_div_ps(fov, depth), size);
+    __m256 sx = _mm256_add_ps(cx, _mm256_mul_ps(_mm256_mul_ps(rx, scale), ax));
+    __m256 sy = _mm256_sub_ps(cy, _mm256_mul_ps(ry, scale));
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.x[i]), _mm256_cvttps_epi32(sx));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.y[i]), _mm256_cvttps_epi32(sy));
+    _mm256_storeu_ps(&out.depth[i], depth);
+  }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  __m128 m00 = _mm_set1_ps(r.m[0][0]), m01 = _mm_set1_ps(r.m[0][1]), m02 = _mm_set1_ps(r.m[0][2]);
+  __m128 m10 = _mm_set1_ps(r.m[1][0]), m11 = _mm_set1_ps(r.m[1][1]), m12 = _mm_set1_ps(r.m[1][2]);
+  __m128 m20 = _mm_set1_ps(r.m[2][0]), m21 = _mm_set1_ps(r.m[2][1]), m22 = _mm_set1_ps(r.m[2][2]);
+  __m128 camera = _mm_set1_ps(CAMERA_DISTANCE), fov = _mm_set1_ps(fovScale), size = _mm_set1_ps(MODEL_SIZE);
+  __m128 cx = _mm_set1_ps(centerX), cy = _mm_set1_ps(centerY), ax = _mm_set1_ps(aspect);
+
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(&in.x[i]), y = _mm_loadu_ps(&in.y[i]), z = _mm_loadu_ps(&in.z[i]);
+
+    __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m01)), _mm_mul_ps(z, m02));
+    __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m10), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m12));
+    __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m20), _mm_mul_ps(y, m21)), _mm_mul_ps(z, m22));
+
+    // Perspective divide, then centre on the screen with the Y axis inverted
+    __m128 depth = _mm_add_ps(rz, camera);
+    __m128 scale = _mm_mul_ps(_mm_div_ps(fov, depth), size);
+    __m128 sx = _mm_add_ps(cx, _mm_mul_ps(_mm_mul_ps(rx, scale), ax));
+    __m128 sy = _mm_sub_ps(cy, _mm_mul_ps(ry, scale));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.x[i]), _mm_cvttps_epi32(sx));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.y[i]), _mm_cvttps_epi32(sy));
+    _mm_storeu_ps(&out.depth[i], depth);
+  }
+#endif
+
+  // Same math one vertex at a time, for builds without SIMD
+  for (; i < n; ++i)
+  {
+    float x = in.x[i], y = in.y[i], z = in.z[i];
+    float rx = x * r.m[0][0] + y * r.m[0][1] + z * r.m[0][2];
+    float ry = x * r.m[1][0] + y * r.m[1][1] + z * r.m[1][2];
+    float rz = x * r.m[2][0] + y * r.m[2][1] + z * r.m[2][2];
+
+    float depth = rz + CAMERA_DISTANCE;
+    float scale = fovScale / depth * MODEL_SIZE;
+    out.x[i] = static_cast<int>(centerX + rx * scale * aspect);
+    out.y[i] = static_cast<int>(centerY - ry * scale);
+    out.depth[i] = depth;
+  }
+}
+
+// Camera space position of vertex i, with the depth in z
+Point3D toCamera(const VertexArrays& in, const Rotation& r, size_t i)
+{
+  float x = in.x[i], y = in.y[i], z = in.z[i];
+  return
+  {
+      x * r.m[0][0] + y * r.m[0][1] + z * r.m[0][2],
+      x * r.m[1][0] + y * r.m[1][1] + z * r.m[1][2],
+      x * r.m[2][0] + y * r.m[2][1] + z * r.m[2][2] + CAMERA_DISTANCE
   };
 }
 
-// Rotates a point around the X axis by angle a (in radians)
-void rotateX(Point3D& p, float a)
+// Projects a camera space point the way transformVertices does
+Point2D projectCamera(const Point3D& p)
 {
-  float y = p.y * cos(a) - p.z * sin(a);
-  float z = p.y * sin(a) + p.z * cos(a);
-  p.y = y;
-  p.z = z;
+  float aspect = static_cast<float>(WIDTH) / HEIGHT;
+  float fovScale = 1.0f / tan(FOV * 0.5f * 3.14 / 180);
+  float scale = fovScale / p.z * MODEL_SIZE;
+
+  return { static_cast<int>(WIDTH / 2 + p.x * scale * aspect), static_cast<int>(HEIGHT / 2 - p.y * scale), p.z };
+}
+
+// Whether every edge has a face on both sides. Only then the back of a face
+// can never be seen and back-facing faces may be culled
+bool isClosedMesh(const MeshView& mesh)
+{
+  if (!mesh.edge_face_offsets) return false;
+
+  for (size_t i = 0; i < mesh.edge_count; ++i)
+  {
+    if (mesh.edge_face_offsets[i + 1] - mesh.edge_face_offsets[i] < 2) return false;
+  }
+  return true;
+}
+
+// Marks the triangles facing the camera. The camera sits at depth 0 on the
+// view axis, which in model space is CAMERA_DISTANCE back along the third row
+// of the rotation. Degenerate triangles count as facing it
+void markFrontFaces(const MeshView& mesh, const Rotation& r, std::vector<uint8_t>& front)
+{
+  Point3D camera = { -CAMERA_DISTANCE * r.m[2][0], -CAMERA_DISTANCE * r.m[2][1], -CAMERA_DISTANCE * r.m[2][2] };
+
+  front.resize(mesh.triangle_count);
+  for (size_t t = 0; t < mesh.triangle_count; ++t)
+  {
+    const Point3D& a = mesh.vertices[mesh.triangles[3 * t]];
+    const Point3D& n = mesh.face_normals[t];
+    front[t] = n.x * (a.x - camera.x) + n.y * (a.y - camera.y) + n.z * (a.z - camera.z) <= 0;
+  }
 }
 
-// Rotates a point around the Y axis by angle a (in radians)
-void rotateY(Point3D& p, float a)
+// An edge is seen if one of its faces is, which keeps the silhouette where a
+// front face meets a back face
+bool edgeFacesCamera(const MeshView& mesh, const std::vector<uint8_t>& front, size_t edge)
 {
-  float x = p.x * cos(a) + p.z * sin(a);
-  float z = -p.x * sin(a) + p.z * cos(a);
-  p.x = x;
-  p.z = z;
+  for (int i = mesh.edge_face_offsets[edge]; i < mesh.edge_face_offsets[edge + 1]; ++i)
+  {
+    if (front[mesh.edge_faces[i]]) return true;
+  }
+  return false;
 }
 
-// Draws a line between two 2D points using Bresenham's algorithm, with depth-based shading
-void drawLine(std::vector<std::vector<char>>& screen,
+// Writes the nearest triangle of every cell into the depth buffer, which holds
+// 1/depth (0 is infinitely far) because that is linear across the screen.
+// Cells are sampled at their corner, where the projected vertices lie, and
+// edges count as inside so neighbouring triangles leave no gaps. Without a
+// front list every triangle is drawn
+void rasterizeDepth(const MeshView& mesh, const ScreenPoints& projected, const std::vector<uint8_t>* front,
+  std::vector<float>& depth_buffer)
+{
+  for (size_t t = 0; t < mesh.triangle_count; ++t)
+  {
+    if (front && !(*front)[t]) continue;
+
+    Point2D a = projected[mesh.triangles[3 * t]];
+    Point2D b = projected[mesh.triangles[3 * t + 1]];
+    Point2D c = projected[mesh.triangles[3 * t + 2]];
+
+    // Triangles reaching behind the near plane are left out, they hide nothing
+    if (a.depth < NEAR_PLANE || b.depth < NEAR_PLANE || c.depth < NEAR_PLANE) continue;
+
+    int min_x = std::max(std::min({ a.x, b.x, c.x }), 0), max_x = std::min(std::max({ a.x, b.x, c.x }), WIDTH - 1);
+    int min_y = std::max(std::min({ a.y, b.y, c.y }), 0), max_y = std::min(std::max({ a.y, b.y, c.y }), HEIGHT - 1);
+    if (min_x > max_x || min_y > max_y) continue;
+
+    auto edge = [](const Point2D& p, const Point2D& q, int x, int y)
+    {
+      return static_cast<int64_t>(q.x - p.x) * (y - p.y) - static_cast<int64_t>(q.y - p.y) * (x - p.x);
+    };
+
+    // Both windings are drawn, the edge functions are made positive inside
+    int64_t area = edge(a, b, c.x, c.y);
+    if (area == 0) continue;
+    if (area < 0)
+    {
+      std::swap(b, c);
+      area = -area;
+    }
+
+    float inv_a = 1.0f / a.depth, inv_b = 1.0f / b.depth, inv_c = 1.0f / c.depth;
+
+    for (int y = min_y; y <= max_y; ++y)
+    {
+      for (int x = min_x; x <= max_x; ++x)
+      {
+        int64_t wa = edge(b, c, x, y), wb = edge(c, a, x, y), wc = edge(a, b, x, y);
+        if (wa < 0 || wb < 0 || wc < 0) continue;
+
+        float inv = (wa * inv_a + wb * inv_b + wc * inv_c) / area;
+        float& nearest = depth_buffer[y * WIDTH + x];
+        nearest = std::max(nearest, inv);
+      }
+    }
+  }
+}
+
+// Cuts the edge between vertices i1 and i2 at the near plane and at the screen
+// border. Returns false if nothing of it is left
+bool clipEdge(const VertexArrays& vertices, const Rotation& r, const ScreenPoints& projected, int i1, int i2,
+  Point2D& p1, Point2D& p2)
+{
+  p1 = projected[i1];
+  p2 = projected[i2];
+
+  // Most edges are in front of the camera and on screen already
+  auto onScreen = [](const Point2D& p)
+  {
+    return p.depth >= NEAR_PLANE && p.x >= 0 && p.x < WIDTH && p.y >= 0 && p.y < HEIGHT;
+  };
+  if (onScreen(p1) && onScreen(p2)) return true;
+
+  if (p1.depth < NEAR_PLANE && p2.depth < NEAR_PLANE) return false;
+
+  // Projection breaks down behind the camera, so this cut is made before it
+  if (p1.depth < NEAR_PLANE || p2.depth < NEAR_PLANE)
+  {
+    Point3D a = toCamera(vertices, r, i1), b = toCamera(vertices, r, i2);
+    Point3D& behind = a.z < NEAR_PLANE ? a : b;
+
+    float t = (NEAR_PLANE - a.z) / (b.z - a.z);
+    behind = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, NEAR_PLANE };
+
+    p1 = projectCamera(a);
+    p2 = projectCamera(b);
+  }
+
+  // Liang-Barsky against the screen, keeping the part of the edge with
+  // parameter t0 to t1
+  float x1 = static_cast<float>(p1.x), y1 = static_cast<float>(p1.y);
+  float dx = static_cast<float>(p2.x - p1.x), dy = static_cast<float>(p2.y - p1.y);
+  float t0 = 0.0f, t1 = 1.0f;
+
+  auto inside = [&](float p, float q)
+  {
+    if (p == 0) return q >= 0;
+
+    float t = q / p;
+    if (p < 0)
+    {
+      if (t > t1) return false;
+      t0 = std::max(t0, t);
+    }
+    else
+    {
+      if (t < t0) return false;
+      t1 = std::min(t1, t);
+    }
+    return true;
+  };
+
+  if (!inside(-dx, x1) || !inside(dx, WIDTH - 1 - x1) || !inside(-dy, y1) || !inside(dy, HEIGHT - 1 - y1)) return false;
+
+  // 1/depth is linear along the edge on screen
+  float inv1 = 1.0f / p1.depth, inv2 = 1.0f / p2.depth;
+  Point2D q1 = p1, q2 = p2;
+  if (t0 > 0)
+  {
+    q1 = { static_cast<int>(std::lround(x1 + dx * t0)), static_cast<int>(std::lround(y1 + dy * t0)), 1.0f / (inv1 + (inv2 - inv1) * t0) };
+  }
+  if (t1 < 1)
+  {
+    q2 = { static_cast<int>(std::lround(x1 + dx * t1)), static_cast<int>(std::lround(y1 + dy * t1)), 1.0f / (inv1 + (inv2 - inv1) * t1) };
+  }
+
+  p1 = q1;
+  p2 = q2;
+  return true;
+}
+
+// Draws a line between two 2D points using Bresenham's algorithm, with depth-based shading.
+// A cell takes the line if the line is the nearest thing in it so far, going by the depth buffer
+void drawLine(std::vector<std::vector<char>>& screen, std::vector<float>& depth_buffer,
   const Point2D& p1, const Point2D& p2)
 {
   // Calculate average depth for the line to determine shading
@@ -277,16 +1307,25 @@ void drawLine(std::vector<std::vector<char>>& screen,
   int err = dx + dy, e2;
   int x = p1.x, y = p1.y;
 
+  // 1/depth is stepped along the line, one step per cell
+  int steps = std::max(dx, -dy);
+  float inv = 1.0f / p1.depth;
+  float inv_step = steps > 0 ? (1.0f / p2.depth - inv) / steps : 0.0f;
+
   // Bresenham's line drawing loop
   while (true)
   {
     // Draw pixel if within screen bounds
     if (x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT)
     {
-      // Only draw if cell is empty or new shade is darker (higher index)
-      if (screen[y][x] == ' ' || SHADES[shadeIdx] > screen[y][x])
+      float& nearest = depth_buffer[y * WIDTH + x];
+
+      // Only draw if nothing nearer is in the cell, a surface the line lies on
+      // is beaten through the bias
+      if (inv * (1.0f + DEPTH_BIAS) >= nearest)
       {
         screen[y][x] = c;
+        nearest = std::max(nearest, inv);
       }
     }
 
@@ -305,6 +1344,7 @@ void drawLine(std::vector<std::vector<char>>& screen,
       err += dx;
       y += sy;
     }
+    inv += inv_step;
   }
 }
 
@@ -329,6 +1369,7 @@ int main(int argc, char* argv[])
   // Set default model data (cube)
   model_vertices = cube_vertices;
   model_edges = cube_edges;
+  useModelVectors();
 
   // Check if OBJ file was provided as command line argument
   if (argc > 1)
@@ -336,10 +1377,25 @@ int main(int argc, char* argv[])
     std::string objFile = argv[1];
     std::cout << "Attempting to load OBJ file: " << objFile << std::endl;
 
-    if (!loadOBJ(objFile))
+    // A valid cache skips parsing altogether, otherwise one is written for next time
+    if (loadMeshCache(objFile))
+    {
+      // model already points into the mapped cache
+    }
+    else if (loadOBJ(objFile))
+    {
+      if (!saveMeshCache(objFile))
+      {
+        std::cout << "Could not write mesh cache " << meshCachePath(objFile) << std::endl;
+      }
+      useModelVectors();
+    }
+    else
     {
       std::cout << "Failed to load OBJ file, using default cube" << std::endl;
-      // Keep default cube data
+      model_vertices = cube_vertices;
+      model_edges = cube_edges;
+      useModelVectors();
     }
   }
   else
@@ -354,6 +1410,18 @@ int main(int argc, char* argv[])
   // Initialize rotation angles
   float angleX = 0, angleY = 0;
 
+  // Vertices split into SIMD friendly arrays once, and the screen positions
+  // they are transformed into every frame
+  VertexArrays vertices;
+  vertices.assign(model.vertices, model.vertex_count);
+  ScreenPoints projected;
+
+  // 1/depth of the nearest surface or edge in each cell, and the triangles
+  // facing the camera. Back faces are only culled on closed meshes
+  std::vector<float> depth_buffer(WIDTH * HEIGHT);
+  std::vector<uint8_t> front;
+  bool closed = isClosedMesh(model);
+
   // Pre-allocate buffer for screen output to minimize allocations
   std::string buffer;
   buffer.reserve((WIDTH + 1) * HEIGHT + 10);
@@ -368,29 +1436,30 @@ int main(int argc, char* argv[])
     // Initialize the screen as a 2D array filled with spaces
     std::vector<std::vector<char>> screen(HEIGHT, std::vector<char>(WIDTH, ' '));
 
-    // Copy model vertices for rotation
-    std::vector<Point3D> rotated = model_vertices;
+    // Rotate, project and convert all vertices to screen coordinates
+    Rotation rotation = rotationXY(angleX, angleY);
+    transformVertices(vertices, rotation, projected);
 
-    // Rotate all vertices around X and Y axes
-    for (auto& v : rotated)
+    // Fill the depth buffer with the surfaces so they hide the edges behind them
+    std::fill(depth_buffer.begin(), depth_buffer.end(), 0.0f);
+    if (model.edge_face_offsets)
     {
-      rotateX(v, angleX);
-      rotateY(v, angleY);
+      if (closed) markFrontFaces(model, rotation, front);
+      rasterizeDepth(model, projected, closed ? &front : nullptr, depth_buffer);
     }
 
-    // Project all rotated 3D points to 2D screen coordinates
-    std::vector<Point2D> projected;
-    for (const auto& v : rotated)
+    // Draw all model edges onto the screen buffer, skipping those only back
+    // faces touch and cutting the rest to what is in front of the camera
+    for (size_t i = 0; i < model.edge_count; ++i)
     {
-      projected.push_back(project(v));
-    }
+      const auto& e = model.edges[i];
+      if (static_cast<size_t>(e.first) >= vertices.count || static_cast<size_t>(e.second) >= vertices.count) continue;
+      if (closed && !edgeFacesCamera(model, front, i)) continue;
 
-    // Draw all model edges onto the screen buffer
-    for (const auto& e : model_edges)
-    {
-      if (e.first < projected.size() && e.second < projected.size())
+      Point2D p1, p2;
+      if (clipEdge(vertices, rotation, projected, e.first, e.second, p1, p2))
       {
-        drawLine(screen, projected[e.first], projected[e.second]);
+        drawLine(screen, depth_buffer, p1, p2);
       }
     }
 
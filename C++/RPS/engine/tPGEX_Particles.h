@@ -0,0 +1,365 @@
+/*
+  tPGEX_Particles.h - particle system extension for tPixelGameEngine
+
+  Particles are kept as a structure of arrays of floats so the update can
+  move four of them at once and split the work between threads. Dead
+  particles are removed by swapping the last one into their slot, so the
+  order of particles is not stable. Drawing writes straight into the
+  current draw target, either one pixel per particle or a sprite tinted
+  with the particle colour, blended by alpha or added on top.
+
+  Include it after tPixelGameEngine.h and, in the same single file that
+  defines T_PGE_APPLICATION, define T_PGEX_PARTICLES before including it.
+
+  #define T_PGE_APPLICATION
+  #include "tPixelGameEngine.h"
+  #define T_PGEX_PARTICLES
+  #include "tPGEX_Particles.h"
+*/
+
+#ifndef T_PGEX_PARTICLES_DEF
+#define T_PGEX_PARTICLES_DEF
+
+namespace tDX
+{
+  class ParticleSystem : public tDX::PGEX
+  {
+  public:
+    enum class Blend { ALPHA, ADDITIVE };
+
+  public:
+    ParticleSystem(size_t nReserve = 0);
+
+  public:
+    // Adds a particle living for fLife seconds, it fades out as it ages
+    void Emit(float x, float y, float vx, float vy, float fLife, Pixel col);
+    // Moves and ages every particle, then drops the dead ones. The work is split
+    // into nThreads parts run on the engine's thread pool, 0 picks the hardware count
+    void Update(float fElapsedTime, int32_t nThreads = 0);
+    // Draws every particle as a single pixel into the draw target
+    void DrawPoints(Blend blend = Blend::ALPHA, int32_t nThreads = 0);
+    // Draws sprite centred on every particle, tinted by the particle colour
+    void DrawSprites(Sprite *sprite, Blend blend = Blend::ALPHA, int32_t nThreads = 0);
+    void Clear();
+    size_t Count() const;
+
+  public:
+    vf2d vGravity = { 0.0f, 0.0f };  // Pixels per second squared
+    float fDrag = 0.0f;              // Part of the velocity lost every second
+
+  private:
+    // Particle i is vPosX[i], vPosY[i], ..., vFade is 1 / starting life
+    std::vector<float> vPosX, vPosY, vVelX, vVelY, vLife, vFade;
+    std::vector<Pixel> vColour;
+    std::vector<uint32_t> vBandIndex; // Particles binned by band, kept between draws
+    std::vector<uint32_t> vBandSpan;  // First band of each particle in the low half, last in the high
+
+    void tDX_Integrate(size_t nStart, size_t nEnd, float fElapsedTime, float fKeep);
+    void tDX_Compact();
+    int32_t tDX_ThreadCount(int32_t nThreads, size_t nCount);
+    // rows gives the rows [y0, y1) particle i touches, false when it is off the target.
+    // band gets its rows and its particles, pIndex is null when it gets all of them
+    template <class R>
+    void tDX_ForBands(int32_t nHeight, int32_t nThreads, R &&rows, const std::function<void(int32_t, int32_t, const uint32_t*, size_t)> &band);
+  };
+}
+
+#endif // T_PGEX_PARTICLES_DEF
+
+
+#ifdef T_PGEX_PARTICLES
+#undef T_PGEX_PARTICLES
+
+namespace tDX
+{
+  ParticleSystem::ParticleSystem(size_t nReserve)
+  {
+    vPosX.reserve(nReserve); vPosY.reserve(nReserve);
+    vVelX.reserve(nReserve); vVelY.reserve(nReserve);
+    vLife.reserve(nReserve); vFade.reserve(nReserve);
+    vColour.reserve(nReserve);
+  }
+
+  void ParticleSystem::Emit(float x, float y, float vx, float vy, float fLife, Pixel col)
+  {
+    if (fLife <= 0.0f) return;
+
+    vPosX.push_back(x); vPosY.push_back(y);
+    vVelX.push_back(vx); vVelY.push_back(vy);
+    vLife.push_back(fLife); vFade.push_back(1.0f / fLife);
+    vColour.push_back(col);
+  }
+
+  int32_t ParticleSystem::tDX_ThreadCount(int32_t nThreads, size_t nCount)
+  {
+    if (nThreads <= 0)
+      nThreads = PixelGameEngine::GetThreadPool().GetThreadCount();
+
+    // Not worth a thread for less than 16k particles
+    return (int32_t)std::min<size_t>(nThreads, nCount / 16384 + 1);
+  }
+
+  void ParticleSystem::Update(float fElapsedTime, int32_t nThreads)
+  {
+    size_t nCount = vLife.size();
+    if (nCount == 0) return;
+
+    float fKeep = std::max(0.0f, 1.0f - fDrag * fElapsedTime);
+
+    nThreads = tDX_ThreadCount(nThreads, nCount);
+
+    if (nThreads == 1)
+      tDX_Integrate(0, nCount, fElapsedTime, fKeep);
+    else
+    {
+      // Chunks are multiples of four so only the last one has a scalar tail
+      size_t nChunk = ((nCount + nThreads - 1) / nThreads + 3) & ~(size_t)3;
+      PixelGameEngine::GetThreadPool().Run((int32_t)((nCount + nChunk - 1) / nChunk), [&](int32_t t)
+      {
+        size_t nStart = t * nChunk;
+        tDX_Integrate(nStart, std::min(nStart + nChunk, nCount), fElapsedTime, fKeep);
+      });
+    }
+
+    tDX_Compact();
+  }
+
+  void ParticleSystem::tDX_Integrate(size_t nStart, size_t nEnd, float fElapsedTime, float fKeep)
+  {
+    float *px = vPosX.data(), *py = vPosY.data();
+    float *vx = vVelX.data(), *vy = vVelY.data();
+    float *life = vLife.data();
+
+    float fGX = vGravity.x * fElapsedTime, fGY = vGravity.y * fElapsedTime;
+    size_t i = nStart;
+
+#ifdef T_PGE_SSE2
+    __m128 dt = _mm_set1_ps(fElapsedTime), keep = _mm_set1_ps(fKeep);
+    __m128 gx = _mm_set1_ps(fGX), gy = _mm_set1_ps(fGY);
+
+    for (; i + 4 <= nEnd; i += 4)
+    {
+      __m128 nvx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(vx + i), keep), gx);
+      __m128 nvy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(vy + i), keep), gy);
+      _mm_storeu_ps(vx + i, nvx);
+      _mm_storeu_ps(vy + i, nvy);
+      _mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(nvx, dt)));
+      _mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(nvy, dt)));
+      _mm_storeu_ps(life + i, _mm_sub_ps(_mm_loadu_ps(life + i), dt));
+    }
+#endif
+
+    for (; i < nEnd; i++)
+    {
+      vx[i] = vx[i] * fKeep + fGX;
+      vy[i] = vy[i] * fKeep + fGY;
+      px[i] += vx[i] * fElapsedTime;
+      py[i] += vy[i] * fElapsedTime;
+      life[i] -= fElapsedTime;
+    }
+  }
+
+  void ParticleSystem::tDX_Compact()
+  {
+    size_t nCount = vLife.size();
+
+    for (size_t i = 0; i < nCount;)
+    {
+      if (vLife[i] > 0.0f) { i++; continue; }
+
+      // Swap the last particle in, then look at slot i again
+      nCount--;
+      vPosX[i] = vPosX[nCount]; vPosY[i] = vPosY[nCount];
+      vVelX[i] = vVelX[nCount]; vVelY[i] = vVelY[nCount];
+      vLife[i] = vLife[nCount]; vFade[i] = vFade[nCount];
+      vColour[i] = vColour[nCount];
+    }
+
+    vPosX.resize(nCount); vPosY.resize(nCount);
+    vVelX.resize(nCount); vVelY.resize(nCount);
+    vLife.resize(nCount); vFade.resize(nCount);
+    vColour.resize(nCount);
+  }
+
+  // Blends col into d with weight a (0 - 256), two channels per multiply
+  static inline void tDX_BlendParticle(Pixel &d, uint32_t col, uint32_t a, ParticleSystem::Blend blend)
+  {
+    if (blend == ParticleSystem::Blend::ALPHA)
+    {
+      uint32_t ia = 256 - a;
+      uint32_t rb = (((col & 0x00FF00FF) * a + (d.n & 0x00FF00FF) * ia) >> 8) & 0x00FF00FF;
+      uint32_t g = (((col & 0x0000FF00) * a + (d.n & 0x0000FF00) * ia) >> 8) & 0x0000FF00;
+      d.n = 0xFF000000 | rb | g;
+    }
+    else
+    {
+      uint32_t rb = (((col & 0x00FF00FF) * a) >> 8) & 0x00FF00FF;
+      uint32_t g = (((col & 0x0000FF00) * a) >> 8) & 0x0000FF00;
+      uint32_t r = (d.n & 0xFF) + (rb & 0xFF);
+      uint32_t b = ((d.n >> 16) & 0xFF) + (rb >> 16);
+      uint32_t gg = ((d.n >> 8) & 0xFF) + (g >> 8);
+      d.n = 0xFF000000 | std::min(r, 255u) | (std::min(gg, 255u) << 8) | (std::min(b, 255u) << 16);
+    }
+  }
+
+  // Particle alpha scaled by how much life is left, 0 - 256
+  static inline uint32_t tDX_ParticleWeight(Pixel col, float fLife, float fFade)
+  {
+    return (uint32_t)(std::min(fLife * fFade, 1.0f) * col.a * (256.0f / 255.0f));
+  }
+
+  template <class R>
+  void ParticleSystem::tDX_ForBands(int32_t nHeight, int32_t nThreads, R &&rows, const std::function<void(int32_t, int32_t, const uint32_t*, size_t)> &band)
+  {
+    size_t nCount = vLife.size();
+    nThreads = tDX_ThreadCount(nThreads, nCount);
+    nThreads = std::min(nThreads, std::min(nHeight, 0xFFFF)); // Band numbers are 16 bit
+
+    if (nThreads <= 1)
+    {
+      band(0, nHeight, nullptr, nCount);
+      return;
+    }
+
+    // Counting sort of the particles into the bands their rows fall in, one on a band
+    // edge goes into both. Bins keep particle order, so every pixel still sees its
+    // particles in order, and every thread only walks its own bin
+    auto bandOf = [&](int32_t y) { return (uint32_t)((((int64_t)y + 1) * nThreads - 1) / nHeight); };
+
+    std::vector<size_t> vStart(nThreads + 1, 0);
+    vBandSpan.resize(nCount);
+    for (size_t i = 0; i < nCount; i++)
+    {
+      int32_t y0, y1;
+      uint32_t b0 = 1, b1 = 0; // Empty unless it lands on the target
+      if (rows(i, y0, y1))
+      {
+        y0 = std::max(y0, 0); y1 = std::min(y1, nHeight);
+        if (y0 < y1) { b0 = bandOf(y0); b1 = bandOf(y1 - 1); }
+      }
+      vBandSpan[i] = b0 | (b1 << 16);
+      for (uint32_t b = b0; b <= b1; b++)
+        vStart[b + 1]++;
+    }
+    for (int32_t t = 0; t < nThreads; t++)
+      vStart[t + 1] += vStart[t];
+
+    vBandIndex.resize(vStart[nThreads]);
+    std::vector<size_t> vFill(vStart.begin(), vStart.end() - 1);
+    for (size_t i = 0; i < nCount; i++)
+      for (uint32_t b = vBandSpan[i] & 0xFFFF; b <= vBandSpan[i] >> 16; b++)
+        vBandIndex[vFill[b]++] = (uint32_t)i;
+
+    PixelGameEngine::GetThreadPool().Run(nThreads, [&](int32_t t)
+    {
+      band(nHeight * t / nThreads, nHeight * (t + 1) / nThreads, vBandIndex.data() + vStart[t], vStart[t + 1] - vStart[t]);
+    });
+  }
+
+  void ParticleSystem::DrawPoints(Blend blend, int32_t nThreads)
+  {
+    Sprite *target = pge->GetDrawTarget();
+    Pixel *pData = target->GetData();
+    int32_t nWidth = target->width, nHeight = target->height;
+    float fWidth = (float)nWidth, fHeight = (float)nHeight;
+
+    auto rows = [&](size_t i, int32_t &y0, int32_t &y1)
+    {
+      float x = vPosX[i], y = vPosY[i];
+      if (!(x >= 0.0f && y >= 0.0f && x < fWidth && y < fHeight)) return false;
+      y0 = (int32_t)y; y1 = y0 + 1;
+      return true;
+    };
+
+    // Every thread owns a band of rows
+    tDX_ForBands(nHeight, nThreads, rows, [&](int32_t nTop, int32_t nBottom, const uint32_t *pIndex, size_t nCount)
+    {
+      float fTop = (float)nTop, fBottom = (float)nBottom;
+
+      for (size_t n = 0; n < nCount; n++)
+      {
+        size_t i = pIndex ? pIndex[n] : n;
+        float x = vPosX[i], y = vPosY[i];
+        if (!(x >= 0.0f && y >= fTop && x < fWidth && y < fBottom)) continue;
+
+        uint32_t a = tDX_ParticleWeight(vColour[i], vLife[i], vFade[i]);
+        if (a == 0) continue;
+
+        tDX_BlendParticle(pData[(int32_t)y * nWidth + (int32_t)x], vColour[i].n, a, blend);
+      }
+    });
+  }
+
+  void ParticleSystem::DrawSprites(Sprite *sprite, Blend blend, int32_t nThreads)
+  {
+    if (sprite == nullptr) return;
+
+    Sprite *target = pge->GetDrawTarget();
+    Pixel *pData = target->GetData();
+    const Pixel *pSrc = sprite->GetData();
+    int32_t nWidth = target->width, nHeight = target->height;
+    int32_t sw = sprite->width, sh = sprite->height;
+    float fHalfW = sw * 0.5f, fHalfH = sh * 0.5f;
+    float fWidth = (float)nWidth, fHeight = (float)nHeight;
+
+    auto rows = [&](size_t i, int32_t &y0, int32_t &y1)
+    {
+      float fx = vPosX[i] - fHalfW, fy = vPosY[i] - fHalfH;
+      if (!(fx > (float)-sw && fy > (float)-sh && fx < fWidth && fy < fHeight)) return false;
+      y0 = (int32_t)std::floor(fy); y1 = y0 + sh;
+      return true;
+    };
+
+    tDX_ForBands(nHeight, nThreads, rows, [&](int32_t nTop, int32_t nBottom, const uint32_t *pIndex, size_t nCount)
+    {
+      float fTop = (float)nTop, fBottom = (float)nBottom;
+
+      for (size_t n = 0; n < nCount; n++)
+      {
+        size_t i = pIndex ? pIndex[n] : n;
+        float fx = vPosX[i] - fHalfW, fy = vPosY[i] - fHalfH;
+        if (!(fx > (float)-sw && fy > fTop - sh && fx < fWidth && fy < fBottom)) continue;
+        int32_t x0 = (int32_t)std::floor(fx);
+        int32_t y0 = (int32_t)std::floor(fy);
+
+        int32_t sx0 = std::max(0, -x0), sx1 = std::min(sw, nWidth - x0);
+        int32_t sy0 = std::max(0, nTop - y0), sy1 = std::min(sh, nBottom - y0);
+        if (sx0 >= sx1 || sy0 >= sy1) continue;
+
+        Pixel tint = vColour[i];
+        uint32_t a = tDX_ParticleWeight(tint, vLife[i], vFade[i]);
+        if (a == 0) continue;
+
+        for (int32_t sy = sy0; sy < sy1; sy++)
+        {
+          const Pixel *s = pSrc + sy * sw;
+          Pixel *d = pData + (y0 + sy) * nWidth + x0;
+
+          for (int32_t sx = sx0; sx < sx1; sx++)
+          {
+            uint32_t sa = (s[sx].a * a) >> 8;
+            if (sa == 0) continue;
+
+            Pixel col((s[sx].r * tint.r) / 255, (s[sx].g * tint.g) / 255, (s[sx].b * tint.b) / 255);
+            tDX_BlendParticle(d[sx], col.n, sa + (sa >> 7), blend);
+          }
+        }
+      }
+    });
+  }
+
+  void ParticleSystem::Clear()
+  {
+    vPosX.clear(); vPosY.clear();
+    vVelX.clear(); vVelY.clear();
+    vLife.clear(); vFade.clear();
+    vColour.clear();
+  }
+
+  size_t ParticleSystem::Count() const
+  {
+    return vLife.size();
+  }
+}
+
+#endif // T_PGEX_PARTICLES
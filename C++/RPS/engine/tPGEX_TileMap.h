@@ -0,0 +1,265 @@
+/*
+  tPGEX_TileMap.h - chunked tile map extension for tPixelGameEngine
+
+  The map keeps one 16 bit tile index per cell and draws from a tile sheet,
+  tiles numbered left to right, top to bottom. Cells are grouped into chunks
+  of 32 x 32 tiles which are rasterized into their own Sprite the first time
+  they are seen. Every visible chunk is then a single DrawPartialSprite call, and
+  changing a tile only rebuilds the chunk it sits in. Chunks that have not
+  been drawn for a while are freed once more than the cache budget are kept.
+
+  Empty cells are left BLANK in the chunk, draw in Pixel::ALPHA or
+  Pixel::MASK mode to see through them.
+
+  Include it after tPixelGameEngine.h and, in the same single file that
+  defines T_PGE_APPLICATION, define T_PGEX_TILEMAP before including it.
+
+  #define T_PGE_APPLICATION
+  #include "tPixelGameEngine.h"
+  #define T_PGEX_TILEMAP
+  #include "tPGEX_TileMap.h"
+*/
+
+#ifndef T_PGEX_TILEMAP_DEF
+#define T_PGEX_TILEMAP_DEF
+
+namespace tDX
+{
+  class TileMap : public tDX::PGEX
+  {
+  public:
+    static const int32_t CHUNK_TILES = 32;
+    static const uint16_t EMPTY = 0xFFFF;
+
+  public:
+    TileMap(int32_t w, int32_t h, int32_t nTileSize, Sprite *sheet);
+
+  public:
+    void SetTile(int32_t x, int32_t y, uint16_t nTile);
+    uint16_t GetTile(int32_t x, int32_t y) const;
+    void Fill(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t nTile);
+    // Rebuilds every chunk, call it after the tile sheet was changed
+    void Invalidate();
+    // Draws the map so that world pixel (nScrollX, nScrollY) lands on the
+    // top left corner of the draw target
+    void Draw(int32_t nScrollX, int32_t nScrollY);
+    // Most chunk sprites kept around, visible ones are never freed
+    void SetCacheBudget(size_t nChunks);
+    size_t GetCachedChunks() const;
+    int32_t GetWidth() const;
+    int32_t GetHeight() const;
+    int32_t GetTileSize() const;
+
+  private:
+    struct sChunk
+    {
+      std::unique_ptr<Sprite> sprite;
+      bool bDirty = true;
+      uint32_t nLastDrawn = 0;
+    };
+
+    int32_t nWidth, nHeight, nTileSize;
+    int32_t nChunksX, nChunksY;
+    Sprite *pSheet;
+    std::vector<uint16_t> vTiles;
+    std::vector<sChunk> vChunks;
+    std::vector<int32_t> vCached;     // Chunks holding a sprite
+    size_t nCacheBudget = 256;
+    uint32_t nFrame = 0;
+
+    void tDX_Rasterize(int32_t cx, int32_t cy);
+    void tDX_Evict();
+  };
+}
+
+#endif // T_PGEX_TILEMAP_DEF
+
+
+#ifdef T_PGEX_TILEMAP
+#undef T_PGEX_TILEMAP
+
+namespace tDX
+{
+  const int32_t TileMap::CHUNK_TILES;
+  const uint16_t TileMap::EMPTY;
+
+  TileMap::TileMap(int32_t w, int32_t h, int32_t nTileSize, Sprite *sheet)
+  {
+    nWidth = std::max(0, w);
+    nHeight = std::max(0, h);
+    this->nTileSize = std::max(1, nTileSize);
+    pSheet = sheet;
+
+    nChunksX = (nWidth + CHUNK_TILES - 1) / CHUNK_TILES;
+    nChunksY = (nHeight + CHUNK_TILES - 1) / CHUNK_TILES;
+
+    vTiles.assign(nWidth * nHeight, EMPTY);
+    vChunks.resize(nChunksX * nChunksY);
+  }
+
+  void TileMap::SetTile(int32_t x, int32_t y, uint16_t nTile)
+  {
+    if (x < 0 || y < 0 || x >= nWidth || y >= nHeight) return;
+
+    uint16_t &t = vTiles[y * nWidth + x];
+    if (t == nTile) return;
+
+    t = nTile;
+    vChunks[(y / CHUNK_TILES) * nChunksX + x / CHUNK_TILES].bDirty = true;
+  }
+
+  uint16_t TileMap::GetTile(int32_t x, int32_t y) const
+  {
+    if (x < 0 || y < 0 || x >= nWidth || y >= nHeight) return EMPTY;
+    return vTiles[y * nWidth + x];
+  }
+
+  void TileMap::Fill(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t nTile)
+  {
+    int32_t x0 = std::max(0, x), x1 = std::min(nWidth, x + w);
+    int32_t y0 = std::max(0, y), y1 = std::min(nHeight, y + h);
+
+    for (int32_t j = y0; j < y1; j++)
+      for (int32_t i = x0; i < x1; i++)
+        SetTile(i, j, nTile);
+  }
+
+  void TileMap::Invalidate()
+  {
+    for (auto &c : vChunks)
+      c.bDirty = true;
+  }
+
+  void TileMap::tDX_Rasterize(int32_t cx, int32_t cy)
+  {
+    sChunk &chunk = vChunks[cy * nChunksX + cx];
+
+    int32_t tx0 = cx * CHUNK_TILES, ty0 = cy * CHUNK_TILES;
+    int32_t nTilesW = std::min(CHUNK_TILES, nWidth - tx0);
+    int32_t nTilesH = std::min(CHUNK_TILES, nHeight - ty0);
+    int32_t nPitch = nTilesW * nTileSize;
+
+    if (!chunk.sprite)
+    {
+      chunk.sprite.reset(new Sprite(nPitch, nTilesH * nTileSize));
+      vCached.push_back(cy * nChunksX + cx);
+    }
+    else
+    {
+      // An earlier Draw this frame may still have the old pixels in the occlusion queue
+      pge->FlushSprites();
+    }
+
+    Pixel *pDst = chunk.sprite->GetData();
+    const Pixel *pSrc = pSheet ? pSheet->GetData() : nullptr;
+    int32_t nSheetCols = pSheet ? pSheet->width / nTileSize : 0;
+    int32_t nSheetTiles = pSheet ? nSheetCols * (pSheet->height / nTileSize) : 0;
+
+    for (int32_t ty = 0; ty < nTilesH; ty++)
+    {
+      const uint16_t *pRow = &vTiles[(ty0 + ty) * nWidth + tx0];
+
+      for (int32_t tx = 0; tx < nTilesW; tx++)
+      {
+        Pixel *d = pDst + ty * nTileSize * nPitch + tx * nTileSize;
+
+        // Empty cells and tiles the sheet does not have stay see through
+        if (pRow[tx] >= nSheetTiles)
+        {
+          for (int32_t y = 0; y < nTileSize; y++)
+            std::fill(d + y * nPitch, d + y * nPitch + nTileSize, BLANK);
+          continue;
+        }
+
+        const Pixel *s = pSrc + (pRow[tx] / nSheetCols) * nTileSize * pSheet->width + (pRow[tx] % nSheetCols) * nTileSize;
+        for (int32_t y = 0; y < nTileSize; y++)
+          memcpy(d + y * nPitch, s + y * pSheet->width, nTileSize * sizeof(Pixel));
+      }
+    }
+
+    chunk.bDirty = false;
+  }
+
+  void TileMap::Draw(int32_t nScrollX, int32_t nScrollY)
+  {
+    nFrame++;
+
+    int32_t nChunkPx = CHUNK_TILES * nTileSize;
+    int32_t nViewW = pge->GetDrawTargetWidth(), nViewH = pge->GetDrawTargetHeight();
+
+    // Chunks overlapping the view, floor division keeps negative scroll right
+    auto floorDiv = [](int32_t a, int32_t b) { return a >= 0 ? a / b : -((-a + b - 1) / b); };
+    int32_t cx0 = std::max(0, floorDiv(nScrollX, nChunkPx));
+    int32_t cy0 = std::max(0, floorDiv(nScrollY, nChunkPx));
+    int32_t cx1 = std::min(nChunksX, floorDiv(nScrollX + nViewW - 1, nChunkPx) + 1);
+    int32_t cy1 = std::min(nChunksY, floorDiv(nScrollY + nViewH - 1, nChunkPx) + 1);
+
+    for (int32_t cy = cy0; cy < cy1; cy++)
+      for (int32_t cx = cx0; cx < cx1; cx++)
+      {
+        sChunk &chunk = vChunks[cy * nChunksX + cx];
+        if (chunk.bDirty || !chunk.sprite)
+          tDX_Rasterize(cx, cy);
+
+        chunk.nLastDrawn = nFrame;
+
+        // Only the part on screen, DrawSprite would walk the whole chunk
+        int32_t x = cx * nChunkPx - nScrollX, y = cy * nChunkPx - nScrollY;
+        int32_t ox = std::max(0, -x), oy = std::max(0, -y);
+        int32_t w = std::min(chunk.sprite->width, nViewW - x) - ox;
+        int32_t h = std::min(chunk.sprite->height, nViewH - y) - oy;
+        pge->DrawPartialSprite(x + ox, y + oy, chunk.sprite.get(), ox, oy, w, h);
+      }
+
+    tDX_Evict();
+  }
+
+  void TileMap::tDX_Evict()
+  {
+    if (vCached.size() <= nCacheBudget) return;
+
+    // Oldest first, chunks drawn this frame are always kept
+    std::sort(vCached.begin(), vCached.end(), [&](int32_t a, int32_t b) { return vChunks[a].nLastDrawn < vChunks[b].nLastDrawn; });
+
+    // An earlier Draw this frame may have left chunks in the occlusion queue
+    pge->FlushSprites();
+
+    size_t nDrop = 0;
+    while (vCached.size() - nDrop > nCacheBudget && vChunks[vCached[nDrop]].nLastDrawn != nFrame)
+    {
+      sChunk &chunk = vChunks[vCached[nDrop]];
+      chunk.sprite.reset();
+      chunk.bDirty = true;
+      nDrop++;
+    }
+
+    vCached.erase(vCached.begin(), vCached.begin() + nDrop);
+  }
+
+  void TileMap::SetCacheBudget(size_t nChunks)
+  {
+    nCacheBudget = nChunks;
+  }
+
+  size_t TileMap::GetCachedChunks() const
+  {
+    return vCached.size();
+  }
+
+  int32_t TileMap::GetWidth() const
+  {
+    return nWidth;
+  }
+
+  int32_t TileMap::GetHeight() const
+  {
+    return nHeight;
+  }
+
+  int32_t TileMap::GetTileSize() const
+  {
+    return nTileSize;
+  }
+}
+
+#endif // T_PGEX_TILEMAP
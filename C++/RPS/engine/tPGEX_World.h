@@ -0,0 +1,322 @@
+/*
+  tPGEX_World.h - world container extension for tPixelGameEngine
+
+  Keeps objects (a box, a layer and an optional sprite) in a loose quadtree
+  so that camera culling and picking only look at objects near the query.
+  The tree is implicit, level d splits the world into 2^d x 2^d cells and an
+  object lives in the deepest cell that holds its centre and is at least as
+  big as the object. Cells are searched with their bounds grown by half a
+  cell on every side, so an object never has to straddle cells. Objects
+  centred outside the world stay in the root and are always tested.
+
+  Moving an object only touches the tree when it changes cells. Results
+  come back sorted by layer, then by id, which is the order Draw uses.
+
+  Include it after tPixelGameEngine.h and, in the same single file that
+  defines T_PGE_APPLICATION, define T_PGEX_WORLD before including it.
+
+  #define T_PGE_APPLICATION
+  #include "tPixelGameEngine.h"
+  #define T_PGEX_WORLD
+  #include "tPGEX_World.h"
+*/
+
+#ifndef T_PGEX_WORLD_DEF
+#define T_PGEX_WORLD_DEF
+
+namespace tDX
+{
+  class World : public tDX::PGEX
+  {
+  public:
+    static const uint32_t INVALID = 0xFFFFFFFF;
+    // Deepest tree allowed, every level holds all of its 4^d cells so eight
+    // levels are already some 87k cells
+    static const int32_t MAX_DEPTH = 8;
+
+    struct sObject
+    {
+      vf2d pos;                  // Top left corner in world units
+      vf2d size;
+      int32_t nLayer = 0;        // Higher layers are drawn on top
+      Sprite *sprite = nullptr;
+      void *pUser = nullptr;
+    };
+
+  public:
+    World(const vf2d &vMin, const vf2d &vMax, int32_t nDepth = 8);
+
+  public:
+    // Ids are handed out from 0 up, ids of removed objects are reused
+    uint32_t Add(const sObject &obj);
+    void Remove(uint32_t id);
+    void Move(uint32_t id, const vf2d &pos);
+    void Resize(uint32_t id, const vf2d &size);
+    // Change pos and size through Move and Resize, the rest freely
+    sObject& Get(uint32_t id);
+    size_t Count() const;
+
+    // Objects overlapping [vMin, vMax), by layer then id
+    void QueryRect(const vf2d &vMin, const vf2d &vMax, std::vector<uint32_t> &vOut);
+    // Objects visible on the draw target with vCamera at its top left corner
+    void QueryCamera(const vf2d &vCamera, std::vector<uint32_t> &vOut);
+    // Objects under the point, topmost first
+    void Pick(const vf2d &p, std::vector<uint32_t> &vOut);
+    uint32_t PickTop(const vf2d &p);
+    // Draws the sprites of the visible objects, lowest layer first
+    void Draw(const vf2d &vCamera);
+
+  private:
+    struct sSlot
+    {
+      sObject obj;
+      int32_t nLevel = -1;       // -1 while the slot is free
+      uint32_t nCell = 0;
+      uint32_t nIndex = 0;       // Position in the cell's list
+    };
+
+    struct sLevel
+    {
+      int32_t nCells;            // Per side
+      vf2d vCellSize;
+      std::vector<std::vector<uint32_t>> vObjects;
+      std::vector<uint32_t> vSubtree; // Objects in the cell and below it
+    };
+
+    vf2d vWorldMin, vWorldMax;
+    std::vector<sLevel> vLevels;
+    std::vector<sSlot> vSlots;
+    std::vector<uint32_t> vFree;
+    size_t nCount = 0;
+
+    void tDX_Locate(const sObject &obj, int32_t &nLevel, uint32_t &nCell) const;
+    void tDX_Link(uint32_t id);
+    void tDX_Unlink(uint32_t id);
+    void tDX_Collect(int32_t nLevel, int32_t cx, int32_t cy, const vf2d &vMin, const vf2d &vMax, std::vector<uint32_t> &vOut) const;
+    void tDX_SortByLayer(std::vector<uint32_t> &vOut) const;
+  };
+}
+
+#endif // T_PGEX_WORLD_DEF
+
+
+#ifdef T_PGEX_WORLD
+#undef T_PGEX_WORLD
+
+namespace tDX
+{
+  const uint32_t World::INVALID;
+  const int32_t World::MAX_DEPTH;
+
+  World::World(const vf2d &vMin, const vf2d &vMax, int32_t nDepth)
+  {
+    vWorldMin = vMin;
+    vWorldMax = vMax;
+
+    nDepth = std::min(std::max(nDepth, 1), MAX_DEPTH);
+    vLevels.resize(nDepth);
+
+    for (int32_t d = 0; d < nDepth; d++)
+    {
+      sLevel &level = vLevels[d];
+      level.nCells = 1 << d;
+      level.vCellSize = { (vMax.x - vMin.x) / level.nCells, (vMax.y - vMin.y) / level.nCells };
+      level.vObjects.resize(level.nCells * level.nCells);
+      level.vSubtree.resize(level.nCells * level.nCells, 0);
+    }
+  }
+
+  void World::tDX_Locate(const sObject &obj, int32_t &nLevel, uint32_t &nCell) const
+  {
+    nLevel = 0;
+    nCell = 0;
+
+    float cx = obj.pos.x + obj.size.x * 0.5f, cy = obj.pos.y + obj.size.y * 0.5f;
+    if (!(cx >= vWorldMin.x && cy >= vWorldMin.y && cx < vWorldMax.x && cy < vWorldMax.y))
+      return;
+
+    // Deepest level whose cells are still as big as the object
+    while (nLevel + 1 < (int32_t)vLevels.size() &&
+      vLevels[nLevel + 1].vCellSize.x >= obj.size.x && vLevels[nLevel + 1].vCellSize.y >= obj.size.y)
+      nLevel++;
+
+    const sLevel &level = vLevels[nLevel];
+    int32_t x = std::min(level.nCells - 1, (int32_t)((cx - vWorldMin.x) / level.vCellSize.x));
+    int32_t y = std::min(level.nCells - 1, (int32_t)((cy - vWorldMin.y) / level.vCellSize.y));
+    nCell = y * level.nCells + x;
+  }
+
+  void World::tDX_Link(uint32_t id)
+  {
+    sSlot &slot = vSlots[id];
+    tDX_Locate(slot.obj, slot.nLevel, slot.nCell);
+
+    std::vector<uint32_t> &list = vLevels[slot.nLevel].vObjects[slot.nCell];
+    slot.nIndex = (uint32_t)list.size();
+    list.push_back(id);
+
+    int32_t x = slot.nCell % vLevels[slot.nLevel].nCells, y = slot.nCell / vLevels[slot.nLevel].nCells;
+    for (int32_t d = slot.nLevel; d >= 0; d--, x >>= 1, y >>= 1)
+      vLevels[d].vSubtree[y * vLevels[d].nCells + x]++;
+  }
+
+  void World::tDX_Unlink(uint32_t id)
+  {
+    sSlot &slot = vSlots[id];
+
+    // Swap remove, the last object in the cell takes our place
+    std::vector<uint32_t> &list = vLevels[slot.nLevel].vObjects[slot.nCell];
+    list[slot.nIndex] = list.back();
+    vSlots[list[slot.nIndex]].nIndex = slot.nIndex;
+    list.pop_back();
+
+    int32_t x = slot.nCell % vLevels[slot.nLevel].nCells, y = slot.nCell / vLevels[slot.nLevel].nCells;
+    for (int32_t d = slot.nLevel; d >= 0; d--, x >>= 1, y >>= 1)
+      vLevels[d].vSubtree[y * vLevels[d].nCells + x]--;
+  }
+
+  uint32_t World::Add(const sObject &obj)
+  {
+    uint32_t id;
+    if (!vFree.empty())
+    {
+      id = vFree.back();
+      vFree.pop_back();
+    }
+    else
+    {
+      id = (uint32_t)vSlots.size();
+      vSlots.emplace_back();
+    }
+
+    vSlots[id].obj = obj;
+    tDX_Link(id);
+    nCount++;
+    return id;
+  }
+
+  void World::Remove(uint32_t id)
+  {
+    if (id >= vSlots.size() || vSlots[id].nLevel < 0) return;
+
+    tDX_Unlink(id);
+    vSlots[id].nLevel = -1;
+    vFree.push_back(id);
+    nCount--;
+  }
+
+  void World::Move(uint32_t id, const vf2d &pos)
+  {
+    if (id >= vSlots.size() || vSlots[id].nLevel < 0) return;
+
+    sSlot &slot = vSlots[id];
+    slot.obj.pos = pos;
+
+    // Most moves stay inside the loose cell and cost nothing more
+    int32_t nLevel;
+    uint32_t nCell;
+    tDX_Locate(slot.obj, nLevel, nCell);
+    if (nLevel == slot.nLevel && nCell == slot.nCell) return;
+
+    tDX_Unlink(id);
+    tDX_Link(id);
+  }
+
+  void World::Resize(uint32_t id, const vf2d &size)
+  {
+    if (id >= vSlots.size() || vSlots[id].nLevel < 0) return;
+
+    tDX_Unlink(id);
+    vSlots[id].obj.size = size;
+    tDX_Link(id);
+  }
+
+  World::sObject& World::Get(uint32_t id)
+  {
+    return vSlots[id].obj;
+  }
+
+  size_t World::Count() const
+  {
+    return nCount;
+  }
+
+  void World::tDX_Collect(int32_t nLevel, int32_t cx, int32_t cy, const vf2d &vMin, const vf2d &vMax, std::vector<uint32_t> &vOut) const
+  {
+    const sLevel &level = vLevels[nLevel];
+    uint32_t nCell = cy * level.nCells + cx;
+    if (level.vSubtree[nCell] == 0) return;
+
+    // Loose bounds, the root takes everything
+    if (nLevel > 0)
+    {
+      float x0 = vWorldMin.x + (cx - 0.5f) * level.vCellSize.x, x1 = x0 + 2.0f * level.vCellSize.x;
+      float y0 = vWorldMin.y + (cy - 0.5f) * level.vCellSize.y, y1 = y0 + 2.0f * level.vCellSize.y;
+      if (x1 <= vMin.x || y1 <= vMin.y || x0 >= vMax.x || y0 >= vMax.y) return;
+    }
+
+    for (uint32_t id : level.vObjects[nCell])
+    {
+      const sObject &obj = vSlots[id].obj;
+      if (obj.pos.x < vMax.x && obj.pos.y < vMax.y && obj.pos.x + obj.size.x > vMin.x && obj.pos.y + obj.size.y > vMin.y)
+        vOut.push_back(id);
+    }
+
+    if (nLevel + 1 < (int32_t)vLevels.size())
+      for (int32_t j = 0; j < 2; j++)
+        for (int32_t i = 0; i < 2; i++)
+          tDX_Collect(nLevel + 1, cx * 2 + i, cy * 2 + j, vMin, vMax, vOut);
+  }
+
+  void World::tDX_SortByLayer(std::vector<uint32_t> &vOut) const
+  {
+    std::sort(vOut.begin(), vOut.end(), [&](uint32_t a, uint32_t b)
+    {
+      int32_t la = vSlots[a].obj.nLayer, lb = vSlots[b].obj.nLayer;
+      return la < lb || (la == lb && a < b);
+    });
+  }
+
+  void World::QueryRect(const vf2d &vMin, const vf2d &vMax, std::vector<uint32_t> &vOut)
+  {
+    vOut.clear();
+    tDX_Collect(0, 0, 0, vMin, vMax, vOut);
+    tDX_SortByLayer(vOut);
+  }
+
+  void World::QueryCamera(const vf2d &vCamera, std::vector<uint32_t> &vOut)
+  {
+    vf2d vView = { (float)pge->GetDrawTargetWidth(), (float)pge->GetDrawTargetHeight() };
+    QueryRect(vCamera, vCamera + vView, vOut);
+  }
+
+  void World::Pick(const vf2d &p, std::vector<uint32_t> &vOut)
+  {
+    // The smallest box holding just the point
+    vf2d q = { std::nextafter(p.x, INFINITY), std::nextafter(p.y, INFINITY) };
+    QueryRect(p, q, vOut);
+    std::reverse(vOut.begin(), vOut.end());
+  }
+
+  uint32_t World::PickTop(const vf2d &p)
+  {
+    std::vector<uint32_t> vHits;
+    Pick(p, vHits);
+    return vHits.empty() ? INVALID : vHits.front();
+  }
+
+  void World::Draw(const vf2d &vCamera)
+  {
+    std::vector<uint32_t> vVisible;
+    QueryCamera(vCamera, vVisible);
+
+    for (uint32_t id : vVisible)
+    {
+      const sObject &obj = vSlots[id].obj;
+      if (obj.sprite)
+        pge->DrawSprite((int32_t)(obj.pos.x - vCamera.x), (int32_t)(obj.pos.y - vCamera.y), obj.sprite);
+    }
+  }
+}
+
+#endif // T_PGEX_WORLD
@@ -82,6 +82,18 @@
 #include <map>
 #include <functional>
 #include <algorithm>
+#include <unordered_map>
+#include <list>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// SIMD blitters, the AVX2 variants are used when built with /arch:AVX2
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <immintrin.h>
+#define T_PGE_SSE2
+#endif
 
   // C++17 onwards
 #include <filesystem>
@@ -188,10 +200,46 @@ namespace tDX // tucna - DirectX
 
   //=============================================================
 
+  // Worker threads started on first use and kept until exit, so work split up
+  // every frame costs a wake up rather than starting and joining threads
+  class ThreadPool
+  {
+  public:
+    ~ThreadPool();
+
+  public:
+    // Calls job(0) to job(nJobs - 1) on the workers and the calling thread and
+    // returns once all are done. Jobs must not call Run themselves
+    void Run(int32_t nJobs, const std::function<void(int32_t)>& job);
+    // Workers plus the calling thread
+    int32_t GetThreadCount();
+
+  private:
+    std::vector<std::thread> vWorkers;
+    std::mutex mux;
+    std::condition_variable cvWork;
+    std::condition_variable cvDone;
+    const std::function<void(int32_t)>* pJob = nullptr;
+    int32_t nJobs = 0;
+    int32_t nNext = 0;
+    int32_t nPending = 0;
+    bool bQuit = false;
+
+    void tDX_Worker();
+    bool tDX_RunNext(std::unique_lock<std::mutex>& lock);
+  };
+
+  //=============================================================
+
   struct ResourceBuffer : public std::streambuf
   {
     ResourceBuffer(std::ifstream &ifs, uint32_t offset, uint32_t size);
     std::vector<char> vMemory;
+
+  protected:
+    // Lets readers seek and tellg within the buffered file
+    std::streampos seekoff(std::streamoff off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in) override;
+    std::streampos seekpos(std::streampos pos, std::ios_base::openmode which = std::ios_base::in) override;
   };
 
   class ResourcePack : public std::streambuf
@@ -214,6 +262,26 @@ namespace tDX // tucna - DirectX
 
   //=============================================================
 
+  // One bit per pixel of a sprite, set where it is opaque enough to collide.
+  // Rows are packed into 64 bit words, lowest bit first, and the box around
+  // the set bits lets most tests finish without looking at a single word
+  struct SpriteMask
+  {
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t nWords = 0;                     // Words per row
+    int32_t nBoxX0 = 0, nBoxY0 = 0;         // Bounding box of the set bits,
+    int32_t nBoxX1 = -1, nBoxY1 = -1;       // inclusive and empty when x1 < x0
+    std::vector<uint64_t> vBits;
+
+    void Build(const Pixel *data, int32_t w, int32_t h, uint8_t nAlphaThreshold = 128);
+    bool Test(int32_t x, int32_t y) const;
+    // True when mask a drawn at pa and mask b drawn at pb share a set pixel
+    static bool Overlap(const SpriteMask& a, const vi2d& pa, const SpriteMask& b, const vi2d& pb);
+  };
+
+  //=============================================================
+
   // A bitmap-like structure that stores a 2D array of Pixels
   class Sprite
   {
@@ -226,7 +294,10 @@ namespace tDX // tucna - DirectX
   public:
     tDX::rcode LoadFromFile(std::string sImageFile, tDX::ResourcePack *pack = nullptr);
     tDX::rcode LoadFromPGESprFile(std::string sImageFile, tDX::ResourcePack *pack = nullptr);
-    tDX::rcode SaveToPGESprFile(std::string sImageFile);
+    // Loads only the area (ox,oy) to (ox+w,oy+h) of the stored image
+    tDX::rcode LoadFromPGESprFile(std::string sImageFile, int32_t ox, int32_t oy, int32_t w, int32_t h, tDX::ResourcePack *pack = nullptr);
+    // Version 1 is raw pixels, version 2 is compressed row by row
+    tDX::rcode SaveToPGESprFile(std::string sImageFile, uint32_t nVersion = 2);
 
   public:
     int32_t width = 0; // int32 here, really?
@@ -242,9 +313,25 @@ namespace tDX // tucna - DirectX
     Pixel SampleBL(float u, float v);
     Pixel* GetData();
 
+    // How the alpha of the sprite is spread, worked out on first use and again
+    // after SetPixel, a load or GetData (which may be used to write the pixels)
+    enum class Opacity : uint8_t { UNKNOWN, SOLID, MASKED, BLENDED };
+    Opacity GetOpacity();
+    // Collision mask of the pixels with alpha of 128 and above, rebuilt
+    // under the same rules as the opacity
+    const SpriteMask& GetMask();
+
   private:
     Pixel *pColData = nullptr;
     Mode modeSample = Mode::NORMAL;
+    Opacity opacity = Opacity::UNKNOWN;
+    SpriteMask mask;
+    bool bMaskValid = false;
+    bool bQueued = false; // Waiting in the engine's occlusion queue
+    // Paints the occlusion queue before the pixels change or go away, when this
+    // sprite is in it or is the target it is painted on
+    void tDX_FlushQueued();
+    friend class PixelGameEngine;
 
 #ifdef T_DBG_OVERDRAW
   public:
@@ -255,6 +342,118 @@ namespace tDX // tucna - DirectX
 
   //=============================================================
 
+  // A bitmap of 8-bit indices into a 256 entry Pixel palette, a quarter of the
+  // memory of a Sprite. Index 0 is reserved for transparency
+  class IndexedSprite
+  {
+  public:
+    IndexedSprite();
+    IndexedSprite(int32_t w, int32_t h);
+    IndexedSprite(Sprite *sprite);
+    ~IndexedSprite();
+
+  public:
+    // Converts a Sprite, median cut quantising to 255 colours if it has more.
+    // Fully transparent pixels map to TRANSPARENT_INDEX
+    tDX::rcode Quantize(Sprite *sprite);
+
+  public:
+    int32_t width = 0;
+    int32_t height = 0;
+    static const uint8_t TRANSPARENT_INDEX = 0;
+    Pixel palette[256];
+
+  public:
+    Pixel GetPixel(int32_t x, int32_t y);
+    uint8_t GetIndex(int32_t x, int32_t y);
+    bool SetIndex(int32_t x, int32_t y, uint8_t i);
+    uint8_t* GetData();
+
+  private:
+    uint8_t *pIndexData = nullptr;
+  };
+
+  //=============================================================
+
+  // An image too big to keep decoded, split into square tiles stored in a tile
+  // file. Tiles are decoded when first needed and at most the budget worth of
+  // them stay resident, the least recently used are dropped first
+  class PagedSprite
+  {
+  public:
+    PagedSprite();
+    PagedSprite(const std::string& sTileFile, size_t nBudgetBytes = 64 << 20, tDX::ResourcePack *pack = nullptr);
+
+  public:
+    // Splits a PGESpr image into a tile file, reading one band of tiles at a
+    // time so the whole image never has to be in memory
+    static tDX::rcode BuildTileFile(const std::string& sImageFile, const std::string& sTileFile, int32_t nTileSize = 256, tDX::ResourcePack *pack = nullptr);
+    static tDX::rcode BuildTileFile(Sprite *sprite, const std::string& sTileFile, int32_t nTileSize = 256);
+    tDX::rcode Open(const std::string& sTileFile, size_t nBudgetBytes = 64 << 20, tDX::ResourcePack *pack = nullptr);
+    // Tiles within nMargin pixels of a drawn area are loaded ahead of time,
+    // at most nMaxLoads of them per draw so scrolling does not stall
+    void SetPrefetch(int32_t nMargin, int32_t nMaxLoads);
+    void Prefetch(int32_t x, int32_t y, int32_t w, int32_t h);
+
+  public:
+    int32_t width = 0;
+    int32_t height = 0;
+    int32_t nTileSize = 0;
+
+  public:
+    Pixel GetPixel(int32_t x, int32_t y);
+    // Pixels of tile (tx,ty) with a pitch of GetTileWidth(tx), nullptr if missing
+    const Pixel* GetTile(int32_t tx, int32_t ty);
+    int32_t GetTileWidth(int32_t tx);
+    int32_t GetTileHeight(int32_t ty);
+    size_t GetResidentBytes();
+
+  private:
+    struct sTile
+    {
+      std::vector<Pixel> vPixels;
+      std::list<int32_t>::iterator itLRU;
+      bool bResident = false;
+    };
+    int32_t nTilesX = 0;
+    int32_t nTilesY = 0;
+    size_t nMaxResident = 0;
+    size_t nResidentBytes = 0;
+    int32_t nPrefetchMargin = 0;
+    int32_t nPrefetchLoads = 2;
+    std::vector<sTile> vTiles;
+    std::list<int32_t> lstLRU; // Most recently used at the front
+    std::vector<uint64_t> vTileOffsets;
+    uint64_t nDataStart = 0;
+    std::unique_ptr<ResourceBuffer> pPackBuffer;
+    std::unique_ptr<std::istream> pStream;
+    std::vector<uint8_t> vTileBlob;
+
+    bool LoadTile(int32_t nTile);
+    // fetchBand points pBand at up to h rows starting at row y and sets w and h
+    using BandFunc = std::function<bool(int32_t y, const Pixel *&pBand, int32_t &w, int32_t &h)>;
+    static tDX::rcode WriteTileFile(const std::string& sTileFile, int32_t nTileSize, const BandFunc& fetchBand);
+  };
+
+  //=============================================================
+
+#ifdef T_DBG_OVERDRAW
+  // Primitive families told apart by the overdraw heatmap
+  enum class DrawPrimitive : uint8_t { POINT, LINE, CIRCLE, RECT, TRIANGLE, SPRITE, TEXT, CLEAR, COUNT, ALL = COUNT };
+
+  // Writes to the primary screen during one frame
+  struct OverdrawStats
+  {
+    uint64_t nWrites[(size_t)DrawPrimitive::COUNT] = {};
+    uint64_t nTotalWrites = 0;
+    uint32_t nCoveredPixels = 0; // Pixels written at least once
+    uint32_t nMaxWrites = 0;     // Most writes to a single pixel
+    float fOverdraw = 0.0f;      // Writes per covered pixel
+  };
+
+  //=============================================================
+#endif
+
   enum Key
   {
     NONE,
@@ -275,6 +474,7 @@ namespace tDX // tucna - DirectX
   {
   public:
     PixelGameEngine();
+    ~PixelGameEngine();
 
   public:
     tDX::rcode	Construct(uint32_t screen_w, uint32_t screen_h, uint32_t pixel_w, uint32_t pixel_h, bool full_screen = false, bool vsync = false);
@@ -313,6 +513,8 @@ namespace tDX // tucna - DirectX
     int32_t GetDrawTargetHeight();
     // Returns the currently active draw target
     Sprite* GetDrawTarget();
+    // Threads shared by every extension that splits up its work
+    static ThreadPool& GetThreadPool();
 
   public: // Draw Routines
     // Specify which Sprite should be the target of drawing functions, use nullptr
@@ -334,6 +536,16 @@ namespace tDX // tucna - DirectX
     // Draws a single Pixel
     virtual bool Draw(int32_t x, int32_t y, Pixel p = tDX::WHITE);
     bool Draw(const tDX::vi2d& pos, Pixel p = tDX::WHITE);
+    // Primitives write straight into the draw target and never call Draw. An application
+    // that overrides Draw turns this on to have every primitive pixel go through it again
+    void EnableDrawOverride(bool bEnable);
+    // Unscaled sprites that are drawn opaque or masked get queued and painted front to
+    // back, so pixels hidden by later sprites are never written. Anything else drawn,
+    // a new draw target, the end of the frame and changing or freeing a queued sprite
+    // or the draw target through Sprite flush the queue first
+    void EnableSpriteOcclusion(bool bEnable);
+    // Paints the queued sprites now, for code that writes the target some other way
+    void FlushSprites();
     // Draws a line from (x1,y1) to (x2,y2)
     void DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p = tDX::WHITE, uint32_t pattern = 0xFFFFFFFF);
     void DrawLine(const tDX::vi2d& pos1, const tDX::vi2d& pos2, Pixel p = tDX::WHITE, uint32_t pattern = 0xFFFFFFFF);
@@ -362,6 +574,17 @@ namespace tDX // tucna - DirectX
     // selected area is (ox,oy) to (ox+w,oy+h)
     void DrawPartialSprite(int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale = 1);
     void DrawPartialSprite(const tDX::vi2d& pos, Sprite *sprite, const tDX::vi2d& sourcepos, const tDX::vi2d& size, uint32_t scale = 1);
+    // Same for palette indexed sprites. In NORMAL and MASK mode unscaled rows are
+    // expanded through the palette straight into the draw target
+    void DrawSprite(int32_t x, int32_t y, IndexedSprite *sprite, uint32_t scale = 1);
+    void DrawSprite(const tDX::vi2d& pos, IndexedSprite *sprite, uint32_t scale = 1);
+    void DrawPartialSprite(int32_t x, int32_t y, IndexedSprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale = 1);
+    void DrawPartialSprite(const tDX::vi2d& pos, IndexedSprite *sprite, const tDX::vi2d& sourcepos, const tDX::vi2d& size, uint32_t scale = 1);
+    // Same for paged sprites, only the tiles that end up on the draw target are loaded
+    void DrawSprite(int32_t x, int32_t y, PagedSprite *sprite, uint32_t scale = 1);
+    void DrawSprite(const tDX::vi2d& pos, PagedSprite *sprite, uint32_t scale = 1);
+    void DrawPartialSprite(int32_t x, int32_t y, PagedSprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale = 1);
+    void DrawPartialSprite(const tDX::vi2d& pos, PagedSprite *sprite, const tDX::vi2d& sourcepos, const tDX::vi2d& size, uint32_t scale = 1);
     // Draws a single line of text
     void DrawString(int32_t x, int32_t y, const std::string& sText, Pixel col = tDX::WHITE, uint32_t scale = 1);
     void DrawString(const tDX::vi2d& pos, const std::string& sText, Pixel col = tDX::WHITE, uint32_t scale = 1);
@@ -370,6 +593,15 @@ namespace tDX // tucna - DirectX
     // Resize the primary screen sprite
     void SetScreenSize(int w, int h);
 
+#ifdef T_DBG_OVERDRAW
+  public: // Debug
+    // Replace the presented frame with a false colour map of how many times
+    // each pixel was written, by all primitives or by one family only
+    void SetOverdrawHeatmap(bool bShow, DrawPrimitive filter = DrawPrimitive::ALL);
+    // Overdraw of the last completed frame
+    OverdrawStats GetOverdrawStats();
+#endif
+
   public: // Branding
     std::string sAppName;
 
@@ -412,6 +644,56 @@ namespace tDX // tucna - DirectX
     int			nFrameCount = 0;
     Sprite		*fontSprite = nullptr;
     std::function<tDX::Pixel(const int x, const int y, const tDX::Pixel&, const tDX::Pixel&)> funcPixelMode;
+    bool		bDrawOverride = false;
+
+    // Pixel sinks specialised on the pixel mode, one is picked per primitive by tDX_Dispatch
+    static const int DRAW_OVERRIDE = Pixel::Mode::CUSTOM + 1;
+    template <int MODE> struct SpanWriter;
+    template <class F> void tDX_Dispatch(F&& fn);
+
+    // Sprite draws waiting for the front to back pass, clipped to the draw target
+    struct sQueuedSprite
+    {
+      Sprite *sprite;
+      int32_t x0, y0, x1, y1; // Destination, x1 and y1 exclusive
+      int32_t sx, sy;         // Source pixel that lands on (x0,y0)
+      bool bMask;             // Pixels with alpha below 255 are skipped
+    };
+    std::vector<sQueuedSprite> vSpriteQueue;
+    std::vector<uint64_t> vCoverage; // Written pixels of each 8x8 tile, one byte per row
+    int32_t nCoverageTilesX = 0;
+    bool bSpriteOcclusion = false;
+    bool tDX_QueueSprite(int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale);
+    void tDX_FlushSprites();
+
+#ifdef T_DBG_OVERDRAW
+    // Per pixel write counts of the primary screen, one saturating byte per primitive family
+    std::vector<uint8_t> vOverdraw;
+    DrawPrimitive nOverdrawPrimitive = DrawPrimitive::POINT;
+    DrawPrimitive nHeatmapFilter = DrawPrimitive::ALL;
+    bool bShowHeatmap = false;
+    OverdrawStats overdrawStats;
+    std::vector<Pixel> vHeatmapFrame;  // Copy of the screen with the heatmap on top, uploaded in its place
+
+    // Tags writes with the outermost primitive, so DrawRect counts as RECT and not LINE
+    struct OverdrawScope
+    {
+      OverdrawScope(PixelGameEngine *e, DrawPrimitive p) : pge(e), prev(e->nOverdrawPrimitive)
+      {
+        if (prev == DrawPrimitive::POINT) pge->nOverdrawPrimitive = p;
+      }
+      ~OverdrawScope() { pge->nOverdrawPrimitive = prev; }
+      PixelGameEngine *pge;
+      DrawPrimitive prev;
+    };
+
+    void tDX_CountOverdraw(int32_t x, int32_t y);
+    void tDX_BeginOverdrawFrame();
+    void tDX_EndOverdrawFrame();
+#define T_OVERDRAW_SCOPE(p) OverdrawScope overdrawScope(this, DrawPrimitive::p)
+#else
+#define T_OVERDRAW_SCOPE(p)
+#endif
 
     static std::map<size_t, uint8_t> mapKeys;
     bool		pKeyNewState[256]{ 0 };
@@ -460,6 +742,7 @@ namespace tDX // tucna - DirectX
   class PGEX
   {
     friend class tDX::PixelGameEngine;
+    friend class tDX::Sprite;
   protected:
     static PixelGameEngine* pge;
   };
@@ -556,53 +839,238 @@ namespace tDX
 
   Sprite::~Sprite()
   {
-    if (pColData) delete pColData;
+    tDX_FlushQueued();
+    if (pColData) delete[] pColData;
+  }
+
+  void Sprite::tDX_FlushQueued()
+  {
+    PixelGameEngine *pge = PGEX::pge;
+    if (pge && (bQueued || pge->GetDrawTarget() == this))
+      pge->FlushSprites();
+  }
+
+  // PGESpr v2 rows are a filter byte followed by RLE ops over whole pixels.
+  // An op byte with the top bit set repeats the next pixel (op & 0x7F) + 1
+  // times, otherwise (op + 1) literal pixels follow. With the LEFT filter
+  // every pixel is stored as the per-channel difference to its left
+  // neighbour, which turns gradients into runs
+  enum { PGESPR_FILTER_NONE = 0, PGESPR_FILTER_LEFT = 1 };
+
+  static uint32_t tDX_AddBytes(uint32_t a, uint32_t b)
+  {
+    // Four independent 8-bit adds without carries between channels
+    return ((a & 0x7F7F7F7F) + (b & 0x7F7F7F7F)) ^ ((a ^ b) & 0x80808080);
+  }
+
+  static uint32_t tDX_SubBytes(uint32_t a, uint32_t b)
+  {
+    return ((a | 0x80808080) - (b & 0x7F7F7F7F)) ^ ((a ^ ~b) & 0x80808080);
+  }
+
+  static void tDX_EncodePGESprRun(const uint32_t *row, int32_t w, uint8_t nFilter, std::vector<uint8_t>& out)
+  {
+    out.push_back(nFilter);
+
+    int32_t i = 0;
+    while (i < w)
+    {
+      int32_t r = 1;
+      while (i + r < w && r < 128 && row[i + r] == row[i]) r++;
+
+      if (r >= 2)
+      {
+        out.push_back((uint8_t)(0x80 | (r - 1)));
+        out.insert(out.end(), (const uint8_t*)&row[i], (const uint8_t*)&row[i] + 4);
+        i += r;
+      }
+      else
+      {
+        // Literals until the next run of two starts
+        int32_t n = 1;
+        while (i + n < w && n < 128 && !(i + n + 1 < w && row[i + n] == row[i + n + 1])) n++;
+        out.push_back((uint8_t)(n - 1));
+        out.insert(out.end(), (const uint8_t*)&row[i], (const uint8_t*)&row[i + n]);
+        i += n;
+      }
+    }
+  }
+
+  static void tDX_EncodePGESprRow(const Pixel *row, int32_t w, std::vector<uint8_t>& out)
+  {
+    // Keep whichever filter packs smaller
+    std::vector<uint32_t> vDelta(w);
+    for (int32_t i = 0; i < w; i++)
+      vDelta[i] = i == 0 ? row[0].n : tDX_SubBytes(row[i].n, row[i - 1].n);
+
+    std::vector<uint8_t> vPlain, vLeft;
+    tDX_EncodePGESprRun((const uint32_t*)row, w, PGESPR_FILTER_NONE, vPlain);
+    tDX_EncodePGESprRun(vDelta.data(), w, PGESPR_FILTER_LEFT, vLeft);
+
+    const std::vector<uint8_t> &best = vLeft.size() < vPlain.size() ? vLeft : vPlain;
+    out.insert(out.end(), best.begin(), best.end());
+  }
+
+  static bool tDX_DecodePGESprRow(const uint8_t *src, size_t n, Pixel *dst, int32_t w)
+  {
+    if (n < 1) return false;
+    const uint8_t *end = src + n;
+    uint8_t nFilter = *src++;
+
+    int32_t i = 0;
+    while (i < w && src < end)
+    {
+      uint8_t op = *src++;
+      int32_t count = (op & 0x7F) + 1;
+      if (count > w - i) return false;
+
+      if (op & 0x80)
+      {
+        if (end - src < 4) return false;
+        uint32_t p; memcpy(&p, src, 4); src += 4;
+        std::fill_n((uint32_t*)dst + i, count, p);
+      }
+      else
+      {
+        if (end - src < count * 4) return false;
+        memcpy(dst + i, src, count * 4); src += count * 4;
+      }
+      i += count;
+    }
+    if (i != w) return false;
+
+    if (nFilter == PGESPR_FILTER_LEFT)
+    {
+      uint32_t *p = (uint32_t*)dst;
+      for (int32_t k = 1; k < w; k++)
+        p[k] = tDX_AddBytes(p[k], p[k - 1]);
+    }
+    return nFilter <= PGESPR_FILTER_LEFT;
   }
 
   tDX::rcode Sprite::LoadFromPGESprFile(std::string sImageFile, tDX::ResourcePack *pack)
   {
+    return LoadFromPGESprFile(sImageFile, 0, 0, 0, 0, pack);
+  }
+
+  tDX::rcode Sprite::LoadFromPGESprFile(std::string sImageFile, int32_t ox, int32_t oy, int32_t w, int32_t h, tDX::ResourcePack *pack)
+  {
+    tDX_FlushQueued();
     if (pColData) delete[] pColData;
+    pColData = nullptr;
+    width = 0;
+    height = 0;
+    opacity = Opacity::UNKNOWN;
+    bMaskValid = false;
 
     auto ReadData = [&](std::istream &is)
     {
-      is.read((char*)&width, sizeof(int32_t));
-      is.read((char*)&height, sizeof(int32_t));
+      // v1 starts straight with the width, v2 with a magic that no sane width matches
+      char magic[4] = {};
+      int32_t nFileWidth = 0, nFileHeight = 0;
+      is.read(magic, 4);
+      bool bV2 = memcmp(magic, "tSP2", 4) == 0;
+      if (bV2)
+      {
+        uint32_t nFlags = 0;
+        is.read((char*)&nFileWidth, sizeof(int32_t));
+        is.read((char*)&nFileHeight, sizeof(int32_t));
+        is.read((char*)&nFlags, sizeof(uint32_t));
+      }
+      else
+      {
+        memcpy(&nFileWidth, magic, sizeof(int32_t));
+        is.read((char*)&nFileHeight, sizeof(int32_t));
+      }
+      if (!is || nFileWidth <= 0 || nFileHeight <= 0) return false;
+
+      // Zero size means the whole image, otherwise clip the area to it
+      if (w <= 0 || h <= 0) { ox = 0; oy = 0; w = nFileWidth; h = nFileHeight; }
+      if (ox < 0) { w += ox; ox = 0; }
+      if (oy < 0) { h += oy; oy = 0; }
+      w = std::min(w, nFileWidth - ox);
+      h = std::min(h, nFileHeight - oy);
+      if (w <= 0 || h <= 0) return false;
+
+      width = w;
+      height = h;
       pColData = new Pixel[width * height];
-      is.read((char*)pColData, width * height * sizeof(uint32_t));
+      std::streampos start = is.tellg();
+
+      if (!bV2)
+      {
+        // These are essentially Memory Surfaces represented by tDX::Sprite
+        // which load very fast, but are completely uncompressed
+        for (int32_t y = 0; y < h; y++)
+        {
+          is.seekg(start + (std::streamoff)(((int64_t)(oy + y) * nFileWidth + ox) * sizeof(uint32_t)));
+          is.read((char*)(pColData + y * width), width * sizeof(uint32_t));
+        }
+        return (bool)is;
+      }
+
+      // Row offsets allow jumping to the first wanted row, then rows
+      // stream one at a time straight into pColData
+      std::vector<uint32_t> vOffsets(nFileHeight + 1);
+      is.read((char*)vOffsets.data(), vOffsets.size() * sizeof(uint32_t));
+      if (!is) return false;
+
+      start = is.tellg();
+      is.seekg(start + (std::streamoff)vOffsets[oy]);
+
+      std::vector<uint8_t> vRow;
+      std::vector<Pixel> vScratch(w == nFileWidth ? 0 : nFileWidth);
+      for (int32_t y = 0; y < h; y++)
+      {
+        if (vOffsets[oy + y + 1] < vOffsets[oy + y]) return false;
+        vRow.resize(vOffsets[oy + y + 1] - vOffsets[oy + y]);
+        is.read((char*)vRow.data(), vRow.size());
+        if (!is) return false;
+
+        Pixel *dst = vScratch.empty() ? pColData + y * width : vScratch.data();
+        if (!tDX_DecodePGESprRow(vRow.data(), vRow.size(), dst, nFileWidth)) return false;
+        if (!vScratch.empty())
+          std::copy(vScratch.begin() + ox, vScratch.begin() + ox + w, pColData + y * width);
+      }
+      return true;
     };
 
-    // These are essentially Memory Surfaces represented by tDX::Sprite
-    // which load very fast, but are completely uncompressed
+    bool bLoaded = false;
     if (pack == nullptr)
     {
       std::ifstream ifs;
       ifs.open(sImageFile, std::ifstream::binary);
-      if (ifs.is_open())
-      {
-        ReadData(ifs);
-        return tDX::OK;
-      }
-      else
-        return tDX::FAIL;
+      if (!ifs.is_open())
+        return tDX::NO_FILE;
+      bLoaded = ReadData(ifs);
     }
     else
     {
       ResourceBuffer rb = pack->GetFileBuffer(sImageFile);
       std::istream is(&rb);
-      ReadData(is);
+      bLoaded = ReadData(is);
     }
 
+    if (bLoaded)
+      return tDX::OK;
 
+    if (pColData) delete[] pColData;
+    pColData = nullptr;
+    width = 0;
+    height = 0;
     return tDX::FAIL;
   }
 
-  tDX::rcode Sprite::SaveToPGESprFile(std::string sImageFile)
+  tDX::rcode Sprite::SaveToPGESprFile(std::string sImageFile, uint32_t nVersion)
   {
     if (pColData == nullptr) return tDX::FAIL;
 
     std::ofstream ofs;
     ofs.open(sImageFile, std::ifstream::binary);
-    if (ofs.is_open())
+    if (!ofs.is_open())
+      return tDX::FAIL;
+
+    if (nVersion == 1)
     {
       ofs.write((char*)&width, sizeof(int32_t));
       ofs.write((char*)&height, sizeof(int32_t));
@@ -611,7 +1079,26 @@ namespace tDX
       return tDX::OK;
     }
 
-    return tDX::FAIL;
+    // Compress every row, remembering where each one starts
+    std::vector<uint32_t> vOffsets;
+    std::vector<uint8_t> vData;
+    vOffsets.reserve(height + 1);
+    for (int32_t y = 0; y < height; y++)
+    {
+      vOffsets.push_back((uint32_t)vData.size());
+      tDX_EncodePGESprRow(pColData + y * width, width, vData);
+    }
+    vOffsets.push_back((uint32_t)vData.size());
+
+    uint32_t nFlags = 0;
+    ofs.write("tSP2", 4);
+    ofs.write((char*)&width, sizeof(int32_t));
+    ofs.write((char*)&height, sizeof(int32_t));
+    ofs.write((char*)&nFlags, sizeof(uint32_t));
+    ofs.write((char*)vOffsets.data(), vOffsets.size() * sizeof(uint32_t));
+    ofs.write((char*)vData.data(), vData.size());
+    ofs.close();
+    return tDX::OK;
   }
 
 #if defined(__linux__)
@@ -625,6 +1112,7 @@ namespace tDX
   tDX::rcode Sprite::LoadFromFile(std::string sImageFile, tDX::ResourcePack *pack)
   {
     UNUSED(pack);
+    tDX_FlushQueued();
 
     Gdiplus::Bitmap *bmp = nullptr;
     if (pack != nullptr)
@@ -643,6 +1131,8 @@ namespace tDX
     width = bmp->GetWidth();
     height = bmp->GetHeight();
     pColData = new Pixel[width * height];
+    opacity = Opacity::UNKNOWN;
+    bMaskValid = false;
 
     for (int x = 0; x < width; x++)
       for (int y = 0; y < height; y++)
@@ -678,6 +1168,9 @@ namespace tDX
 
   bool Sprite::SetPixel(int32_t x, int32_t y, Pixel p)
   {
+    tDX_FlushQueued();
+    opacity = Opacity::UNKNOWN;
+    bMaskValid = false;
 
 #ifdef T_DBG_OVERDRAW
     nOverdrawCount++;
@@ -722,91 +1215,664 @@ namespace tDX
       (uint8_t)((p1.b * u_opposite + p2.b * u_ratio) * v_opposite + (p3.b * u_opposite + p4.b * u_ratio) * v_ratio));
   }
 
-  Pixel* Sprite::GetData() { return pColData; }
+  Pixel* Sprite::GetData()
+  {
+    tDX_FlushQueued();
+    opacity = Opacity::UNKNOWN;
+    bMaskValid = false;
+    return pColData;
+  }
+
+  const SpriteMask& Sprite::GetMask()
+  {
+    if (!bMaskValid)
+    {
+      mask.Build(pColData, pColData ? width : 0, pColData ? height : 0);
+      bMaskValid = true;
+    }
+    return mask;
+  }
+
+  Sprite::Opacity Sprite::GetOpacity()
+  {
+    if (opacity == Opacity::UNKNOWN)
+    {
+      opacity = Opacity::SOLID;
+      for (int32_t i = 0; i < width * height; i++)
+      {
+        if (pColData[i].a == 255) continue;
+        if (pColData[i].a != 0) { opacity = Opacity::BLENDED; break; }
+        opacity = Opacity::MASKED;
+      }
+    }
+    return opacity;
+  }
 
   //==========================================================
-  // Resource Packs - Allows you to store files in one large
-  // scrambled file
 
+  IndexedSprite::IndexedSprite()
+  {
+    std::fill(palette, palette + 256, tDX::BLANK);
+  }
 
-  ResourceBuffer::ResourceBuffer(std::ifstream &ifs, uint32_t offset, uint32_t size)
+  IndexedSprite::IndexedSprite(int32_t w, int32_t h)
   {
-    vMemory.resize(size);
-    ifs.seekg(offset); ifs.read(vMemory.data(), vMemory.size());
-    setg(vMemory.data(), vMemory.data(), vMemory.data() + size);
+    std::fill(palette, palette + 256, tDX::BLANK);
+    width = w;		height = h;
+    pIndexData = new uint8_t[width * height];
+    std::fill(pIndexData, pIndexData + width * height, TRANSPARENT_INDEX);
   }
 
-  ResourcePack::ResourcePack() { }
-  ResourcePack::~ResourcePack() { baseFile.close(); }
+  IndexedSprite::IndexedSprite(Sprite *sprite)
+  {
+    std::fill(palette, palette + 256, tDX::BLANK);
+    Quantize(sprite);
+  }
 
-  bool ResourcePack::AddFile(const std::string& sFile)
+  IndexedSprite::~IndexedSprite()
   {
+    if (pIndexData) delete[] pIndexData;
+  }
 
-    const std::string file = makeposix(sFile);
+  tDX::rcode IndexedSprite::Quantize(Sprite *sprite)
+  {
+    if (sprite == nullptr || sprite->GetData() == nullptr)
+      return tDX::FAIL;
 
-    if (_gfs::exists(file))
+    if (pIndexData) delete[] pIndexData;
+    width = sprite->width;	height = sprite->height;
+    pIndexData = new uint8_t[width * height];
+    std::fill(palette, palette + 256, tDX::BLANK);
+
+    // Histogram of the visible colours
+    const Pixel *src = sprite->GetData();
+    std::unordered_map<uint32_t, uint32_t> mapCount;
+    for (int32_t i = 0; i < width * height; i++)
+      if (src[i].a != 0)
+        mapCount[src[i].n]++;
+
+    struct sColour { Pixel p; uint32_t nCount; };
+    std::vector<sColour> vColours;
+    vColours.reserve(mapCount.size());
+    for (auto &c : mapCount)
+      vColours.push_back({ Pixel(c.first), c.second });
+
+    auto channel = [](const Pixel& p, int c) { return c == 0 ? p.r : c == 1 ? p.g : c == 2 ? p.b : p.a; };
+
+    // Median cut, always splitting the box with the widest channel range
+    // at its weighted median, until there is a box per palette entry
+    struct sBox { size_t nBegin; size_t nEnd; };
+    std::vector<sBox> vBoxes;
+    if (!vColours.empty())
+      vBoxes.push_back({ 0, vColours.size() });
+
+    while (vBoxes.size() < 255)
     {
-      sResourceFile e;
-      e.nSize = (uint32_t)_gfs::file_size(file);
-      e.nOffset = 0; // Unknown at this stage
-      mapFiles[file] = e;
-      return true;
-    }
-    return false;
-  }
+      int nBest = -1, nBestAxis = 0, nBestRange = 0;
+      for (size_t b = 0; b < vBoxes.size(); b++)
+      {
+        if (vBoxes[b].nEnd - vBoxes[b].nBegin < 2) continue;
+        for (int c = 0; c < 4; c++)
+        {
+          int lo = 255, hi = 0;
+          for (size_t i = vBoxes[b].nBegin; i < vBoxes[b].nEnd; i++)
+          {
+            lo = std::min(lo, (int)channel(vColours[i].p, c));
+            hi = std::max(hi, (int)channel(vColours[i].p, c));
+          }
+          if (hi - lo > nBestRange) { nBest = (int)b; nBestAxis = c; nBestRange = hi - lo; }
+        }
+      }
 
-  bool ResourcePack::LoadPack(const std::string& sFile, const std::string& sKey)
-  {
-    // Open the resource file
-    baseFile.open(sFile, std::ifstream::binary);
-    if (!baseFile.is_open()) return false;
+      // Every box holds a single colour
+      if (nBest < 0) break;
 
-    // 1) Read Scrambled index
-    uint32_t nIndexSize = 0;
-    baseFile.read((char*)&nIndexSize, sizeof(uint32_t));
+      sBox box = vBoxes[nBest];
+      std::sort(vColours.begin() + box.nBegin, vColours.begin() + box.nEnd,
+        [&](const sColour& a, const sColour& b) { return channel(a.p, nBestAxis) < channel(b.p, nBestAxis); });
 
-    std::string buffer(nIndexSize, ' ');
-    for (uint32_t j = 0; j < nIndexSize; j++)
-      buffer[j] = baseFile.get();
+      uint64_t nTotal = 0, nAccum = 0;
+      for (size_t i = box.nBegin; i < box.nEnd; i++) nTotal += vColours[i].nCount;
 
-    std::string decoded = scramble(buffer, sKey);
-    std::stringstream iss(decoded);
+      size_t m = box.nBegin;
+      while (m < box.nEnd - 1 && (nAccum += vColours[m].nCount) * 2 < nTotal) m++;
+      size_t nSplit = std::min(m + 1, box.nEnd - 1);
 
-    // 2) Read Map
-    uint32_t nMapEntries;
-    iss.read((char*)&nMapEntries, sizeof(uint32_t));
-    for (uint32_t i = 0; i < nMapEntries; i++)
+      vBoxes[nBest] = { box.nBegin, nSplit };
+      vBoxes.push_back({ nSplit, box.nEnd });
+    }
+
+    // Each box becomes the weighted average of its colours
+    std::unordered_map<uint32_t, uint8_t> mapIndex;
+    for (size_t b = 0; b < vBoxes.size(); b++)
     {
-      uint32_t nFilePathSize = 0;
-      iss.read((char*)&nFilePathSize, sizeof(uint32_t));
+      uint64_t sum[4] = { 0, 0, 0, 0 }, nTotal = 0;
+      for (size_t i = vBoxes[b].nBegin; i < vBoxes[b].nEnd; i++)
+      {
+        const sColour &c = vColours[i];
+        sum[0] += (uint64_t)c.p.r * c.nCount; sum[1] += (uint64_t)c.p.g * c.nCount;
+        sum[2] += (uint64_t)c.p.b * c.nCount; sum[3] += (uint64_t)c.p.a * c.nCount;
+        nTotal += c.nCount;
+        mapIndex[c.p.n] = (uint8_t)(b + 1);
+      }
+      palette[b + 1] = Pixel(
+        (uint8_t)((sum[0] + nTotal / 2) / nTotal), (uint8_t)((sum[1] + nTotal / 2) / nTotal),
+        (uint8_t)((sum[2] + nTotal / 2) / nTotal), (uint8_t)((sum[3] + nTotal / 2) / nTotal));
+    }
 
-      std::string sFileName(nFilePathSize, ' ');
-      for (uint32_t j = 0; j < nFilePathSize; j++)
-        sFileName[j] = iss.get();
+    for (int32_t i = 0; i < width * height; i++)
+      pIndexData[i] = src[i].a != 0 ? mapIndex[src[i].n] : TRANSPARENT_INDEX;
 
-      sResourceFile e;
-      iss.read((char*)&e.nSize, sizeof(uint32_t));
-      iss.read((char*)&e.nOffset, sizeof(uint32_t));
-      mapFiles[sFileName] = e;
-    }
+    return tDX::OK;
+  }
 
-    // Don't close base file! we will provide a stream
-    // pointer when the file is requested
-    return true;
+  Pixel IndexedSprite::GetPixel(int32_t x, int32_t y)
+  {
+    if (x >= 0 && x < width && y >= 0 && y < height)
+      return palette[pIndexData[y*width + x]];
+    else
+      return Pixel(0, 0, 0, 0);
   }
 
-  bool ResourcePack::SavePack(const std::string& sFile, const std::string& sKey)
+  uint8_t IndexedSprite::GetIndex(int32_t x, int32_t y)
   {
-    // Create/Overwrite the resource file
-    std::ofstream ofs(sFile, std::ofstream::binary);
-    if (!ofs.is_open()) return false;
+    if (x >= 0 && x < width && y >= 0 && y < height)
+      return pIndexData[y*width + x];
+    else
+      return TRANSPARENT_INDEX;
+  }
 
-    // Iterate through map
-    uint32_t nIndexSize = 0; // Unknown for now
-    ofs.write((char*)&nIndexSize, sizeof(uint32_t));
-    size_t nMapSize = mapFiles.size();
-    ofs.write((char*)&nMapSize, sizeof(uint32_t));
-    for (auto &e : mapFiles)
+  bool IndexedSprite::SetIndex(int32_t x, int32_t y, uint8_t i)
+  {
+    if (x >= 0 && x < width && y >= 0 && y < height)
+    {
+      pIndexData[y*width + x] = i;
+      return true;
+    }
+    else
+      return false;
+  }
+
+  uint8_t* IndexedSprite::GetData() { return pIndexData; }
+
+  //==========================================================
+
+  void SpriteMask::Build(const Pixel *data, int32_t w, int32_t h, uint8_t nAlphaThreshold)
+  {
+    width = w;
+    height = h;
+    nWords = (w + 63) / 64;
+    vBits.assign((size_t)nWords * h, 0);
+    nBoxX0 = w; nBoxY0 = h; nBoxX1 = -1; nBoxY1 = -1;
+
+    for (int32_t y = 0; y < h; y++)
+    {
+      uint64_t *row = vBits.data() + (size_t)y * nWords;
+      for (int32_t x = 0; x < w; x++)
+        if (data[y * w + x].a >= nAlphaThreshold)
+        {
+          row[x >> 6] |= 1ull << (x & 63);
+          nBoxX0 = std::min(nBoxX0, x); nBoxX1 = std::max(nBoxX1, x);
+          nBoxY0 = std::min(nBoxY0, y); nBoxY1 = y;
+        }
+    }
+  }
+
+  bool SpriteMask::Test(int32_t x, int32_t y) const
+  {
+    if (x < 0 || y < 0 || x >= width || y >= height) return false;
+    return (vBits[(size_t)y * nWords + (x >> 6)] >> (x & 63)) & 1;
+  }
+
+  // 64 bits of a mask row starting at bit o, which may lie outside the row
+  static uint64_t tDX_MaskBits(const uint64_t *row, int32_t nWords, int32_t o)
+  {
+    int32_t w = o >= 0 ? o / 64 : -((63 - o) / 64);
+    int32_t s = o - w * 64;
+    uint64_t lo = w >= 0 && w < nWords ? row[w] >> s : 0;
+    uint64_t hi = s != 0 && w + 1 >= 0 && w + 1 < nWords ? row[w + 1] << (64 - s) : 0;
+    return lo | hi;
+  }
+
+  bool SpriteMask::Overlap(const SpriteMask& a, const vi2d& pa, const SpriteMask& b, const vi2d& pb)
+  {
+    // Overlap of the two boxes in the coordinates of a
+    int32_t dx = pb.x - pa.x, dy = pb.y - pa.y;
+    int32_t x0 = std::max(a.nBoxX0, b.nBoxX0 + dx), x1 = std::min(a.nBoxX1, b.nBoxX1 + dx);
+    int32_t y0 = std::max(a.nBoxY0, b.nBoxY0 + dy), y1 = std::min(a.nBoxY1, b.nBoxY1 + dy);
+    if (x0 > x1 || y0 > y1) return false;
+
+    // Every word of a touching the overlap is ANDed with b's bits shifted into place
+    int32_t k0 = x0 >> 6, k1 = x1 >> 6;
+    for (int32_t y = y0; y <= y1; y++)
+    {
+      const uint64_t *ra = a.vBits.data() + (size_t)y * a.nWords;
+      const uint64_t *rb = b.vBits.data() + (size_t)(y - dy) * b.nWords;
+      for (int32_t k = k0; k <= k1; k++)
+        if (ra[k] & tDX_MaskBits(rb, b.nWords, k * 64 - dx))
+          return true;
+    }
+    return false;
+  }
+
+  //==========================================================
+
+  // Tile files start with a fixed header, the tiles follow row by row and
+  // the table of where each tile starts comes last. A tile is a table of
+  // row offsets followed by its rows, compressed like PGESpr v2 rows
+  struct sPagedHeader
+  {
+    char magic[4];
+    int32_t nWidth;
+    int32_t nHeight;
+    int32_t nTileSize;
+    uint64_t nTableOffset;
+  };
+
+  PagedSprite::PagedSprite() { }
+
+  PagedSprite::PagedSprite(const std::string& sTileFile, size_t nBudgetBytes, tDX::ResourcePack *pack)
+  {
+    Open(sTileFile, nBudgetBytes, pack);
+  }
+
+  tDX::rcode PagedSprite::WriteTileFile(const std::string& sTileFile, int32_t nTileSize, const BandFunc& fetchBand)
+  {
+    if (nTileSize <= 0) return tDX::FAIL;
+
+    std::ofstream ofs;
+    ofs.open(sTileFile, std::ofstream::binary);
+    if (!ofs.is_open())
+      return tDX::FAIL;
+
+    sPagedHeader header = { { 't', 'P', 'G', 'T' }, 0, 0, nTileSize, 0 };
+    ofs.write((char*)&header, sizeof(header));
+
+    std::vector<uint64_t> vOffsets;
+    std::vector<uint32_t> vRowOffsets;
+    std::vector<uint8_t> vData;
+    uint64_t nPos = 0;
+    const Pixel *pBand = nullptr;
+    int32_t bw = 0, bh = nTileSize;
+
+    // Bands come in until the image runs out of rows
+    for (int32_t y = 0; fetchBand(y, pBand, bw, bh); y += nTileSize, bh = nTileSize)
+    {
+      if (header.nWidth != 0 && bw != header.nWidth) return tDX::FAIL;
+      header.nWidth = bw;
+      header.nHeight = y + bh;
+
+      for (int32_t x = 0; x < bw; x += nTileSize)
+      {
+        int32_t tw = std::min(nTileSize, bw - x);
+        vRowOffsets.clear();
+        vData.clear();
+        for (int32_t j = 0; j < bh; j++)
+        {
+          vRowOffsets.push_back((uint32_t)vData.size());
+          tDX_EncodePGESprRow(pBand + j * bw + x, tw, vData);
+        }
+        vRowOffsets.push_back((uint32_t)vData.size());
+
+        vOffsets.push_back(nPos);
+        ofs.write((char*)vRowOffsets.data(), vRowOffsets.size() * sizeof(uint32_t));
+        ofs.write((char*)vData.data(), vData.size());
+        nPos += vRowOffsets.size() * sizeof(uint32_t) + vData.size();
+      }
+
+      if (bh < nTileSize) break;
+    }
+    vOffsets.push_back(nPos);
+    if (header.nWidth == 0) return tDX::FAIL;
+
+    header.nTableOffset = sizeof(header) + nPos;
+    ofs.write((char*)vOffsets.data(), vOffsets.size() * sizeof(uint64_t));
+    ofs.seekp(0);
+    ofs.write((char*)&header, sizeof(header));
+    ofs.close();
+    return ofs ? tDX::OK : tDX::FAIL;
+  }
+
+  tDX::rcode PagedSprite::BuildTileFile(const std::string& sImageFile, const std::string& sTileFile, int32_t nTileSize, tDX::ResourcePack *pack)
+  {
+    Sprite band;
+    return WriteTileFile(sTileFile, nTileSize, [&](int32_t y, const Pixel *&pBand, int32_t &w, int32_t &h)
+    {
+      // The area is clipped to the image, so an oversized width reads whole rows
+      if (band.LoadFromPGESprFile(sImageFile, 0, y, INT32_MAX / 2, h, pack) != tDX::OK) return false;
+      pBand = band.GetData();
+      w = band.width;
+      h = band.height;
+      return true;
+    });
+  }
+
+  tDX::rcode PagedSprite::BuildTileFile(Sprite *sprite, const std::string& sTileFile, int32_t nTileSize)
+  {
+    if (sprite == nullptr || sprite->GetData() == nullptr) return tDX::FAIL;
+
+    return WriteTileFile(sTileFile, nTileSize, [&](int32_t y, const Pixel *&pBand, int32_t &w, int32_t &h)
+    {
+      h = std::min(h, sprite->height - y);
+      if (h <= 0) return false;
+      pBand = sprite->GetData() + y * sprite->width;
+      w = sprite->width;
+      return true;
+    });
+  }
+
+  tDX::rcode PagedSprite::Open(const std::string& sTileFile, size_t nBudgetBytes, tDX::ResourcePack *pack)
+  {
+    vTiles.clear();
+    lstLRU.clear();
+    nResidentBytes = 0;
+    width = height = nTileSize = 0;
+
+    if (pack == nullptr)
+    {
+      auto ifs = std::make_unique<std::ifstream>(sTileFile, std::ifstream::binary);
+      if (!ifs->is_open())
+        return tDX::NO_FILE;
+      pPackBuffer.reset();
+      pStream = std::move(ifs);
+    }
+    else
+    {
+      pPackBuffer = std::make_unique<ResourceBuffer>(pack->GetFileBuffer(sTileFile));
+      pStream = std::make_unique<std::istream>(pPackBuffer.get());
+    }
+
+    sPagedHeader header = {};
+    pStream->read((char*)&header, sizeof(header));
+    if (!*pStream || memcmp(header.magic, "tPGT", 4) != 0 || header.nWidth <= 0 || header.nHeight <= 0 || header.nTileSize <= 0)
+      return tDX::FAIL;
+
+    nTilesX = (header.nWidth + header.nTileSize - 1) / header.nTileSize;
+    nTilesY = (header.nHeight + header.nTileSize - 1) / header.nTileSize;
+    vTileOffsets.resize((size_t)nTilesX * nTilesY + 1);
+    pStream->seekg((std::streamoff)header.nTableOffset);
+    pStream->read((char*)vTileOffsets.data(), vTileOffsets.size() * sizeof(uint64_t));
+    if (!*pStream)
+      return tDX::FAIL;
+
+    width = header.nWidth;
+    height = header.nHeight;
+    nTileSize = header.nTileSize;
+    nDataStart = sizeof(header);
+    vTiles.resize((size_t)nTilesX * nTilesY);
+    size_t nTileBytes = (size_t)nTileSize * nTileSize * sizeof(Pixel);
+    nMaxResident = std::max<size_t>(1, nBudgetBytes / nTileBytes);
+    nPrefetchMargin = nTileSize;
+    return tDX::OK;
+  }
+
+  void PagedSprite::SetPrefetch(int32_t nMargin, int32_t nMaxLoads)
+  {
+    nPrefetchMargin = std::max(nMargin, 0);
+    nPrefetchLoads = std::max(nMaxLoads, 0);
+  }
+
+  int32_t PagedSprite::GetTileWidth(int32_t tx)
+  {
+    return std::min(nTileSize, width - tx * nTileSize);
+  }
+
+  int32_t PagedSprite::GetTileHeight(int32_t ty)
+  {
+    return std::min(nTileSize, height - ty * nTileSize);
+  }
+
+  size_t PagedSprite::GetResidentBytes()
+  {
+    return nResidentBytes;
+  }
+
+  bool PagedSprite::LoadTile(int32_t nTile)
+  {
+    sTile &tile = vTiles[nTile];
+    int32_t tw = GetTileWidth(nTile % nTilesX);
+    int32_t th = GetTileHeight(nTile / nTilesX);
+
+    // Make room first, the evicted pixels are reused for the new tile
+    if (lstLRU.size() >= nMaxResident)
+    {
+      sTile &old = vTiles[lstLRU.back()];
+      lstLRU.pop_back();
+      old.bResident = false;
+      nResidentBytes -= old.vPixels.size() * sizeof(Pixel);
+      tile.vPixels.swap(old.vPixels);
+      old.vPixels.clear();
+    }
+
+    auto fail = [&]()
+    {
+      std::vector<Pixel>().swap(tile.vPixels);
+      return false;
+    };
+
+    uint64_t nStart = vTileOffsets[nTile], nEnd = vTileOffsets[nTile + 1];
+    size_t nTable = (size_t)(th + 1) * sizeof(uint32_t);
+    if (nEnd < nStart + nTable) return fail();
+    vTileBlob.resize((size_t)(nEnd - nStart));
+    pStream->clear();
+    pStream->seekg((std::streamoff)(nDataStart + nStart));
+    pStream->read((char*)vTileBlob.data(), vTileBlob.size());
+    if (!*pStream) return fail();
+
+    const uint32_t *pRows = (const uint32_t*)vTileBlob.data();
+    const uint8_t *pData = vTileBlob.data() + nTable;
+    size_t nData = vTileBlob.size() - nTable;
+    tile.vPixels.resize((size_t)tw * th);
+    for (int32_t j = 0; j < th; j++)
+    {
+      if (pRows[j + 1] < pRows[j] || pRows[j + 1] > nData) return fail();
+      if (!tDX_DecodePGESprRow(pData + pRows[j], pRows[j + 1] - pRows[j], tile.vPixels.data() + j * tw, tw)) return fail();
+    }
+
+    lstLRU.push_front(nTile);
+    tile.itLRU = lstLRU.begin();
+    tile.bResident = true;
+    nResidentBytes += tile.vPixels.size() * sizeof(Pixel);
+    return true;
+  }
+
+  const Pixel* PagedSprite::GetTile(int32_t tx, int32_t ty)
+  {
+    if (tx < 0 || ty < 0 || tx >= nTilesX || ty >= nTilesY)
+      return nullptr;
+
+    int32_t nTile = ty * nTilesX + tx;
+    sTile &tile = vTiles[nTile];
+    if (tile.bResident)
+    {
+      lstLRU.splice(lstLRU.begin(), lstLRU, tile.itLRU);
+      return tile.vPixels.data();
+    }
+    return LoadTile(nTile) ? tile.vPixels.data() : nullptr;
+  }
+
+  Pixel PagedSprite::GetPixel(int32_t x, int32_t y)
+  {
+    if (x < 0 || y < 0 || x >= width || y >= height)
+      return Pixel(0, 0, 0, 0);
+
+    const Pixel *pTile = GetTile(x / nTileSize, y / nTileSize);
+    if (pTile == nullptr)
+      return Pixel(0, 0, 0, 0);
+    return pTile[(y % nTileSize) * GetTileWidth(x / nTileSize) + x % nTileSize];
+  }
+
+  void PagedSprite::Prefetch(int32_t x, int32_t y, int32_t w, int32_t h)
+  {
+    if (vTiles.empty() || nPrefetchLoads == 0) return;
+
+    int32_t tx0 = std::max(x - nPrefetchMargin, 0) / nTileSize;
+    int32_t ty0 = std::max(y - nPrefetchMargin, 0) / nTileSize;
+    int32_t tx1 = std::min(x + w + nPrefetchMargin, width) - 1;
+    int32_t ty1 = std::min(y + h + nPrefetchMargin, height) - 1;
+    if (tx1 < 0 || ty1 < 0) return;
+    tx1 /= nTileSize;
+    ty1 /= nTileSize;
+
+    // When the grown area does not fit the budget, prefetching would only
+    // evict tiles that are on screen
+    if ((size_t)(tx1 - tx0 + 1) * (ty1 - ty0 + 1) > nMaxResident)
+      return;
+
+    int32_t nLoads = 0;
+    for (int32_t ty = ty0; ty <= ty1; ty++)
+      for (int32_t tx = tx0; tx <= tx1; tx++)
+      {
+        if (nLoads >= nPrefetchLoads)
+          return;
+        if (vTiles[ty * nTilesX + tx].bResident) continue;
+        LoadTile(ty * nTilesX + tx);
+        nLoads++;
+      }
+  }
+
+  // Expands a row of palette indices into pixels. TRANSPARENT_INDEX is always
+  // skipped, as in the other modes, and with bMask set only fully opaque palette
+  // entries are written
+  static void tDX_ExpandIndexedRow(Pixel *dst, const uint8_t *src, int32_t n, const Pixel *palette, bool bMask)
+  {
+    int32_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i opaque = _mm256_set1_epi32((int)0xFF000000);
+    const __m256i clear = _mm256_set1_epi32(IndexedSprite::TRANSPARENT_INDEX);
+    for (; i + 8 <= n; i += 8)
+    {
+      __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+      __m256i col = _mm256_i32gather_epi32((const int*)palette, idx, 4);
+      __m256i skip = _mm256_cmpeq_epi32(idx, clear);
+      if (bMask)
+        skip = _mm256_or_si256(skip, _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_and_si256(col, opaque), opaque), _mm256_set1_epi32(-1)));
+      col = _mm256_blendv_epi8(col, _mm256_loadu_si256((const __m256i*)(dst + i)), skip);
+      _mm256_storeu_si256((__m256i*)(dst + i), col);
+    }
+#elif defined(T_PGE_SSE2)
+    // No gather before AVX2, but the masked store still goes four at a time
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+    const __m128i clear = _mm_set1_epi32(IndexedSprite::TRANSPARENT_INDEX);
+    for (; i + 4 <= n; i += 4)
+    {
+      __m128i col = _mm_set_epi32((int)palette[src[i + 3]].n, (int)palette[src[i + 2]].n, (int)palette[src[i + 1]].n, (int)palette[src[i]].n);
+      __m128i skip = _mm_cmpeq_epi32(_mm_set_epi32(src[i + 3], src[i + 2], src[i + 1], src[i]), clear);
+      if (bMask)
+        skip = _mm_or_si128(skip, _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(col, opaque), opaque), _mm_set1_epi32(-1)));
+      __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+      col = _mm_or_si128(_mm_andnot_si128(skip, col), _mm_and_si128(skip, d));
+      _mm_storeu_si128((__m128i*)(dst + i), col);
+    }
+#endif
+
+    for (; i < n; i++)
+    {
+      Pixel p = palette[src[i]];
+      if (src[i] != IndexedSprite::TRANSPARENT_INDEX && (!bMask || p.a == 255)) dst[i] = p;
+    }
+  }
+
+  //==========================================================
+  // Resource Packs - Allows you to store files in one large
+  // scrambled file
+
+
+  ResourceBuffer::ResourceBuffer(std::ifstream &ifs, uint32_t offset, uint32_t size)
+  {
+    vMemory.resize(size);
+    ifs.seekg(offset); ifs.read(vMemory.data(), vMemory.size());
+    setg(vMemory.data(), vMemory.data(), vMemory.data() + size);
+  }
+
+  std::streampos ResourceBuffer::seekoff(std::streamoff off, std::ios_base::seekdir dir, std::ios_base::openmode which)
+  {
+    UNUSED(which);
+    char *base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+    if (off < eback() - base || off > egptr() - base)
+      return std::streampos(std::streamoff(-1));
+
+    setg(eback(), base + off, egptr());
+    return std::streampos(gptr() - eback());
+  }
+
+  std::streampos ResourceBuffer::seekpos(std::streampos pos, std::ios_base::openmode which)
+  {
+    return seekoff(std::streamoff(pos), std::ios_base::beg, which);
+  }
+
+  ResourcePack::ResourcePack() { }
+  ResourcePack::~ResourcePack() { baseFile.close(); }
+
+  bool ResourcePack::AddFile(const std::string& sFile)
+  {
+
+    const std::string file = makeposix(sFile);
+
+    if (_gfs::exists(file))
+    {
+      sResourceFile e;
+      e.nSize = (uint32_t)_gfs::file_size(file);
+      e.nOffset = 0; // Unknown at this stage
+      mapFiles[file] = e;
+      return true;
+    }
+    return false;
+  }
+
+  bool ResourcePack::LoadPack(const std::string& sFile, const std::string& sKey)
+  {
+    // Open the resource file
+    baseFile.open(sFile, std::ifstream::binary);
+    if (!baseFile.is_open()) return false;
+
+    // 1) Read Scrambled index
+    uint32_t nIndexSize = 0;
+    baseFile.read((char*)&nIndexSize, sizeof(uint32_t));
+
+    std::string buffer(nIndexSize, ' ');
+    for (uint32_t j = 0; j < nIndexSize; j++)
+      buffer[j] = baseFile.get();
+
+    std::string decoded = scramble(buffer, sKey);
+    std::stringstream iss(decoded);
+
+    // 2) Read Map
+    uint32_t nMapEntries;
+    iss.read((char*)&nMapEntries, sizeof(uint32_t));
+    for (uint32_t i = 0; i < nMapEntries; i++)
+    {
+      uint32_t nFilePathSize = 0;
+      iss.read((char*)&nFilePathSize, sizeof(uint32_t));
+
+      std::string sFileName(nFilePathSize, ' ');
+      for (uint32_t j = 0; j < nFilePathSize; j++)
+        sFileName[j] = iss.get();
+
+      sResourceFile e;
+      iss.read((char*)&e.nSize, sizeof(uint32_t));
+      iss.read((char*)&e.nOffset, sizeof(uint32_t));
+      mapFiles[sFileName] = e;
+    }
+
+    // Don't close base file! we will provide a stream
+    // pointer when the file is requested
+    return true;
+  }
+
+  bool ResourcePack::SavePack(const std::string& sFile, const std::string& sKey)
+  {
+    // Create/Overwrite the resource file
+    std::ofstream ofs(sFile, std::ofstream::binary);
+    if (!ofs.is_open()) return false;
+
+    // Iterate through map
+    uint32_t nIndexSize = 0; // Unknown for now
+    ofs.write((char*)&nIndexSize, sizeof(uint32_t));
+    size_t nMapSize = mapFiles.size();
+    ofs.write((char*)&nMapSize, sizeof(uint32_t));
+    for (auto &e : mapFiles)
     {
       // Write the path of the file
       size_t nPathSize = e.first.size();
@@ -888,12 +1954,97 @@ namespace tDX
 
   //==========================================================
 
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mux);
+      bQuit = true;
+    }
+    cvWork.notify_all();
+    for (auto &t : vWorkers) t.join();
+  }
+
+  int32_t ThreadPool::GetThreadCount()
+  {
+    return std::max(1, (int32_t)std::thread::hardware_concurrency());
+  }
+
+  void ThreadPool::Run(int32_t nJobs, const std::function<void(int32_t)>& job)
+  {
+    if (nJobs <= 0) return;
+    if (nJobs == 1)
+    {
+      job(0);
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mux);
+    size_t nWanted = (size_t)std::min(nJobs, GetThreadCount()) - 1;
+    while (vWorkers.size() < nWanted)
+      vWorkers.emplace_back(&ThreadPool::tDX_Worker, this);
+
+    pJob = &job;
+    this->nJobs = nJobs;
+    nNext = 0;
+    nPending = nJobs;
+    cvWork.notify_all();
+
+    // The calling thread takes jobs as well instead of just waiting
+    while (tDX_RunNext(lock));
+    cvDone.wait(lock, [&] { return nPending == 0; });
+
+    pJob = nullptr;
+    this->nJobs = 0;
+  }
+
+  // Runs the next job with the lock released, false when none are left
+  bool ThreadPool::tDX_RunNext(std::unique_lock<std::mutex>& lock)
+  {
+    if (nNext >= nJobs) return false;
+
+    int32_t i = nNext++;
+    const std::function<void(int32_t)>* job = pJob;
+    lock.unlock();
+    (*job)(i);
+    lock.lock();
+
+    if (--nPending == 0)
+      cvDone.notify_all();
+    return true;
+  }
+
+  void ThreadPool::tDX_Worker()
+  {
+    std::unique_lock<std::mutex> lock(mux);
+    while (true)
+    {
+      cvWork.wait(lock, [&] { return bQuit || nNext < nJobs; });
+      if (bQuit) return;
+      tDX_RunNext(lock);
+    }
+  }
+
+  ThreadPool& PixelGameEngine::GetThreadPool()
+  {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  //==========================================================
+
   PixelGameEngine::PixelGameEngine()
   {
     sAppName = "Undefined";
     tDX::PGEX::pge = this;
   }
 
+  PixelGameEngine::~PixelGameEngine()
+  {
+    // Sprites outliving the engine must not look for its queue
+    if (tDX::PGEX::pge == this)
+      tDX::PGEX::pge = nullptr;
+  }
+
   tDX::rcode PixelGameEngine::Construct(uint32_t screen_w, uint32_t screen_h, uint32_t pixel_w, uint32_t pixel_h, bool full_screen, bool vsync)
   {
     nScreenWidth = screen_w;
@@ -924,6 +2075,7 @@ namespace tDX
 
   void PixelGameEngine::SetScreenSize(int w, int h)
   {
+    tDX_FlushSprites();
     delete pDefaultDrawTarget;
     nScreenWidth = w;
     nScreenHeight = h;
@@ -1124,11 +2276,17 @@ namespace tDX
 
 #ifdef T_DBG_OVERDRAW
         tDX::Sprite::nOverdrawCount = 0;
+        tDX_BeginOverdrawFrame();
 #endif
 
         // Handle Frame Update
         if (!OnUserUpdate(fElapsedTime))
           bActive = false;
+        tDX_FlushSprites();
+
+#ifdef T_DBG_OVERDRAW
+        tDX_EndOverdrawFrame();
+#endif
 
         // Update texture to be rendered
         D3D11_MAPPED_SUBRESOURCE mappedTexture = {};
@@ -1136,6 +2294,10 @@ namespace tDX
 
         BYTE* mappedData = reinterpret_cast<BYTE*>(mappedTexture.pData);
         tDX::Pixel* sourceData = pDrawTarget->GetData();
+#ifdef T_DBG_OVERDRAW
+        if (pDrawTarget == pDefaultDrawTarget && vHeatmapFrame.size() == (size_t)pDrawTarget->width * pDrawTarget->height)
+          sourceData = vHeatmapFrame.data();
+#endif
 
         for (int row = 0; row < pDrawTarget->height; row++)
         {
@@ -1160,6 +2322,9 @@ namespace tDX
           fFrameTimer -= 1.0f;
 
           std::string sTitle = "tucna.net - Pixel Game Engine - " + sAppName + " - FPS: " + std::to_string(nFrameCount);
+#ifdef T_DBG_OVERDRAW
+          sTitle += " - Overdraw: " + std::to_string(overdrawStats.fOverdraw);
+#endif
 
 #ifdef UNICODE
           SetWindowText(tDX_hWnd, ConvertS2W(sTitle).c_str());
@@ -1194,6 +2359,7 @@ namespace tDX
 
   void PixelGameEngine::SetDrawTarget(Sprite *target)
   {
+    tDX_FlushSprites();
     if (target)
       pDrawTarget = target;
     else
@@ -1226,39 +2392,277 @@ namespace tDX
     return bHasInputFocus;
   }
 
-  HWButton PixelGameEngine::GetKey(Key k)
+  HWButton PixelGameEngine::GetKey(Key k)
+  {
+    return pKeyboardState[k];
+  }
+
+  HWButton PixelGameEngine::GetMouse(uint32_t b)
+  {
+    return pMouseState[b];
+  }
+
+  int32_t PixelGameEngine::GetMouseX()
+  {
+    return nMousePosX;
+  }
+
+  int32_t PixelGameEngine::GetMouseY()
+  {
+    return nMousePosY;
+  }
+
+  int32_t PixelGameEngine::GetMouseWheel()
+  {
+    return nMouseWheelDelta;
+  }
+
+  int32_t PixelGameEngine::ScreenWidth()
+  {
+    return nScreenWidth;
+  }
+
+  int32_t PixelGameEngine::ScreenHeight()
+  {
+    return nScreenHeight;
+  }
+
+  //==========================================================
+  // Span writers - the primitives choose one for the current
+  // pixel mode up front, so the inner loops skip the virtual
+  // Draw and its mode checks
+
+  template <int MODE>
+  struct PixelGameEngine::SpanWriter
+  {
+    PixelGameEngine *pge;
+    Pixel *pData;
+    int32_t nPitch;
+    int32_t nWidth;
+    int32_t nHeight;
+    float fBlend;
+
+    inline void Put(int32_t x, int32_t y, Pixel *d, Pixel p) const
+    {
+      if constexpr (MODE == Pixel::Mode::MASK)
+      {
+        if (p.a != 255) return;
+        *d = p;
+      }
+      else if constexpr (MODE == Pixel::Mode::ALPHA)
+      {
+        float a = (float)(p.a / 255.0f) * fBlend;
+        float c = 1.0f - a;
+        float r = a * (float)p.r + c * (float)d->r;
+        float g = a * (float)p.g + c * (float)d->g;
+        float b = a * (float)p.b + c * (float)d->b;
+        *d = Pixel((uint8_t)r, (uint8_t)g, (uint8_t)b);
+      }
+      else if constexpr (MODE == Pixel::Mode::CUSTOM)
+        *d = pge->funcPixelMode(x, y, p, *d);
+      else
+        *d = p;
+
+#ifdef T_DBG_OVERDRAW
+      Sprite::nOverdrawCount++;
+      pge->tDX_CountOverdraw(x, y);
+#endif
+    }
+
+    // Single pixel, dropped when it falls outside the target
+    inline void Plot(int32_t x, int32_t y, Pixel p) const
+    {
+      if constexpr (MODE == DRAW_OVERRIDE)
+        pge->Draw(x, y, p);
+      else if ((uint32_t)x < (uint32_t)nWidth && (uint32_t)y < (uint32_t)nHeight)
+        Put(x, y, pData + y * nPitch + x, p);
+    }
+
+    // Horizontal run from x0 to x1 inclusive, clipped to the target
+    inline void Span(int32_t x0, int32_t x1, int32_t y, Pixel p) const
+    {
+      if constexpr (MODE == DRAW_OVERRIDE)
+      {
+        for (int32_t x = x0; x <= x1; x++)
+          pge->Draw(x, y, p);
+      }
+      else
+      {
+        if ((uint32_t)y >= (uint32_t)nHeight) return;
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, nWidth - 1);
+        if (x1 < x0) return;
+
+        Pixel *d = pData + y * nPitch + x0;
+#ifndef T_DBG_OVERDRAW
+        if constexpr (MODE == Pixel::Mode::NORMAL)
+        {
+          std::fill(d, d + (x1 - x0 + 1), p);
+          return;
+        }
+#endif
+        for (int32_t x = x0; x <= x1; x++, d++)
+          Put(x, y, d, p);
+      }
+    }
+  };
+
+  template <class F>
+  void PixelGameEngine::tDX_Dispatch(F&& fn)
   {
-    return pKeyboardState[k];
-  }
+    if (!pDrawTarget) return;
+    if (!vSpriteQueue.empty()) tDX_FlushSprites();
 
-  HWButton PixelGameEngine::GetMouse(uint32_t b)
-  {
-    return pMouseState[b];
+    Pixel *data = pDrawTarget->GetData();
+    int32_t pitch = pDrawTarget->width;
+    int32_t w = pDrawTarget->width;
+    int32_t h = pDrawTarget->height;
+
+    if (bDrawOverride)
+    {
+      fn(SpanWriter<DRAW_OVERRIDE>{ this, data, pitch, w, h, fBlendFactor });
+      return;
+    }
+
+    switch (nPixelMode)
+    {
+    case Pixel::Mode::NORMAL: fn(SpanWriter<Pixel::Mode::NORMAL>{ this, data, pitch, w, h, fBlendFactor }); break;
+    case Pixel::Mode::MASK:   fn(SpanWriter<Pixel::Mode::MASK>{ this, data, pitch, w, h, fBlendFactor }); break;
+    case Pixel::Mode::ALPHA:  fn(SpanWriter<Pixel::Mode::ALPHA>{ this, data, pitch, w, h, fBlendFactor }); break;
+    case Pixel::Mode::CUSTOM: fn(SpanWriter<Pixel::Mode::CUSTOM>{ this, data, pitch, w, h, fBlendFactor }); break;
+    }
   }
 
-  int32_t PixelGameEngine::GetMouseX()
+  void PixelGameEngine::EnableDrawOverride(bool bEnable)
   {
-    return nMousePosX;
+    tDX_FlushSprites();
+    bDrawOverride = bEnable;
   }
 
-  int32_t PixelGameEngine::GetMouseY()
+  void PixelGameEngine::EnableSpriteOcclusion(bool bEnable)
   {
-    return nMousePosY;
+    tDX_FlushSprites();
+    bSpriteOcclusion = bEnable;
   }
 
-  int32_t PixelGameEngine::GetMouseWheel()
+  void PixelGameEngine::FlushSprites()
   {
-    return nMouseWheelDelta;
+    tDX_FlushSprites();
   }
 
-  int32_t PixelGameEngine::ScreenWidth()
+  // Queues the draw if it can take part in the front to back pass, that is an
+  // unscaled area inside the sprite drawn opaque or masked. ALPHA mode counts as
+  // masked for sprites that only have fully opaque and fully clear pixels
+  bool PixelGameEngine::tDX_QueueSprite(int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale)
   {
-    return nScreenWidth;
+    if (!bSpriteOcclusion || bDrawOverride || scale != 1 || !pDrawTarget || !sprite->pColData)
+      return false;
+    if (ox < 0 || oy < 0 || ox + w > sprite->width || oy + h > sprite->height)
+      return false;
+
+    bool bMask;
+    if (nPixelMode == Pixel::Mode::NORMAL)
+      bMask = false;
+    else if (nPixelMode == Pixel::Mode::MASK || (nPixelMode == Pixel::Mode::ALPHA && fBlendFactor == 1.0f))
+    {
+      Sprite::Opacity o = sprite->GetOpacity();
+      if (o == Sprite::Opacity::BLENDED && nPixelMode == Pixel::Mode::ALPHA)
+        return false;
+      bMask = o != Sprite::Opacity::SOLID;
+    }
+    else
+      return false;
+
+    sQueuedSprite q;
+    q.sprite = sprite;
+    q.x0 = std::max(x, 0);
+    q.y0 = std::max(y, 0);
+    q.x1 = std::min(x + w, pDrawTarget->width);
+    q.y1 = std::min(y + h, pDrawTarget->height);
+    q.sx = ox + q.x0 - x;
+    q.sy = oy + q.y0 - y;
+    q.bMask = bMask;
+    if (q.x0 < q.x1 && q.y0 < q.y1)
+    {
+      vSpriteQueue.push_back(q);
+      sprite->bQueued = true;
+    }
+    return true;
   }
 
-  int32_t PixelGameEngine::ScreenHeight()
+  // Paints the queue from the last draw to the first. Each 8x8 tile of the target
+  // keeps a 64 bit mask of the pixels already written, so a pixel is only written
+  // by the front most sprite covering it and full tiles are skipped altogether
+  void PixelGameEngine::tDX_FlushSprites()
   {
-    return nScreenHeight;
+    if (vSpriteQueue.empty())
+      return;
+
+    T_OVERDRAW_SCOPE(SPRITE);
+    // Not through GetData, which would flush again
+    Pixel *data = pDrawTarget->pColData;
+    pDrawTarget->opacity = Sprite::Opacity::UNKNOWN;
+    pDrawTarget->bMaskValid = false;
+    int32_t nPitch = pDrawTarget->width;
+    int32_t nTilesX = (pDrawTarget->width + 7) / 8;
+    size_t nTiles = (size_t)nTilesX * ((pDrawTarget->height + 7) / 8);
+    if (nCoverageTilesX != nTilesX || vCoverage.size() != nTiles)
+    {
+      vCoverage.assign(nTiles, 0);
+      nCoverageTilesX = nTilesX;
+    }
+
+    int32_t tx0 = nTilesX, ty0 = INT32_MAX, tx1 = 0, ty1 = 0;
+
+    for (auto q = vSpriteQueue.rbegin(); q != vSpriteQueue.rend(); ++q)
+    {
+      const Pixel *src = q->sprite->pColData;
+      int32_t nSrcWidth = q->sprite->width;
+      tx0 = std::min(tx0, q->x0 >> 3); tx1 = std::max(tx1, (q->x1 - 1) >> 3);
+      ty0 = std::min(ty0, q->y0 >> 3); ty1 = std::max(ty1, (q->y1 - 1) >> 3);
+
+      for (int32_t ty = q->y0 >> 3; ty <= (q->y1 - 1) >> 3; ty++)
+        for (int32_t tx = q->x0 >> 3; tx <= (q->x1 - 1) >> 3; tx++)
+        {
+          uint64_t &cov = vCoverage[ty * nTilesX + tx];
+          if (cov == ~0ull) continue;
+
+          int32_t px0 = std::max(q->x0, tx * 8), px1 = std::min(q->x1, tx * 8 + 8);
+          int32_t py0 = std::max(q->y0, ty * 8), py1 = std::min(q->y1, ty * 8 + 8);
+          uint32_t nRowBits = ((1u << (px1 - px0)) - 1) << (px0 & 7);
+
+          for (int32_t py = py0; py < py1; py++)
+          {
+            int32_t nShift = (py & 7) * 8;
+            uint32_t nDone = (uint32_t)(cov >> nShift) & 0xFF;
+            uint32_t nTodo = nRowBits & ~nDone;
+            if (nTodo == 0) continue;
+
+            Pixel *d = data + py * nPitch + tx * 8;
+            const Pixel *s = src + (py - q->y0 + q->sy) * nSrcWidth + q->sx;
+            for (int32_t b = px0 & 7, px = px0; px < px1; b++, px++)
+            {
+              if (!(nTodo & (1u << b))) continue;
+              Pixel p = s[px - q->x0];
+              if (q->bMask && p.a != 255) continue;
+              d[b] = p;
+              nDone |= 1u << b;
+#ifdef T_DBG_OVERDRAW
+              Sprite::nOverdrawCount++;
+              tDX_CountOverdraw(px, py);
+#endif
+            }
+            cov |= (uint64_t)nDone << nShift;
+          }
+        }
+    }
+
+    // Only the tiles touched are cleared for the next pass
+    for (int32_t ty = ty0; ty <= ty1; ty++)
+      std::fill(vCoverage.begin() + ty * nTilesX + tx0, vCoverage.begin() + ty * nTilesX + tx1 + 1, 0);
+    for (auto &q : vSpriteQueue)
+      q.sprite->bQueued = false;
+    vSpriteQueue.clear();
   }
 
   bool PixelGameEngine::Draw(const tDX::vi2d& pos, Pixel p)
@@ -1269,6 +2673,12 @@ namespace tDX
   bool PixelGameEngine::Draw(int32_t x, int32_t y, Pixel p)
   {
     if (!pDrawTarget) return false;
+    if (!vSpriteQueue.empty()) tDX_FlushSprites();
+
+#ifdef T_DBG_OVERDRAW
+    if (nPixelMode != Pixel::Mode::MASK || p.a == 255)
+      tDX_CountOverdraw(x, y);
+#endif
 
     if (nPixelMode == Pixel::Mode::NORMAL)
     {
@@ -1313,87 +2723,94 @@ namespace tDX
 
   void PixelGameEngine::DrawLine(int32_t x1, int32_t y1, int32_t x2, int32_t y2, Pixel p, uint32_t pattern)
   {
-    int x, y, dx, dy, dx1, dy1, px, py, xe, ye, i;
-    dx = x2 - x1; dy = y2 - y1;
-
-    auto rol = [&](void)
-    {
-      pattern = (pattern << 1) | (pattern >> 31);
-      return pattern & 1;
-    };
-
-    // straight lines idea by gurkanctn
-    if (dx == 0) // Line is vertical
+    T_OVERDRAW_SCOPE(LINE);
+    tDX_Dispatch([&](const auto &out)
     {
-      if (y2 < y1) std::swap(y1, y2);
-      for (y = y1; y <= y2; y++)
-        if (rol()) Draw(x1, y, p);
-      return;
-    }
+      int x, y, dx, dy, dx1, dy1, px, py, xe, ye, i;
+      dx = x2 - x1; dy = y2 - y1;
 
-    if (dy == 0) // Line is horizontal
-    {
-      if (x2 < x1) std::swap(x1, x2);
-      for (x = x1; x <= x2; x++)
-        if (rol()) Draw(x, y1, p);
-      return;
-    }
+      auto rol = [&](void)
+      {
+        pattern = (pattern << 1) | (pattern >> 31);
+        return pattern & 1;
+      };
 
-    // Line is Funk-aye
-    dx1 = abs(dx); dy1 = abs(dy);
-    px = 2 * dy1 - dx1;	py = 2 * dx1 - dy1;
-    if (dy1 <= dx1)
-    {
-      if (dx >= 0)
+      // straight lines idea by gurkanctn
+      if (dx == 0) // Line is vertical
       {
-        x = x1; y = y1; xe = x2;
+        if (y2 < y1) std::swap(y1, y2);
+        for (y = y1; y <= y2; y++)
+          if (rol()) out.Plot(x1, y, p);
+        return;
       }
-      else
+
+      if (dy == 0) // Line is horizontal
       {
-        x = x2; y = y2; xe = x1;
+        if (x2 < x1) std::swap(x1, x2);
+        if (pattern == 0xFFFFFFFF)
+          out.Span(x1, x2, y1, p);
+        else
+          for (x = x1; x <= x2; x++)
+            if (rol()) out.Plot(x, y1, p);
+        return;
       }
 
-      if (rol()) Draw(x, y, p);
-
-      for (i = 0; x < xe; i++)
+      // Line is Funk-aye
+      dx1 = abs(dx); dy1 = abs(dy);
+      px = 2 * dy1 - dx1;	py = 2 * dx1 - dy1;
+      if (dy1 <= dx1)
       {
-        x = x + 1;
-        if (px < 0)
-          px = px + 2 * dy1;
+        if (dx >= 0)
+        {
+          x = x1; y = y1; xe = x2;
+        }
         else
         {
-          if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) y = y + 1; else y = y - 1;
-          px = px + 2 * (dy1 - dx1);
+          x = x2; y = y2; xe = x1;
+        }
+
+        if (rol()) out.Plot(x, y, p);
+
+        for (i = 0; x < xe; i++)
+        {
+          x = x + 1;
+          if (px < 0)
+            px = px + 2 * dy1;
+          else
+          {
+            if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) y = y + 1; else y = y - 1;
+            px = px + 2 * (dy1 - dx1);
+          }
+          if (rol()) out.Plot(x, y, p);
         }
-        if (rol()) Draw(x, y, p);
-      }
-    }
-    else
-    {
-      if (dy >= 0)
-      {
-        x = x1; y = y1; ye = y2;
       }
       else
       {
-        x = x2; y = y2; ye = y1;
-      }
+        if (dy >= 0)
+        {
+          x = x1; y = y1; ye = y2;
+        }
+        else
+        {
+          x = x2; y = y2; ye = y1;
+        }
 
-      if (rol()) Draw(x, y, p);
+        if (rol()) out.Plot(x, y, p);
 
-      for (i = 0; y < ye; i++)
-      {
-        y = y + 1;
-        if (py <= 0)
-          py = py + 2 * dx1;
-        else
+        for (i = 0; y < ye; i++)
         {
-          if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) x = x + 1; else x = x - 1;
-          py = py + 2 * (dx1 - dy1);
+          y = y + 1;
+          if (py <= 0)
+            py = py + 2 * dx1;
+          else
+          {
+            if ((dx < 0 && dy < 0) || (dx > 0 && dy > 0)) x = x + 1; else x = x - 1;
+            py = py + 2 * (dx1 - dy1);
+          }
+          if (rol()) out.Plot(x, y, p);
         }
-        if (rol()) Draw(x, y, p);
       }
-    }
+    });
   }
 
   void PixelGameEngine::DrawCircle(const tDX::vi2d& pos, int32_t radius, Pixel p, uint8_t mask)
@@ -1403,24 +2820,28 @@ namespace tDX
 
   void PixelGameEngine::DrawCircle(int32_t x, int32_t y, int32_t radius, Pixel p, uint8_t mask)
   {
+    T_OVERDRAW_SCOPE(CIRCLE);
     int x0 = 0;
     int y0 = radius;
     int d = 3 - 2 * radius;
     if (!radius) return;
 
-    while (y0 >= x0) // only formulate 1/8 of circle
-    {
-      if (mask & 0x01) Draw(x + x0, y - y0, p);
-      if (mask & 0x02) Draw(x + y0, y - x0, p);
-      if (mask & 0x04) Draw(x + y0, y + x0, p);
-      if (mask & 0x08) Draw(x + x0, y + y0, p);
-      if (mask & 0x10) Draw(x - x0, y + y0, p);
-      if (mask & 0x20) Draw(x - y0, y + x0, p);
-      if (mask & 0x40) Draw(x - y0, y - x0, p);
-      if (mask & 0x80) Draw(x - x0, y - y0, p);
-      if (d < 0) d += 4 * x0++ + 6;
-      else d += 4 * (x0++ - y0--) + 10;
-    }
+    tDX_Dispatch([&](const auto &out)
+    {
+      while (y0 >= x0) // only formulate 1/8 of circle
+      {
+        if (mask & 0x01) out.Plot(x + x0, y - y0, p);
+        if (mask & 0x02) out.Plot(x + y0, y - x0, p);
+        if (mask & 0x04) out.Plot(x + y0, y + x0, p);
+        if (mask & 0x08) out.Plot(x + x0, y + y0, p);
+        if (mask & 0x10) out.Plot(x - x0, y + y0, p);
+        if (mask & 0x20) out.Plot(x - y0, y + x0, p);
+        if (mask & 0x40) out.Plot(x - y0, y - x0, p);
+        if (mask & 0x80) out.Plot(x - x0, y - y0, p);
+        if (d < 0) d += 4 * x0++ + 6;
+        else d += 4 * (x0++ - y0--) + 10;
+      }
+    });
   }
 
   void PixelGameEngine::FillCircle(const tDX::vi2d& pos, int32_t radius, Pixel p)
@@ -1430,28 +2851,31 @@ namespace tDX
 
   void PixelGameEngine::FillCircle(int32_t x, int32_t y, int32_t radius, Pixel p)
   {
+    T_OVERDRAW_SCOPE(CIRCLE);
     // Taken from wikipedia
     int x0 = 0;
     int y0 = radius;
     int d = 3 - 2 * radius;
     if (!radius) return;
 
-    auto drawline = [&](int sx, int ex, int ny)
+    tDX_Dispatch([&](const auto &out)
     {
-      for (int i = sx; i <= ex; i++)
-        Draw(i, ny, p);
-    };
+      auto drawline = [&](int sx, int ex, int ny)
+      {
+        out.Span(sx, ex, ny, p);
+      };
 
-    while (y0 >= x0)
-    {
-      // Modified to draw scan-lines instead of edges
-      drawline(x - x0, x + x0, y - y0);
-      drawline(x - y0, x + y0, y - x0);
-      drawline(x - x0, x + x0, y + y0);
-      drawline(x - y0, x + y0, y + x0);
-      if (d < 0) d += 4 * x0++ + 6;
-      else d += 4 * (x0++ - y0--) + 10;
-    }
+      while (y0 >= x0)
+      {
+        // Modified to draw scan-lines instead of edges
+        drawline(x - x0, x + x0, y - y0);
+        drawline(x - y0, x + y0, y - x0);
+        drawline(x - x0, x + x0, y + y0);
+        drawline(x - y0, x + y0, y + x0);
+        if (d < 0) d += 4 * x0++ + 6;
+        else d += 4 * (x0++ - y0--) + 10;
+      }
+    });
   }
 
   void PixelGameEngine::DrawRect(const tDX::vi2d& pos, const tDX::vi2d& size, Pixel p)
@@ -1461,6 +2885,7 @@ namespace tDX
 
   void PixelGameEngine::DrawRect(int32_t x, int32_t y, int32_t w, int32_t h, Pixel p)
   {
+    T_OVERDRAW_SCOPE(RECT);
     DrawLine(x, y, x + w, y, p);
     DrawLine(x + w, y, x + w, y + h, p);
     DrawLine(x + w, y + h, x, y + h, p);
@@ -1469,12 +2894,20 @@ namespace tDX
 
   void PixelGameEngine::Clear(Pixel p)
   {
+    T_OVERDRAW_SCOPE(CLEAR);
+    // Queued sprites would be painted over anyway
+    for (auto &q : vSpriteQueue)
+      q.sprite->bQueued = false;
+    vSpriteQueue.clear();
     int pixels = GetDrawTargetWidth() * GetDrawTargetHeight();
     Pixel* m = GetDrawTarget()->GetData();
     for (int i = 0; i < pixels; i++)
       m[i] = p;
 #ifdef T_DBG_OVERDRAW
     tDX::Sprite::nOverdrawCount += pixels;
+    for (int32_t y = 0; y < GetDrawTargetHeight(); y++)
+      for (int32_t x = 0; x < GetDrawTargetWidth(); x++)
+        tDX_CountOverdraw(x, y);
 #endif
   }
 
@@ -1485,6 +2918,7 @@ namespace tDX
 
   void PixelGameEngine::FillRect(int32_t x, int32_t y, int32_t w, int32_t h, Pixel p)
   {
+    T_OVERDRAW_SCOPE(RECT);
     int32_t x2 = x + w;
     int32_t y2 = y + h;
 
@@ -1498,9 +2932,11 @@ namespace tDX
     if (y2 < 0) y2 = 0;
     if (y2 >= (int32_t)GetDrawTargetHeight()) y2 = (int32_t)GetDrawTargetHeight();
 
-    for (int i = x; i < x2; i++)
+    tDX_Dispatch([&](const auto &out)
+    {
       for (int j = y; j < y2; j++)
-        Draw(i, j, p);
+        out.Span(x, x2 - 1, j, p);
+    });
   }
 
   void PixelGameEngine::DrawTriangle(const tDX::vi2d& pos1, const tDX::vi2d& pos2, const tDX::vi2d& pos3, Pixel p)
@@ -1510,6 +2946,7 @@ namespace tDX
 
   void PixelGameEngine::DrawTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p)
   {
+    T_OVERDRAW_SCOPE(TRIANGLE);
     DrawLine(x1, y1, x2, y2, p);
     DrawLine(x2, y2, x3, y3, p);
     DrawLine(x3, y3, x1, y1, p);
@@ -1523,143 +2960,147 @@ namespace tDX
   // https://www.avrfreaks.net/sites/default/files/triangles.c
   void PixelGameEngine::FillTriangle(int32_t x1, int32_t y1, int32_t x2, int32_t y2, int32_t x3, int32_t y3, Pixel p)
   {
-    auto SWAP = [](int &x, int &y) { int t = x; x = y; y = t; };
-    auto drawline = [&](int sx, int ex, int ny) { for (int i = sx; i <= ex; i++) Draw(i, ny, p); };
-
-    int t1x, t2x, y, minx, maxx, t1xp, t2xp;
-    bool changed1 = false;
-    bool changed2 = false;
-    int signx1, signx2, dx1, dy1, dx2, dy2;
-    int e1, e2;
-    // Sort vertices
-    if (y1 > y2) { SWAP(y1, y2); SWAP(x1, x2); }
-    if (y1 > y3) { SWAP(y1, y3); SWAP(x1, x3); }
-    if (y2 > y3) { SWAP(y2, y3); SWAP(x2, x3); }
-
-    t1x = t2x = x1; y = y1;   // Starting points
-    dx1 = (int)(x2 - x1); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
-    else signx1 = 1;
-    dy1 = (int)(y2 - y1);
-
-    dx2 = (int)(x3 - x1); if (dx2 < 0) { dx2 = -dx2; signx2 = -1; }
-    else signx2 = 1;
-    dy2 = (int)(y3 - y1);
-
-    if (dy1 > dx1) {   // swap values
-      SWAP(dx1, dy1);
-      changed1 = true;
-    }
-    if (dy2 > dx2) {   // swap values
-      SWAP(dy2, dx2);
-      changed2 = true;
-    }
-
-    e2 = (int)(dx2 >> 1);
-    // Flat top, just process the second half
-    if (y1 == y2) goto next;
-    e1 = (int)(dx1 >> 1);
-
-    for (int i = 0; i < dx1;) {
-      t1xp = 0; t2xp = 0;
-      if (t1x < t2x) { minx = t1x; maxx = t2x; }
-      else { minx = t2x; maxx = t1x; }
-      // process first line until y value is about to change
-      while (i < dx1) {
-        i++;
-        e1 += dy1;
-        while (e1 >= dx1) {
-          e1 -= dx1;
-          if (changed1) t1xp = signx1;//t1x += signx1;
-          else          goto next1;
-        }
-        if (changed1) break;
-        else t1x += signx1;
+    T_OVERDRAW_SCOPE(TRIANGLE);
+    tDX_Dispatch([&](const auto &out)
+    {
+      auto SWAP = [](int &x, int &y) { int t = x; x = y; y = t; };
+      auto drawline = [&](int sx, int ex, int ny) { out.Span(sx, ex, ny, p); };
+
+      int t1x, t2x, y, minx, maxx, t1xp, t2xp;
+      bool changed1 = false;
+      bool changed2 = false;
+      int signx1, signx2, dx1, dy1, dx2, dy2;
+      int e1, e2;
+      // Sort vertices
+      if (y1 > y2) { SWAP(y1, y2); SWAP(x1, x2); }
+      if (y1 > y3) { SWAP(y1, y3); SWAP(x1, x3); }
+      if (y2 > y3) { SWAP(y2, y3); SWAP(x2, x3); }
+
+      t1x = t2x = x1; y = y1;   // Starting points
+      dx1 = (int)(x2 - x1); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
+      else signx1 = 1;
+      dy1 = (int)(y2 - y1);
+
+      dx2 = (int)(x3 - x1); if (dx2 < 0) { dx2 = -dx2; signx2 = -1; }
+      else signx2 = 1;
+      dy2 = (int)(y3 - y1);
+
+      if (dy1 > dx1) {   // swap values
+        SWAP(dx1, dy1);
+        changed1 = true;
       }
-      // Move line
-    next1:
-      // process second line until y value is about to change
-      while (1) {
-        e2 += dy2;
-        while (e2 >= dx2) {
-          e2 -= dx2;
-          if (changed2) t2xp = signx2;//t2x += signx2;
-          else          goto next2;
-        }
-        if (changed2)     break;
-        else              t2x += signx2;
+      if (dy2 > dx2) {   // swap values
+        SWAP(dy2, dx2);
+        changed2 = true;
       }
-    next2:
-      if (minx > t1x) minx = t1x;
-      if (minx > t2x) minx = t2x;
-      if (maxx < t1x) maxx = t1x;
-      if (maxx < t2x) maxx = t2x;
-      drawline(minx, maxx, y);    // Draw line from min to max points found on the y
-                    // Now increase y
-      if (!changed1) t1x += signx1;
-      t1x += t1xp;
-      if (!changed2) t2x += signx2;
-      t2x += t2xp;
-      y += 1;
-      if (y == y2) break;
 
-    }
-  next:
-    // Second half
-    dx1 = (int)(x3 - x2); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
-    else signx1 = 1;
-    dy1 = (int)(y3 - y2);
-    t1x = x2;
-
-    if (dy1 > dx1) {   // swap values
-      SWAP(dy1, dx1);
-      changed1 = true;
-    }
-    else changed1 = false;
-
-    e1 = (int)(dx1 >> 1);
-
-    for (int i = 0; i <= dx1; i++) {
-      t1xp = 0; t2xp = 0;
-      if (t1x < t2x) { minx = t1x; maxx = t2x; }
-      else { minx = t2x; maxx = t1x; }
-      // process first line until y value is about to change
-      while (i < dx1) {
-        e1 += dy1;
-        while (e1 >= dx1) {
-          e1 -= dx1;
-          if (changed1) { t1xp = signx1; break; }//t1x += signx1;
-          else          goto next3;
+      e2 = (int)(dx2 >> 1);
+      // Flat top, just process the second half
+      if (y1 == y2) goto next;
+      e1 = (int)(dx1 >> 1);
+
+      for (int i = 0; i < dx1;) {
+        t1xp = 0; t2xp = 0;
+        if (t1x < t2x) { minx = t1x; maxx = t2x; }
+        else { minx = t2x; maxx = t1x; }
+        // process first line until y value is about to change
+        while (i < dx1) {
+          i++;
+          e1 += dy1;
+          while (e1 >= dx1) {
+            e1 -= dx1;
+            if (changed1) t1xp = signx1;//t1x += signx1;
+            else          goto next1;
+          }
+          if (changed1) break;
+          else t1x += signx1;
+        }
+        // Move line
+      next1:
+        // process second line until y value is about to change
+        while (1) {
+          e2 += dy2;
+          while (e2 >= dx2) {
+            e2 -= dx2;
+            if (changed2) t2xp = signx2;//t2x += signx2;
+            else          goto next2;
+          }
+          if (changed2)     break;
+          else              t2x += signx2;
         }
-        if (changed1) break;
-        else   	   	  t1x += signx1;
-        if (i < dx1) i++;
+      next2:
+        if (minx > t1x) minx = t1x;
+        if (minx > t2x) minx = t2x;
+        if (maxx < t1x) maxx = t1x;
+        if (maxx < t2x) maxx = t2x;
+        drawline(minx, maxx, y);    // Draw line from min to max points found on the y
+                      // Now increase y
+        if (!changed1) t1x += signx1;
+        t1x += t1xp;
+        if (!changed2) t2x += signx2;
+        t2x += t2xp;
+        y += 1;
+        if (y == y2) break;
+
       }
-    next3:
-      // process second line until y value is about to change
-      while (t2x != x3) {
-        e2 += dy2;
-        while (e2 >= dx2) {
-          e2 -= dx2;
-          if (changed2) t2xp = signx2;
-          else          goto next4;
+    next:
+      // Second half
+      dx1 = (int)(x3 - x2); if (dx1 < 0) { dx1 = -dx1; signx1 = -1; }
+      else signx1 = 1;
+      dy1 = (int)(y3 - y2);
+      t1x = x2;
+
+      if (dy1 > dx1) {   // swap values
+        SWAP(dy1, dx1);
+        changed1 = true;
+      }
+      else changed1 = false;
+
+      e1 = (int)(dx1 >> 1);
+
+      for (int i = 0; i <= dx1; i++) {
+        t1xp = 0; t2xp = 0;
+        if (t1x < t2x) { minx = t1x; maxx = t2x; }
+        else { minx = t2x; maxx = t1x; }
+        // process first line until y value is about to change
+        while (i < dx1) {
+          e1 += dy1;
+          while (e1 >= dx1) {
+            e1 -= dx1;
+            if (changed1) { t1xp = signx1; break; }//t1x += signx1;
+            else          goto next3;
+          }
+          if (changed1) break;
+          else   	   	  t1x += signx1;
+          if (i < dx1) i++;
         }
-        if (changed2)     break;
-        else              t2x += signx2;
+      next3:
+        // process second line until y value is about to change
+        while (t2x != x3) {
+          e2 += dy2;
+          while (e2 >= dx2) {
+            e2 -= dx2;
+            if (changed2) t2xp = signx2;
+            else          goto next4;
+          }
+          if (changed2)     break;
+          else              t2x += signx2;
+        }
+      next4:
+
+        if (minx > t1x) minx = t1x;
+        if (minx > t2x) minx = t2x;
+        if (maxx < t1x) maxx = t1x;
+        if (maxx < t2x) maxx = t2x;
+        drawline(minx, maxx, y);
+        if (!changed1) t1x += signx1;
+        t1x += t1xp;
+        if (!changed2) t2x += signx2;
+        t2x += t2xp;
+        y += 1;
+        if (y > y3) return;
       }
-    next4:
-
-      if (minx > t1x) minx = t1x;
-      if (minx > t2x) minx = t2x;
-      if (maxx < t1x) maxx = t1x;
-      if (maxx < t2x) maxx = t2x;
-      drawline(minx, maxx, y);
-      if (!changed1) t1x += signx1;
-      t1x += t1xp;
-      if (!changed2) t2x += signx2;
-      t2x += t2xp;
-      y += 1;
-      if (y > y3) return;
-    }
+    });
   }
 
   void PixelGameEngine::DrawSprite(const tDX::vi2d& pos, Sprite *sprite, uint32_t scale)
@@ -1669,23 +3110,26 @@ namespace tDX
 
   void PixelGameEngine::DrawSprite(int32_t x, int32_t y, Sprite *sprite, uint32_t scale)
   {
-    if (sprite == nullptr)
+    T_OVERDRAW_SCOPE(SPRITE);
+    if (sprite == nullptr || tDX_QueueSprite(x, y, sprite, 0, 0, sprite->width, sprite->height, scale))
       return;
 
-    if (scale > 1)
+    tDX_Dispatch([&](const auto &out)
     {
-      for (int32_t i = 0; i < sprite->width; i++)
-        for (int32_t j = 0; j < sprite->height; j++)
-          for (uint32_t is = 0; is < scale; is++)
+      if (scale > 1)
+      {
+        for (int32_t i = 0; i < sprite->width; i++)
+          for (int32_t j = 0; j < sprite->height; j++)
             for (uint32_t js = 0; js < scale; js++)
-              Draw(x + (i*scale) + is, y + (j*scale) + js, sprite->GetPixel(i, j));
-    }
-    else
-    {
-      for (int32_t i = 0; i < sprite->width; i++)
+              out.Span(x + (i*scale), x + (i*scale) + scale - 1, y + (j*scale) + js, sprite->GetPixel(i, j));
+      }
+      else
+      {
         for (int32_t j = 0; j < sprite->height; j++)
-          Draw(x + i, y + j, sprite->GetPixel(i, j));
-    }
+          for (int32_t i = 0; i < sprite->width; i++)
+            out.Plot(x + i, y + j, sprite->GetPixel(i, j));
+      }
+    });
   }
 
   void PixelGameEngine::DrawPartialSprite(const tDX::vi2d& pos, Sprite *sprite, const tDX::vi2d& sourcepos, const tDX::vi2d& size, uint32_t scale)
@@ -1695,23 +3139,170 @@ namespace tDX
 
   void PixelGameEngine::DrawPartialSprite(int32_t x, int32_t y, Sprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale)
   {
-    if (sprite == nullptr)
+    T_OVERDRAW_SCOPE(SPRITE);
+    if (sprite == nullptr || tDX_QueueSprite(x, y, sprite, ox, oy, w, h, scale))
       return;
 
-    if (scale > 1)
+    tDX_Dispatch([&](const auto &out)
     {
-      for (int32_t i = 0; i < w; i++)
-        for (int32_t j = 0; j < h; j++)
-          for (uint32_t is = 0; is < scale; is++)
+      if (scale > 1)
+      {
+        for (int32_t i = 0; i < w; i++)
+          for (int32_t j = 0; j < h; j++)
             for (uint32_t js = 0; js < scale; js++)
-              Draw(x + (i*scale) + is, y + (j*scale) + js, sprite->GetPixel(i + ox, j + oy));
-    }
-    else
-    {
-      for (int32_t i = 0; i < w; i++)
+              out.Span(x + (i*scale), x + (i*scale) + scale - 1, y + (j*scale) + js, sprite->GetPixel(i + ox, j + oy));
+      }
+      else
+      {
         for (int32_t j = 0; j < h; j++)
-          Draw(x + i, y + j, sprite->GetPixel(i + ox, j + oy));
+          for (int32_t i = 0; i < w; i++)
+            out.Plot(x + i, y + j, sprite->GetPixel(i + ox, j + oy));
+      }
+    });
+  }
+
+  void PixelGameEngine::DrawSprite(const tDX::vi2d& pos, IndexedSprite *sprite, uint32_t scale)
+  {
+    DrawSprite(pos.x, pos.y, sprite, scale);
+  }
+
+  void PixelGameEngine::DrawSprite(int32_t x, int32_t y, IndexedSprite *sprite, uint32_t scale)
+  {
+    if (sprite == nullptr)
+      return;
+
+    DrawPartialSprite(x, y, sprite, 0, 0, sprite->width, sprite->height, scale);
+  }
+
+  void PixelGameEngine::DrawPartialSprite(const tDX::vi2d& pos, IndexedSprite *sprite, const tDX::vi2d& sourcepos, const tDX::vi2d& size, uint32_t scale)
+  {
+    DrawPartialSprite(pos.x, pos.y, sprite, sourcepos.x, sourcepos.y, size.x, size.y, scale);
+  }
+
+  void PixelGameEngine::DrawPartialSprite(int32_t x, int32_t y, IndexedSprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale)
+  {
+    T_OVERDRAW_SCOPE(SPRITE);
+    if (sprite == nullptr || sprite->GetData() == nullptr || pDrawTarget == nullptr)
+      return;
+
+    if (scale == 1 && !bDrawOverride && (nPixelMode == Pixel::Mode::NORMAL || nPixelMode == Pixel::Mode::MASK))
+    {
+      tDX_FlushSprites();
+
+      // Clip the source area to the sprite and then the destination to the target
+      if (ox < 0) { x -= ox; w += ox; ox = 0; }
+      if (oy < 0) { y -= oy; h += oy; oy = 0; }
+      w = std::min(w, sprite->width - ox);
+      h = std::min(h, sprite->height - oy);
+
+      int32_t x0 = std::max(x, 0);
+      int32_t y0 = std::max(y, 0);
+      int32_t x1 = std::min(x + w, pDrawTarget->width);
+      int32_t y1 = std::min(y + h, pDrawTarget->height);
+      if (x0 >= x1 || y0 >= y1) return;
+
+      bool bMask = nPixelMode == Pixel::Mode::MASK;
+      for (int32_t j = y0; j < y1; j++)
+        tDX_ExpandIndexedRow(pDrawTarget->GetData() + j * pDrawTarget->width + x0,
+          sprite->GetData() + (j - y + oy) * sprite->width + (x0 - x + ox), x1 - x0, sprite->palette, bMask);
+
+#ifdef T_DBG_OVERDRAW
+      for (int32_t j = y0; j < y1; j++)
+        for (int32_t i = x0; i < x1; i++)
+        {
+          uint8_t idx = sprite->GetIndex(i - x + ox, j - y + oy);
+          if (idx != IndexedSprite::TRANSPARENT_INDEX && (!bMask || sprite->palette[idx].a == 255))
+          {
+            tDX::Sprite::nOverdrawCount++;
+            tDX_CountOverdraw(i, j);
+          }
+        }
+#endif
+      return;
     }
+
+    // Blending and scaling go pixel by pixel, the reserved index is skipped
+    tDX_Dispatch([&](const auto &out)
+    {
+      for (int32_t j = 0; j < h; j++)
+        for (int32_t i = 0; i < w; i++)
+        {
+          uint8_t idx = sprite->GetIndex(i + ox, j + oy);
+          if (idx == IndexedSprite::TRANSPARENT_INDEX) continue;
+
+          for (uint32_t js = 0; js < scale; js++)
+            out.Span(x + (i*scale), x + (i*scale) + scale - 1, y + (j*scale) + js, sprite->palette[idx]);
+        }
+    });
+  }
+
+  void PixelGameEngine::DrawSprite(const tDX::vi2d& pos, PagedSprite *sprite, uint32_t scale)
+  {
+    DrawSprite(pos.x, pos.y, sprite, scale);
+  }
+
+  void PixelGameEngine::DrawSprite(int32_t x, int32_t y, PagedSprite *sprite, uint32_t scale)
+  {
+    if (sprite == nullptr)
+      return;
+
+    DrawPartialSprite(x, y, sprite, 0, 0, sprite->width, sprite->height, scale);
+  }
+
+  void PixelGameEngine::DrawPartialSprite(const tDX::vi2d& pos, PagedSprite *sprite, const tDX::vi2d& sourcepos, const tDX::vi2d& size, uint32_t scale)
+  {
+    DrawPartialSprite(pos.x, pos.y, sprite, sourcepos.x, sourcepos.y, size.x, size.y, scale);
+  }
+
+  void PixelGameEngine::DrawPartialSprite(int32_t x, int32_t y, PagedSprite *sprite, int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t scale)
+  {
+    T_OVERDRAW_SCOPE(SPRITE);
+    if (sprite == nullptr || sprite->nTileSize <= 0 || pDrawTarget == nullptr || scale == 0)
+      return;
+
+    // Clip the source area to the image, then to what lands on the target
+    if (ox < 0) { x -= ox * (int32_t)scale; w += ox; ox = 0; }
+    if (oy < 0) { y -= oy * (int32_t)scale; h += oy; oy = 0; }
+    w = std::min(w, sprite->width - ox);
+    h = std::min(h, sprite->height - oy);
+
+    int32_t s = (int32_t)scale;
+    int32_t i0 = std::max(0, -x / s);
+    int32_t j0 = std::max(0, -y / s);
+    int32_t i1 = std::min(w, (pDrawTarget->width - x + s - 1) / s);
+    int32_t j1 = std::min(h, (pDrawTarget->height - y + s - 1) / s);
+    if (i0 >= i1 || j0 >= j1) return;
+
+    tDX_Dispatch([&](const auto &out)
+    {
+      // Tile by tile, so each tile is looked up once
+      int32_t nTile = sprite->nTileSize;
+      for (int32_t ty = (oy + j0) / nTile; ty <= (oy + j1 - 1) / nTile; ty++)
+        for (int32_t tx = (ox + i0) / nTile; tx <= (ox + i1 - 1) / nTile; tx++)
+        {
+          const Pixel *pTile = sprite->GetTile(tx, ty);
+          if (pTile == nullptr) continue;
+          int32_t nPitch = sprite->GetTileWidth(tx);
+
+          int32_t ja = std::max(j0, ty * nTile - oy), jb = std::min(j1, (ty + 1) * nTile - oy);
+          int32_t ia = std::max(i0, tx * nTile - ox), ib = std::min(i1, (tx + 1) * nTile - ox);
+          for (int32_t j = ja; j < jb; j++)
+          {
+            const Pixel *pRow = pTile + (oy + j - ty * nTile) * nPitch;
+            for (int32_t i = ia; i < ib; i++)
+            {
+              Pixel p = pRow[ox + i - tx * nTile];
+              if (s == 1)
+                out.Plot(x + i, y + j, p);
+              else
+                for (int32_t js = 0; js < s; js++)
+                  out.Span(x + i * s, x + i * s + s - 1, y + j * s + js, p);
+            }
+          }
+        }
+    });
+
+    sprite->Prefetch(ox + i0, oy + j0, i1 - i0, j1 - j0);
   }
 
   void PixelGameEngine::DrawString(const tDX::vi2d& pos, const std::string& sText, Pixel col, uint32_t scale)
@@ -1721,6 +3312,7 @@ namespace tDX
 
   void PixelGameEngine::DrawString(int32_t x, int32_t y, const std::string& sText, Pixel col, uint32_t scale)
   {
+    T_OVERDRAW_SCOPE(TEXT);
     int32_t sx = 0;
     int32_t sy = 0;
     Pixel::Mode m = nPixelMode;
@@ -1729,36 +3321,38 @@ namespace tDX
     else
       SetPixelMode(Pixel::Mode::MASK);
 
-    for (auto c : sText)
+    tDX_Dispatch([&](const auto &out)
     {
-      if (c == '\n')
-      {
-        sx = 0; sy += 8 * scale;
-      }
-      else
+      for (auto c : sText)
       {
-        int32_t ox = (c - 32) % 16;
-        int32_t oy = (c - 32) / 16;
-
-        if (scale > 1)
+        if (c == '\n')
         {
-          for (uint32_t i = 0; i < 8; i++)
-            for (uint32_t j = 0; j < 8; j++)
-              if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-                for (uint32_t is = 0; is < scale; is++)
-                  for (uint32_t js = 0; js < scale; js++)
-                    Draw(x + sx + (i*scale) + is, y + sy + (j*scale) + js, col);
+          sx = 0; sy += 8 * scale;
         }
         else
         {
-          for (uint32_t i = 0; i < 8; i++)
-            for (uint32_t j = 0; j < 8; j++)
-              if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
-                Draw(x + sx + i, y + sy + j, col);
+          int32_t ox = (c - 32) % 16;
+          int32_t oy = (c - 32) / 16;
+
+          if (scale > 1)
+          {
+            for (uint32_t i = 0; i < 8; i++)
+              for (uint32_t j = 0; j < 8; j++)
+                if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
+                  for (uint32_t js = 0; js < scale; js++)
+                    out.Span(x + sx + (i*scale), x + sx + (i*scale) + scale - 1, y + sy + (j*scale) + js, col);
+          }
+          else
+          {
+            for (uint32_t i = 0; i < 8; i++)
+              for (uint32_t j = 0; j < 8; j++)
+                if (fontSprite->GetPixel(i + ox * 8, j + oy * 8).r > 0)
+                  out.Plot(x + sx + i, y + sy + j, col);
+          }
+          sx += 8 * scale;
         }
-        sx += 8 * scale;
       }
-    }
+    });
     SetPixelMode(m);
   }
 
@@ -1785,6 +3379,84 @@ namespace tDX
     if (fBlendFactor > 1.0f) fBlendFactor = 1.0f;
   }
 
+#ifdef T_DBG_OVERDRAW
+  void PixelGameEngine::SetOverdrawHeatmap(bool bShow, DrawPrimitive filter)
+  {
+    bShowHeatmap = bShow;
+    nHeatmapFilter = filter;
+  }
+
+  OverdrawStats PixelGameEngine::GetOverdrawStats()
+  {
+    return overdrawStats;
+  }
+
+  void PixelGameEngine::tDX_CountOverdraw(int32_t x, int32_t y)
+  {
+    // Only the primary screen is tracked, and Draw does not bounds check
+    if (pDrawTarget != pDefaultDrawTarget || x < 0 || y < 0 || x >= pDrawTarget->width || y >= pDrawTarget->height)
+      return;
+
+    size_t i = ((size_t)y * pDrawTarget->width + x) * (size_t)DrawPrimitive::COUNT + (size_t)nOverdrawPrimitive;
+    if (i < vOverdraw.size() && vOverdraw[i] < 255)
+      vOverdraw[i]++;
+  }
+
+  void PixelGameEngine::tDX_BeginOverdrawFrame()
+  {
+    vOverdraw.assign((size_t)pDefaultDrawTarget->width * pDefaultDrawTarget->height * (size_t)DrawPrimitive::COUNT, 0);
+  }
+
+  void PixelGameEngine::tDX_EndOverdrawFrame()
+  {
+    // Blue for a single write through green and yellow to red, white for 8 and more
+    static const Pixel heat[] =
+    {
+      Pixel(0, 0, 0), Pixel(0, 0, 192), Pixel(0, 128, 255), Pixel(0, 192, 0), Pixel(255, 255, 0),
+      Pixel(255, 160, 0), Pixel(255, 80, 0), Pixel(255, 0, 0), Pixel(255, 255, 255)
+    };
+
+    overdrawStats = OverdrawStats();
+    const size_t nTypes = (size_t)DrawPrimitive::COUNT;
+    // SetScreenSize during the frame leaves the counts sized for the old screen
+    size_t nPixels = std::min(vOverdraw.size() / nTypes, (size_t)pDefaultDrawTarget->width * pDefaultDrawTarget->height);
+    Pixel *screen = pDefaultDrawTarget->GetData();
+
+    // The heatmap goes on a copy, the screen keeps what the application drew for the next frame
+    if (bShowHeatmap)
+      vHeatmapFrame.assign(screen, screen + nPixels);
+    else
+      vHeatmapFrame.clear();
+
+    for (size_t i = 0; i < nPixels; i++)
+    {
+      const uint8_t *c = &vOverdraw[i * nTypes];
+      uint32_t nSum = 0;
+      for (size_t t = 0; t < nTypes; t++)
+      {
+        nSum += c[t];
+        overdrawStats.nWrites[t] += c[t];
+      }
+
+      if (nSum > 0) overdrawStats.nCoveredPixels++;
+      overdrawStats.nMaxWrites = std::max(overdrawStats.nMaxWrites, nSum);
+
+      if (bShowHeatmap)
+      {
+        uint32_t n = nHeatmapFilter == DrawPrimitive::ALL ? nSum : c[(size_t)nHeatmapFilter];
+        const Pixel &h = heat[std::min(n, 8u)];
+        Pixel &d = vHeatmapFrame[i];
+        d = Pixel((uint8_t)((h.r * 3 + d.r) / 4), (uint8_t)((h.g * 3 + d.g) / 4), (uint8_t)((h.b * 3 + d.b) / 4));
+      }
+    }
+
+    for (size_t t = 0; t < nTypes; t++)
+      overdrawStats.nTotalWrites += overdrawStats.nWrites[t];
+    if (overdrawStats.nCoveredPixels > 0)
+      overdrawStats.fOverdraw = (float)overdrawStats.nTotalWrites / (float)overdrawStats.nCoveredPixels;
+  }
+#endif
+
   // User must override these functions as required. I have not made
   // them abstract because I do need a default behaviour to occur if
   // they are not overwritten
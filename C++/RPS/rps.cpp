@@ -1,5 +1,11 @@
 #define T_PGE_APPLICATION
 #include "engine/tPixelGameEngine.h"
+#define T_PGEX_PARTICLES
+#include "engine/tPGEX_Particles.h"
+#define T_PGEX_WORLD
+#include "engine/tPGEX_World.h"
+#define T_PGEX_TILEMAP
+#include "engine/tPGEX_TileMap.h"
 
 #include <random>
 
@@ -33,6 +39,24 @@ public:
   tDX::Sprite pa;
   tDX::Sprite ro;
 
+  // Checkered floor under the items, covers the whole screen
+  static const int TILE = 16;
+  tDX::Sprite groundSheet{ TILE * 2, TILE };
+  tDX::TileMap ground{ (SCREEN_WIDTH + TILE - 1) / TILE, (SCREEN_HEIGHT + TILE - 1) / TILE, TILE, &groundSheet };
+
+  bool bOcclusion = true;
+
+  tDX::ParticleSystem sparks;
+  std::mt19937 rng;
+
+  // Item i is object i, it culls the drawing and finds collision candidates
+  tDX::World world{ { 0.0f, 0.0f }, { (float)SCREEN_WIDTH, (float)SCREEN_HEIGHT }, 6 };
+  std::vector<uint32_t> vNear;
+
+#ifdef T_DBG_OVERDRAW
+  bool bHeatmap = false;
+#endif
+
   RockPaperScissors()
   {
     sAppName = "Rock Paper Scissors";
@@ -44,6 +68,7 @@ public:
 
     std::random_device rd;
     std::mt19937 gen(rd());
+    rng.seed(rd());
     std::uniform_int_distribution<> shift(-50, 50);
     std::uniform_real_distribution<> move(-1.0, 1.0);
 
@@ -65,6 +90,26 @@ public:
     pa.LoadFromFile("p.png");
     ro.LoadFromFile("r.png");
 
+    for (int y = 0; y < TILE; y++)
+      for (int x = 0; x < TILE * 2; x++)
+        groundSheet.SetPixel(x, y, x < TILE ? tDX::Pixel(24, 24, 28) : tDX::Pixel(32, 32, 38));
+
+    for (int y = 0; y < ground.GetHeight(); y++)
+      for (int x = 0; x < ground.GetWidth(); x++)
+        ground.SetTile(x, y, (x + y) % 2);
+
+    for (int i = 0; i < N * 3; i++)
+    {
+      tDX::Sprite *sprite = spriteOf(items[i].sign);
+      world.Add({ { (float)items[i].pos_x, (float)items[i].pos_y }, { (float)sprite->width, (float)sprite->height }, 0, sprite });
+    }
+
+    // Later items paint over earlier ones, let the engine skip what gets hidden
+    EnableSpriteOcclusion(bOcclusion);
+
+    sparks.vGravity = { 0.0f, 200.0f };
+    sparks.fDrag = 1.5f;
+
     Sleep(1000);
 
     return true;
@@ -72,8 +117,26 @@ public:
 
   bool OnUserUpdate(float fElapsedTime) override
   {
-    Clear(tDX::BLACK);
+    // O toggles the front to back sprite pass
+    if (GetKey(tDX::O).bPressed)
+      EnableSpriteOcclusion(bOcclusion = !bOcclusion);
+
+#ifdef T_DBG_OVERDRAW
+    // H toggles the overdraw heatmap
+    if (GetKey(tDX::H).bPressed)
+      SetOverdrawHeatmap(bHeatmap = !bHeatmap);
+#endif
+
+    // Clicking an item turns it into what beats it
+    if (GetMouse(0).bPressed)
+    {
+      uint32_t id = world.PickTop({ (float)GetMouseX(), (float)GetMouseY() });
+      if (id != tDX::World::INVALID)
+        convert(id, (Sign)(((int)items[id].sign + 1) % 3));
+    }
+
     SetPixelMode(tDX::Pixel::Mode::ALPHA);
+    ground.Draw(0, 0);
 
     for (int i = 0; i < N * 3; i++)
     {
@@ -82,51 +145,50 @@ public:
 
       items[i].vec_x *= (items[i].pos_x) < 10.0 || (items[i].pos_x) >= SCREEN_WIDTH - 30 ? -1.0 : 1.0;
       items[i].vec_y *= (items[i].pos_y) < 10.0 || (items[i].pos_y) >= SCREEN_HEIGHT - 30 ? -1.0 : 1.0;
-    }
 
-    for (int i = 0; i < N * 3; i++)
-    {
-      switch (items[i].sign)
-      {
-      case Sign::Paper: DrawSprite(items[i].pos_x, items[i].pos_y, &pa); break;
-      case Sign::Rock: DrawSprite(items[i].pos_x, items[i].pos_y, &ro); break;
-      case Sign::Scissors: DrawSprite(items[i].pos_x, items[i].pos_y, &sc); break;
-      };
+      world.Move(i, { (float)items[i].pos_x, (float)items[i].pos_y });
     }
 
-    int x1, y1;
-    int x2, y2;
+    world.Draw({ 0.0f, 0.0f });
+
+    sparks.Update(fElapsedTime);
+    sparks.DrawPoints(tDX::ParticleSystem::Blend::ADDITIVE);
+
+    tDX::vi2d p1, p2;
     Sign s1, s2;
 
     for (int i = 0; i < N * 3; i++)
     {
-      x1 = items[i].pos_x + 10;
-      y1 = items[i].pos_y + 10;
+      p1 = { (int)items[i].pos_x, (int)items[i].pos_y };
       s1 = items[i].sign;
 
-      for (int o = 0; o < N * 3; o++)
+      // Boxes grown by a pixel, the world keeps float positions
+      tDX::Sprite *sprite = spriteOf(s1);
+      world.QueryRect({ p1.x - 1.0f, p1.y - 1.0f }, { p1.x + sprite->width + 1.0f, p1.y + sprite->height + 1.0f }, vNear);
+
+      for (uint32_t o : vNear)
       {
-        x2 = items[o].pos_x + 10;
-        y2 = items[o].pos_y + 10;
+        p2 = { (int)items[o].pos_x, (int)items[o].pos_y };
         s2 = items[o].sign;
 
-        if (i == o || s1 == s2) continue;
+        if ((uint32_t)i == o || s1 == s2) continue;
 
-        if (abs(x1 - x2) < 10 && abs(y1 - y2) < 10)
+        // Touching opaque pixels, the bounding boxes reject most candidates
+        if (tDX::SpriteMask::Overlap(spriteOf(s1)->GetMask(), p1, spriteOf(s2)->GetMask(), p2))
         {
           switch (s1)
           {
           case Sign::Rock:
-            if (s2 == Sign::Scissors) items[o].sign = Sign::Rock;
-            else if (s2 == Sign::Paper) items[i].sign = Sign::Paper;
+            if (s2 == Sign::Scissors) convert(o, Sign::Rock);
+            else if (s2 == Sign::Paper) convert(i, Sign::Paper);
             break;
           case Sign::Paper:
-            if (s2 == Sign::Rock) items[o].sign = Sign::Paper;
-            else if (s2 == Sign::Scissors) items[i].sign = Sign::Scissors;
+            if (s2 == Sign::Rock) convert(o, Sign::Paper);
+            else if (s2 == Sign::Scissors) convert(i, Sign::Scissors);
             break;
           case Sign::Scissors:
-            if (s2 == Sign::Paper) items[o].sign = Sign::Scissors;
-            else if (s2 == Sign::Rock) items[i].sign = Sign::Rock;
+            if (s2 == Sign::Paper) convert(o, Sign::Scissors);
+            else if (s2 == Sign::Rock) convert(i, Sign::Rock);
             break;
           }
         }
@@ -136,6 +198,40 @@ public:
 
     return true;
   }
+
+  // Turns the item and throws a burst of sparks in its new colour
+  void convert(int k, Sign s)
+  {
+    static const tDX::Pixel colours[] = { tDX::GREY, tDX::WHITE, tDX::RED };
+
+    Item &item = items[k];
+
+    std::uniform_real_distribution<float> angle(0.0f, 6.2832f), speed(30.0f, 120.0f), life(0.3f, 0.8f);
+    tDX::Sprite *sprite = spriteOf(item.sign);
+    float x = (float)item.pos_x + sprite->width * 0.5f, y = (float)item.pos_y + sprite->height * 0.5f;
+
+    for (int n = 0; n < 24; n++)
+    {
+      float a = angle(rng), v = speed(rng);
+      sparks.Emit(x, y, v * cosf(a), v * sinf(a), life(rng), colours[(int)s]);
+    }
+
+    item.sign = s;
+
+    sprite = spriteOf(s);
+    world.Get(k).sprite = sprite;
+    world.Resize(k, { (float)sprite->width, (float)sprite->height });
+  }
+
+  tDX::Sprite* spriteOf(Sign s)
+  {
+    switch (s)
+    {
+    case Sign::Paper: return &pa;
+    case Sign::Rock: return &ro;
+    default: return &sc;
+    }
+  }
 };
 
 